@@ -65,10 +65,19 @@ D3DPRESENT_PARAMETERS Console::m_d3dpp =
 // Desc: Initialize variables
 //--------------------------------------------------------------------------------------
 Console::Console()
+    : m_bOutputToDebugChannel( FALSE ),
+      m_Buffer( NULL ),
+      m_Lines( NULL ),
+      m_bListView( FALSE ),
+      m_bListDirty( FALSE ),
+      m_cListRows( 0 ),
+      m_nListCount( 0 ),
+      m_nListTop( 0 ),
+      m_nListSelection( LISTVIEW_STALE ),
+      m_ListBuffer( NULL ),
+      m_ListLines( NULL ),
+      m_ListItems( NULL )
 {
-    m_Buffer = NULL;
-    m_Lines = NULL;
-    m_bOutputToDebugChannel = FALSE;
 }
 
 
@@ -221,6 +230,8 @@ VOID Console::ScrollUp( INT nLines )
 VOID Console::Destroy()
 {
     // Delete the memory we've allocated
+    EndListView();
+
     if( m_Lines )
     {
         delete[] m_Lines;
@@ -266,6 +277,30 @@ VOID Console::Render()
     // Render the background
     RenderBackground( m_colBackColor, m_colBackColor );
 
+    if( m_bListView )
+    {
+        m_Font.Begin();
+
+        for( UINT nScreenLine = 0; nScreenLine < m_cScreenHeight; nScreenLine++ )
+        {
+            FLOAT fY = ( FLOAT )( m_cySafeAreaOffset + m_fLineHeight * nScreenLine );
+            BOOL bRow = nScreenLine >= m_cListHeader && nScreenLine < m_cListHeader + m_cListRows;
+            if( bRow && m_nListSelection != LISTVIEW_STALE &&
+                m_ListItems[ nScreenLine - m_cListHeader ] == m_nListSelection )
+            {
+                m_Font.DrawText( ( FLOAT )m_cxSafeAreaOffset, fY, m_colTextColor, L">" );
+            }
+
+            m_Font.DrawText( ( FLOAT )m_cxSafeAreaOffset + ( bRow ? m_fListIndent : 0.0f ), fY,
+                             m_colTextColor, m_ListLines[nScreenLine] );
+        }
+
+        m_Font.End();
+
+        PresentAndSuspend();
+        return;
+    }
+
     // The top line
     UINT nTextLine = ( m_nCurLine - m_cScreenHeight + m_cScreenHeightVirtual - m_nScrollOffset + 1 )
         % m_cScreenHeightVirtual;
@@ -284,10 +319,17 @@ VOID Console::Render()
 
     m_Font.End();
 
-    // Present the scene
-    m_pd3dDevice->Present( NULL, NULL, NULL, NULL );
+    PresentAndSuspend();
+}
 
-    // Take away GPU control so that the Guide can be rendered
+
+//--------------------------------------------------------------------------------------
+// Name: PresentAndSuspend()
+// Desc: Present the scene, then take away GPU control so that the Guide can be rendered
+//--------------------------------------------------------------------------------------
+VOID Console::PresentAndSuspend()
+{
+    m_pd3dDevice->Present( NULL, NULL, NULL, NULL );
     m_pd3dDevice->Suspend();
 }
 
@@ -486,5 +528,258 @@ VOID Console::Display( LPCWSTR wstrDisplay )
 	Render();
 }
 
+
+//--------------------------------------------------------------------------------------
+// Name: BeginListView()
+// Desc: Switch the screen over to a list view. The text buffer is kept, and is
+//       shown again by EndListView().
+//--------------------------------------------------------------------------------------
+VOID Console::BeginListView( UINT nHeaderLines, UINT nFooterLines,
+                             LISTVIEW_TEXT_CALLBACK pfnGetText, VOID* pContext )
+{
+    EndListView();
+
+    assert( nHeaderLines + nFooterLines < m_cScreenHeight );
+
+    m_pfnGetListText = pfnGetText;
+    m_pListContext = pContext;
+    m_cListHeader = nHeaderLines;
+    m_cListFooter = nFooterLines;
+    m_cListRows = m_cScreenHeight - nHeaderLines - nFooterLines;
+    m_nListCount = 0;
+    m_nListTop = 0;
+    m_nListSelection = LISTVIEW_STALE;
+    m_dwListPresentTime = GetTickCount() - LISTVIEW_FRAME_INTERVAL;
+
+    FLOAT fHeight;
+    m_Font.GetTextExtent( L"> ", &m_fListIndent, &fHeight, FALSE );
+
+    m_ListBuffer = new WCHAR[ m_cScreenHeight * ( m_cScreenWidth + 1 ) ];
+    m_ListLines = new WCHAR*[ m_cScreenHeight ];
+    m_ListItems = new UINT[ m_cListRows ];
+    ZeroMemory( m_ListBuffer, m_cScreenHeight * ( m_cScreenWidth + 1 ) * sizeof( WCHAR ) );
+
+    for( UINT i = 0; i < m_cScreenHeight; i++ )
+    {
+        m_ListLines[ i ] = m_ListBuffer + ( m_cScreenWidth + 1 ) * i;
+    }
+
+    m_bListView = TRUE;
+    InvalidateList();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Name: EndListView()
+// Desc: Go back to showing the text buffer
+//--------------------------------------------------------------------------------------
+VOID Console::EndListView()
+{
+    if( !m_bListView )
+        return;
+
+    m_bListView = FALSE;
+    m_cListRows = 0;
+
+    delete[] m_ListItems;
+    delete[] m_ListLines;
+    delete[] m_ListBuffer;
+    m_ListItems = NULL;
+    m_ListLines = NULL;
+    m_ListBuffer = NULL;
+
+    if( m_pd3dDevice )
+        Render();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Name: SetListCount()
+// Desc: Set how many items the list holds. Rows that gain or lose an item are
+//       refetched, the rest keep their text.
+//--------------------------------------------------------------------------------------
+VOID Console::SetListCount( UINT nItems )
+{
+    if( nItems == m_nListCount )
+        return;
+
+    UINT nFirst = min( nItems, m_nListCount );
+    UINT nLast = max( nItems, m_nListCount );
+    m_nListCount = nItems;
+
+    for( UINT nRow = 0; nRow < m_cListRows; nRow++ )
+    {
+        UINT nItem = m_nListTop + nRow;
+        if( nItem >= nFirst && nItem < nLast )
+        {
+            m_ListItems[ nRow ] = LISTVIEW_STALE;
+            m_bListDirty = TRUE;
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Name: SetListTop()
+// Desc: Scroll the list so nTop is in the first row. Rows still on screen are
+//       moved rather than refetched.
+//--------------------------------------------------------------------------------------
+VOID Console::SetListTop( UINT nTop )
+{
+    if( !m_bListView || nTop == m_nListTop )
+        return;
+
+    // Pair every row with the one that will show its item after the scroll
+    WCHAR** OldLines = ( WCHAR** )_malloca( m_cListRows * sizeof( WCHAR* ) );
+    UINT* OldItems = ( UINT* )_malloca( m_cListRows * sizeof( UINT ) );
+    memcpy( OldLines, m_ListLines + m_cListHeader, m_cListRows * sizeof( WCHAR* ) );
+    memcpy( OldItems, m_ListItems, m_cListRows * sizeof( UINT ) );
+
+    for( UINT nRow = 0; nRow < m_cListRows; nRow++ )
+    {
+        m_ListLines[ m_cListHeader + nRow ] = NULL;
+        m_ListItems[ nRow ] = LISTVIEW_STALE;
+    }
+
+    UINT nSpare = 0;
+    for( UINT nRow = 0; nRow < m_cListRows; nRow++ )
+    {
+        UINT nItem = OldItems[ nRow ];
+        if( nItem != LISTVIEW_STALE && nItem >= nTop && nItem < nTop + m_cListRows )
+        {
+            m_ListLines[ m_cListHeader + nItem - nTop ] = OldLines[ nRow ];
+            m_ListItems[ nItem - nTop ] = nItem;
+        }
+        else
+        {
+            // Rows scrolled off keep their buffers for the rows scrolled in
+            OldLines[ nSpare++ ] = OldLines[ nRow ];
+        }
+    }
+
+    for( UINT nRow = 0; nRow < m_cListRows; nRow++ )
+    {
+        if( m_ListLines[ m_cListHeader + nRow ] == NULL )
+            m_ListLines[ m_cListHeader + nRow ] = OldLines[ --nSpare ];
+    }
+
+    _freea( OldItems );
+    _freea( OldLines );
+
+    m_nListTop = nTop;
+    m_bListDirty = TRUE;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Name: SetListSelection()
+// Desc: Move the selection marker, no text is refetched
+//--------------------------------------------------------------------------------------
+VOID Console::SetListSelection( UINT nItem )
+{
+    if( nItem == m_nListSelection )
+        return;
+
+    m_nListSelection = nItem;
+    m_bListDirty = TRUE;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Name: SetListFixedLine()
+// Desc: Set the text of a header or footer line. Setting the same text again
+//       doesn't cause a redraw.
+//--------------------------------------------------------------------------------------
+VOID Console::SetListFixedLine( UINT nLine, LPCWSTR wstrText )
+{
+    if( !m_bListView || nLine >= m_cListHeader + m_cListFooter )
+        return;
+
+    UINT nScreenLine = nLine < m_cListHeader ? nLine : nLine + m_cListRows;
+    WCHAR* strLine = m_ListLines[ nScreenLine ];
+    if( wcsncmp( strLine, wstrText, m_cScreenWidth ) == 0 )
+        return;
+
+    wcsncpy_s( strLine, m_cScreenWidth + 1, wstrText, _TRUNCATE );
+    m_bListDirty = TRUE;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Name: InvalidateListItem()
+// Desc: Refetch an item's text, if it's on screen, when the list is next drawn
+//--------------------------------------------------------------------------------------
+VOID Console::InvalidateListItem( UINT nItem )
+{
+    if( nItem >= m_nListTop && nItem < m_nListTop + m_cListRows )
+    {
+        m_ListItems[ nItem - m_nListTop ] = LISTVIEW_STALE;
+        m_bListDirty = TRUE;
+    }
+}
+
+VOID Console::InvalidateList()
+{
+    for( UINT nRow = 0; nRow < m_cListRows; nRow++ )
+    {
+        m_ListItems[ nRow ] = LISTVIEW_STALE;
+    }
+
+    m_bListDirty = TRUE;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Name: FillListRow()
+// Desc: Fetch the text of the item in a row, cut to what fits beside the marker
+//--------------------------------------------------------------------------------------
+VOID Console::FillListRow( UINT nRow )
+{
+    UINT nItem = m_nListTop + nRow;
+    WCHAR* strLine = m_ListLines[ m_cListHeader + nRow ];
+    strLine[0] = L'\0';
+
+    if( nItem < m_nListCount )
+    {
+        m_pfnGetListText( nItem, strLine, m_cScreenWidth + 1, m_pListContext );
+        strLine[ m_cScreenWidth ] = L'\0';
+
+        UINT cLength = wcslen( strLine );
+        while( cLength > 0 && m_Font.GetTextWidth( strLine ) > m_cxSafeArea - m_fListIndent )
+        {
+            strLine[ --cLength ] = L'\0';
+        }
+    }
+
+    m_ListItems[ nRow ] = nItem;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Name: RenderListView()
+// Desc: Fetch the rows that went stale and present the list, if anything changed
+//       and the last frame is old enough
+//--------------------------------------------------------------------------------------
+VOID Console::RenderListView()
+{
+    if( !m_bListView || !m_bListDirty )
+        return;
+
+    DWORD dwNow = GetTickCount();
+    if( dwNow - m_dwListPresentTime < LISTVIEW_FRAME_INTERVAL )
+        return;
+
+    m_dwListPresentTime = dwNow;
+
+    for( UINT nRow = 0; nRow < m_cListRows; nRow++ )
+    {
+        if( m_ListItems[ nRow ] == LISTVIEW_STALE )
+            FillListRow( nRow );
+    }
+
+    m_bListDirty = FALSE;
+    Render();
+}
+
 }
 ;  // namespace
\ No newline at end of file
@@ -61,6 +61,35 @@ public:
     // method for scrolling the text window up/down
     VOID            ScrollUp( INT nLines );
 
+    // List view: while it's on, the screen shows a window onto a list the
+    // caller owns instead of the text buffer. Only the visible items are asked
+    // for, and their text is kept until they are invalidated or scroll out of
+    // view, so paging through thousands of items formats at most a screenful.
+    typedef VOID ( *LISTVIEW_TEXT_CALLBACK )( UINT nItem, WCHAR* strLine, UINT cchLine, VOID* pContext );
+
+    VOID            BeginListView( UINT nHeaderLines, UINT nFooterLines,
+                                   LISTVIEW_TEXT_CALLBACK pfnGetText, VOID* pContext );
+    VOID            EndListView();
+    UINT            GetListPageSize() const { return m_cListRows; }
+    VOID            SetListCount( UINT nItems );
+    VOID            SetListTop( UINT nTop );
+    VOID            SetListSelection( UINT nItem );
+
+    // Header lines are numbered first, then the footer lines
+    VOID            SetListFixedLine( UINT nLine, LPCWSTR wstrText );
+
+    VOID            InvalidateListItem( UINT nItem );
+    VOID            InvalidateList();
+
+    // Draws the list view, only if something on screen changed since the last
+    // call. Frames are at least LISTVIEW_FRAME_INTERVAL ms apart, a change that
+    // comes sooner is drawn by a later call once the interval has passed.
+    static const DWORD LISTVIEW_FRAME_INTERVAL = 33;
+    VOID            RenderListView();
+
+    // A change is waiting for RenderListView to draw it
+    BOOL            IsListViewPending() const { return m_bListView && m_bListDirty; }
+
     static const INT PAGE_UP    = +255;
     static const INT PAGE_DOWN  = -255;
 
@@ -109,6 +138,31 @@ private:
 
     BOOL m_bSuspendFlag;         // Device suspended tracking flag
 
+    // List view state
+    static const UINT LISTVIEW_STALE = 0xFFFFFFFF;
+
+    BOOL m_bListView;            // Rendering the list view instead of the text buffer
+    BOOL m_bListDirty;           // Screen differs from what was last presented
+    DWORD m_dwListPresentTime;   // When the list view was last presented
+    LISTVIEW_TEXT_CALLBACK m_pfnGetListText;
+    VOID* m_pListContext;
+    UINT m_cListHeader;          // Fixed lines above the list
+    UINT m_cListFooter;          // Fixed lines below it
+    UINT m_cListRows;            // List rows between them
+    UINT m_nListCount;
+    UINT m_nListTop;             // Item in the first row
+    UINT m_nListSelection;
+    FLOAT m_fListIndent;         // Room left of each row for the selection marker
+    WCHAR* m_ListBuffer;         // A line of text per screen line
+    WCHAR** m_ListLines;         // Screen line -> its text, rows are swapped when scrolling
+    UINT* m_ListItems;           // Item whose text each row holds, or LISTVIEW_STALE
+
+    // Fetch the text of a list row and fit it to the screen
+    VOID            FillListRow( UINT nRow );
+
+    // Show the frame just drawn and hand the GPU back for the Guide
+    VOID            PresentAndSuspend();
+
     // Add a character to the current line
     VOID            Add( CHAR ch );
     VOID            Add( WCHAR wch );
@@ -303,4 +303,34 @@ GAMEPAD* Input::GetMergedInput( DWORD dwMask, DWORD* pdwActiveGamePadsMask )
     return &m_DefaultGamepad;
 }
 
+
+//--------------------------------------------------------------------------------------
+// Name: WaitForMergedInput()
+// Desc: Sleeps between reads of the merged input until something is pressed or
+//       the timeout runs out
+//--------------------------------------------------------------------------------------
+GAMEPAD* Input::WaitForMergedInput( DWORD dwTimeoutMs, DWORD dwMask, DWORD dwPollMs )
+{
+    DWORD dwStart = GetTickCount();
+
+    for( ;; )
+    {
+        GAMEPAD* pGamepad = GetMergedInput( dwMask );
+        if( pGamepad->wPressedButtons || pGamepad->bPressedLeftTrigger || pGamepad->bPressedRightTrigger )
+            return pGamepad;
+
+        DWORD dwSleep = dwPollMs;
+        if( dwTimeoutMs != INFINITE )
+        {
+            DWORD dwElapsed = GetTickCount() - dwStart;
+            if( dwElapsed >= dwTimeoutMs )
+                return pGamepad;
+
+            dwSleep = min( dwSleep, dwTimeoutMs - dwElapsed );
+        }
+
+        Sleep( dwSleep );
+    }
+}
+
 } // namespace ATG
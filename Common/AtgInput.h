@@ -79,6 +79,14 @@ public:
 
     // Processes input from all 4 gamepads and merge it into one input
     static GAMEPAD* GetMergedInput( DWORD dwMask = 0, DWORD* pdwActiveGamePadsMask = NULL );
+
+    // Blocks until a button or trigger is pressed on any of the gamepads, or
+    // dwTimeoutMs (which may be INFINITE) runs out, and returns the merged input.
+    // XInput can only be polled, so the state is read every dwPollMs and the
+    // thread sleeps in between, leaving the CPU to other threads. Nothing is
+    // pressed in the returned input if the wait timed out.
+    static const DWORD POLL_INTERVAL = 16;
+    static GAMEPAD* WaitForMergedInput( DWORD dwTimeoutMs, DWORD dwMask = 0, DWORD dwPollMs = POLL_INTERVAL );
 };
 
 } // namespace ATG
@@ -0,0 +1,705 @@
+// Engine tests for the host build. Everything runs against synthetic packages,
+// disc images and stand-in devices built in a scratch folder, so no console
+// content is needed. Run with "make check" from this folder.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "backup.h"
+#include "catalog.h"
+#include "convert.h"
+#include "extract.h"
+#include "header.h"
+#include "journal.h"
+#include "patch.h"
+#include "scan.h"
+#include "svod.h"
+#include "thread.h"
+#include "unlock.h"
+#include "verify.h"
+#include "vfs.h"
+#include "xdvdfs.h"
+
+using std::string;
+using std::vector;
+
+#define TEST_PACKAGE_SIZE	0xB000
+#define TEST_TITLE_ID		0x4D5307E6
+#define TEST_MEDIA_ID		0x2C1A0F3B
+#define TEST_DEVICES		4		// Stand-in devices scanned at once
+#define TEST_DEVICE_TITLES	16		// Titles on each of them
+#define TEST_DEVICE_LATENCY	5		// ms added to every listing and open on a stand-in device
+
+static string scratch;
+static unsigned int checks = 0;
+static unsigned int failures = 0;
+
+#define CHECK(condition) Check((condition), #condition, __FILE__, __LINE__)
+
+static void Check(bool passed, const char* what, const char* file, int line)
+{
+	checks++;
+	if (passed)
+		return;
+	failures++;
+	printf("  FAILED %s:%d: %s\n", file, line, what);
+}
+
+// Same sequence every run, so a failure reproduces
+static DWORD randomState = 0x12345678;
+
+static void FillRandom(BYTE* buffer, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		randomState = randomState * 1103515245 + 12345;
+		buffer[i] = (BYTE)(randomState >> 16);
+	}
+}
+
+static bool WriteFile(const string& path, const vector<BYTE>& data)
+{
+	VfsFile* file = VfsOpen(path.c_str(), VFS_CREATE);
+	if (file == NULL)
+		return false;
+	bool ok = data.empty() || (file->Write(0, &data[0], data.size()) && file->Flush());
+	delete file;
+	return ok;
+}
+
+static bool ReadFile(const string& path, vector<BYTE>& data)
+{
+	vector<char> text;
+	if (!VfsReadFile(path.c_str(), text))
+		return false;
+	data.assign(text.begin(), text.end());
+	return true;
+}
+
+static void CreateDirs(const string& path)
+{
+	for (string::size_type slash = path.find('\\', 1); slash != string::npos; slash = path.find('\\', slash + 1))
+		VfsCreateDir(path.substr(0, slash).c_str());
+	VfsCreateDir(path.c_str());
+}
+
+static void RemoveTree(const string& path)
+{
+	vector<VFS_ENTRY> entries;
+	if (VfsList(path.c_str(), entries))
+	{
+		for (unsigned int i = 0; i < entries.size(); i++)
+			RemoveTree(path + "\\" + entries[i].name);
+	}
+	VfsRemove(path.c_str());
+}
+
+// A header package with random bytes everywhere but the fields the scanner reads
+static vector<BYTE> BuildPackage(DWORD magic, DWORD titleId)
+{
+	vector<BYTE> package(TEST_PACKAGE_SIZE);
+	FillRandom(&package[0], package.size());
+	StfsHeaderWriter writer(&package[0], package.size());
+	writer.Set<STFS_MAGIC>(magic);
+	writer.Set<STFS_CONTENT_TYPE>(GOD_CONTENT_TYPE);
+	writer.Set<STFS_TITLE_ID>(titleId);
+	writer.Set<STFS_MEDIA_ID>(TEST_MEDIA_ID);
+	writer.SetString<STFS_DISPLAY_NAME>(0, L"Test Title");
+	return package;
+}
+
+// What the patch must leave: the original with only the two regions replaced
+static vector<BYTE> ExpectedPatch(const vector<BYTE>& original, bool setLicense)
+{
+	PATCH_REGIONS patched;
+	BuildPatchRegions(&patched, setLicense);
+	vector<BYTE> expected = original;
+	memcpy(&expected[PATCH_SIGNATURE_OFFSET], patched.signature, sizeof(patched.signature));
+	memcpy(&expected[PATCH_LICENSE_OFFSET], patched.license, sizeof(patched.license));
+	return expected;
+}
+
+struct BACKUP_TARGET
+{
+	BackupArchive* archive;
+	const char* path;
+};
+
+static bool BackupTo(const PATCH_REGIONS& original, void* context)
+{
+	BACKUP_TARGET* target = (BACKUP_TARGET*)context;
+	return target->archive->Append(TEST_TITLE_ID, target->path, original);
+}
+
+static void TestPatch()
+{
+	printf("patch, backup and restore\n");
+	string root = scratch + "\\patch";
+	VfsCreateDir(root.c_str());
+	string file = root + "\\LIVE";
+	vector<BYTE> original = BuildPackage(0x4C495645, TEST_TITLE_ID);
+	CHECK(WriteFile(file, original));
+
+	GOD_HEADER_INFO info;
+	CHECK(ClassifyHeader(file.c_str(), &info) == GOD_TYPE_LIVE);
+	CHECK(info.titleId == TEST_TITLE_ID && info.mediaId == TEST_MEDIA_ID);
+
+	BackupArchive archive;
+	CHECK(archive.Open((root + "\\" + BACKUP_ARCHIVE_NAME).c_str()));
+	BACKUP_TARGET target = { &archive, "\\LIVE" };
+	CHECK(PatchHeader(file.c_str(), true, BackupTo, &target) == PATCH_OK);
+
+	vector<BYTE> patched;
+	CHECK(ReadFile(file, patched));
+	CHECK(patched == ExpectedPatch(original, true));
+	CHECK(ClassifyHeader(file.c_str(), &info) == GOD_TYPE_UNLOCKED);
+	CHECK(archive.Entries().size() == 1);
+
+	// A second unlock must neither write nor back up the unlocked header
+	CHECK(PatchHeader(file.c_str(), true, BackupTo, &target) == PATCH_ALREADY_UNLOCKED);
+	CHECK(archive.Entries().size() == 1);
+	PATCH_REGIONS unlocked;
+	BuildPatchRegions(&unlocked, true);
+	CHECK(IsUnlockedRegions(unlocked));
+	CHECK(!archive.Append(TEST_TITLE_ID, "\\LIVE", unlocked));
+
+	// The record survives reopening and puts back exactly the original bytes
+	archive.Close();
+	CHECK(archive.Open((root + "\\" + BACKUP_ARCHIVE_NAME).c_str()));
+	const BACKUP_ENTRY* entry = archive.Find("\\LIVE");
+	CHECK(entry != NULL);
+	CHECK(archive.Find("\\live") == entry && archive.Find("\\LIV") == NULL);
+	if (entry)
+		CHECK(RestoreHeader(archive, *entry, root) == RESTORE_OK);
+	vector<BYTE> restored;
+	CHECK(ReadFile(file, restored));
+	CHECK(restored == original);
+
+	// Spoofed packages get the LIVE magic, bundles a wiped license
+	string pirs = root + "\\PIRS";
+	vector<BYTE> pirsOriginal = BuildPackage(0x50495253, TEST_TITLE_ID);
+	CHECK(WriteFile(pirs, pirsOriginal));
+	CHECK(ClassifyHeader(pirs.c_str(), &info) == GOD_TYPE_PIRS);
+	CHECK(PatchHeader(pirs.c_str(), false) == PATCH_OK);
+	CHECK(ReadFile(pirs, patched));
+	CHECK(patched == ExpectedPatch(pirsOriginal, false));
+	bool wiped = true;
+	for (unsigned int i = 0; i < PATCH_LICENSE_SIZE; i++)
+		wiped = wiped && patched[PATCH_LICENSE_OFFSET + i] == 0;
+	CHECK(wiped);
+
+	string tiny = root + "\\TINY";
+	CHECK(WriteFile(tiny, vector<BYTE>(0x100)));
+	CHECK(PatchHeader(tiny.c_str(), true) == PATCH_TOO_SMALL);
+	CHECK(PatchHeader((root + "\\MISSING").c_str(), true) == PATCH_OPEN_FAILED);
+}
+
+static void TestUnlockExecutor()
+{
+	printf("unlock executor\n");
+	string root = scratch + "\\executor";
+	VfsCreateDir(root.c_str());
+	vector<string> devices;
+	vector<BackupArchive*> archives;
+	vector<PatchJournal*> journals;
+	vector<vector<BYTE> > originals;
+	UnlockExecutor executor;
+	for (unsigned int device = 0; device < 2; device++)
+	{
+		char name[16];
+		sprintf(name, "\\dev%u", device);
+		devices.push_back(root + name);
+		VfsCreateDir(devices.back().c_str());
+		archives.push_back(new BackupArchive);
+		CHECK(archives.back()->Open((devices.back() + "\\" + BACKUP_ARCHIVE_NAME).c_str()));
+		journals.push_back(new PatchJournal);
+		CHECK(journals.back()->Open((devices.back() + "\\" + JOURNAL_FILE_NAME).c_str()));
+	}
+
+	vector<UNLOCK_JOB> jobs;
+	for (unsigned int i = 0; i < 10; i++)
+	{
+		UNLOCK_JOB job;
+		job.index = i;
+		job.device = i % devices.size();
+		char name[16];
+		sprintf(name, "\\%08X", i);
+		job.path = devices[job.device] + name;
+		job.rootLength = devices[job.device].length();
+		job.titleId = TEST_TITLE_ID + i;
+		job.setLicense = true;
+		job.archive = archives[job.device];
+		job.journal = journals[job.device];
+		originals.push_back(BuildPackage(0x4C495645, job.titleId));
+		CHECK(WriteFile(job.path, originals.back()));
+		jobs.push_back(job);
+	}
+
+	for (unsigned int i = 0; i < jobs.size(); i++)
+		executor.Add(jobs[i]);
+	CHECK(executor.Run(NULL, NULL) == 0);
+	for (unsigned int i = 0; i < jobs.size(); i++)
+	{
+		vector<BYTE> patched;
+		CHECK(ReadFile(jobs[i].path, patched));
+		CHECK(patched == ExpectedPatch(originals[i], true));
+	}
+	CHECK(archives[0]->Entries().size() == 5 && archives[1]->Entries().size() == 5);
+
+	// Running the same titles again reports them unlocked and adds no records
+	for (unsigned int i = 0; i < jobs.size(); i++)
+		executor.Add(jobs[i]);
+	CHECK(executor.Run(NULL, NULL) == 0);
+	CHECK(archives[0]->Entries().size() == 5 && archives[1]->Entries().size() == 5);
+
+	// One title comes back on its own, the rest stay unlocked
+	unsigned int titleFailed = 0;
+	CHECK(RestoreTitle(*archives[0], devices[0], jobs[2].titleId, &titleFailed) == 1 && titleFailed == 0);
+	CHECK(RestoreTitle(*archives[0], devices[0], jobs[1].titleId, &titleFailed) == 0 && titleFailed == 0);
+	for (unsigned int i = 0; i < jobs.size(); i++)
+	{
+		vector<BYTE> current;
+		CHECK(ReadFile(jobs[i].path, current));
+		CHECK(current == (i == 2 ? originals[i] : ExpectedPatch(originals[i], true)));
+	}
+
+	for (unsigned int device = 0; device < devices.size(); device++)
+	{
+		unsigned int failed = 0;
+		CHECK(RestoreAll(*archives[device], devices[device], &failed) == 5 && failed == 0);
+		delete archives[device];
+		delete journals[device];
+	}
+	for (unsigned int i = 0; i < jobs.size(); i++)
+	{
+		vector<BYTE> restored;
+		CHECK(ReadFile(jobs[i].path, restored));
+		CHECK(restored == originals[i]);
+	}
+}
+
+static void TestJournalRecovery()
+{
+	printf("journal recovery\n");
+	string root = scratch + "\\journal";
+	VfsCreateDir(root.c_str());
+	vector<BYTE> original = BuildPackage(0x4C495645, TEST_TITLE_ID);
+	CHECK(WriteFile(root + "\\TORN", original));
+	vector<BYTE> locked = BuildPackage(0x4C495645, TEST_TITLE_ID + 1);
+	CHECK(WriteFile(root + "\\DONE", ExpectedPatch(locked, true)));
+	CHECK(WriteFile(root + "\\AGAIN", ExpectedPatch(original, true)));
+
+	vector<JOURNAL_ENTRY> entries(3);
+	entries[0].titleId = TEST_TITLE_ID;
+	entries[0].path = "\\TORN";
+	ReadHeaderRegions((root + "\\TORN").c_str(), &entries[0].original);
+	BuildPatchRegions(&entries[0].patched, true);
+	entries[1].titleId = TEST_TITLE_ID + 1;
+	entries[1].path = "\\DONE";
+	memcpy(entries[1].original.signature, &locked[PATCH_SIGNATURE_OFFSET], PATCH_SIGNATURE_SIZE);
+	memcpy(entries[1].original.license, &locked[PATCH_LICENSE_OFFSET], PATCH_LICENSE_SIZE);
+	BuildPatchRegions(&entries[1].patched, true);
+	// Journaled from a header that was already unlocked
+	entries[2].titleId = TEST_TITLE_ID;
+	entries[2].path = "\\AGAIN";
+	BuildPatchRegions(&entries[2].original, true);
+	BuildPatchRegions(&entries[2].patched, true);
+
+	PatchJournal journal;
+	DWORD sequence;
+	CHECK(journal.Open((root + "\\" + JOURNAL_FILE_NAME).c_str()));
+	CHECK(journal.Begin(entries, &sequence));
+	journal.Close();
+
+	// Half the new signature made it to TORN before the "crash"
+	vector<BYTE> torn = original;
+	memcpy(&torn[0], HeaderMain, PATCH_SIGNATURE_SIZE / 2);
+	CHECK(WriteFile(root + "\\TORN", torn));
+
+	BackupArchive archive;
+	CHECK(archive.Open((root + "\\" + BACKUP_ARCHIVE_NAME).c_str()));
+	CHECK(journal.Open((root + "\\" + JOURNAL_FILE_NAME).c_str()));
+	CHECK(journal.PendingCount() == 3);
+	JOURNAL_RECOVERY report;
+	CHECK(journal.Recover(root, &archive, &report));
+	CHECK(report.rolledBack == 1 && report.completed == 2 && report.failed == 0);
+	vector<BYTE> recovered;
+	CHECK(ReadFile(root + "\\TORN", recovered));
+	CHECK(recovered == original);
+	CHECK(archive.Entries().size() == 1 && archive.Find("\\DONE") != NULL && archive.Find("\\AGAIN") == NULL);
+	CHECK(journal.PendingCount() == 0);
+}
+
+// A device that can be made to go away in the middle of a write: the first
+// write after tearWrites is set lands half way, and nothing after it lands at
+// all. Paths under prefix map to the folder.
+static volatile bool tearWrites = false;
+static volatile bool torn = false;
+
+class TearingFile : public VfsFile
+{
+public:
+	TearingFile(VfsFile* file) : m_file(file) {}
+	~TearingFile() { delete m_file; }
+
+	bool Read(unsigned long long offset, void* buffer, DWORD size, DWORD* read) { return m_file->Read(offset, buffer, size, read); }
+	bool Write(unsigned long long offset, const void* buffer, DWORD size)
+	{
+		if (!tearWrites)
+			return m_file->Write(offset, buffer, size);
+		if (!torn)
+			m_file->Write(offset, buffer, size / 2);
+		torn = true;
+		return false;
+	}
+	unsigned long long Size() { return m_file->Size(); }
+	bool Flush() { return m_file->Flush(); }
+
+private:
+	VfsFile* m_file;
+};
+
+class TearingDevice : public Vfs
+{
+public:
+	TearingDevice(const string& prefix, const string& folder) : m_prefix(prefix), m_folder(folder) {}
+
+	VfsFile* Open(const char* path, VFS_MODE mode)
+	{
+		VfsFile* file = NativeVfs()->Open(Map(path).c_str(), mode);
+		return file ? new TearingFile(file) : NULL;
+	}
+	bool List(const char* dir, vector<VFS_ENTRY>& entries) { return NativeVfs()->List(Map(dir).c_str(), entries); }
+	bool CreateDir(const char* path) { return NativeVfs()->CreateDir(Map(path).c_str()); }
+	bool Remove(const char* path) { return NativeVfs()->Remove(Map(path).c_str()); }
+
+private:
+	string Map(const char* path) const { return m_folder + (path + m_prefix.length()); }
+
+	string m_prefix;
+	string m_folder;
+};
+
+static void TestTornUnlock()
+{
+	printf("unlock torn by a failed write\n");
+	string folder = scratch + "\torn";
+	VfsCreateDir(folder.c_str());
+	VfsMount("torn:", new TearingDevice("torn:", folder));
+	string root = "torn:";
+	vector<BYTE> original = BuildPackage(0x4C495645, TEST_TITLE_ID);
+	CHECK(WriteFile(root + "\\PACKAGE", original));
+
+	BackupArchive archive;
+	PatchJournal journal;
+	CHECK(archive.Open((folder + "\\" + BACKUP_ARCHIVE_NAME).c_str()));
+	CHECK(journal.Open((folder + "\\" + JOURNAL_FILE_NAME).c_str()));
+	UNLOCK_JOB job;
+	job.index = 0;
+	job.device = 0;
+	job.path = root + "\\PACKAGE";
+	job.rootLength = root.length();
+	job.titleId = TEST_TITLE_ID;
+	job.setLicense = true;
+	job.archive = &archive;
+	job.journal = &journal;
+
+	// The patch tears and the original can't be put back
+	UnlockExecutor executor;
+	executor.Add(job);
+	tearWrites = true;
+	CHECK(executor.Run(NULL, NULL) == 1);
+	tearWrites = false;
+	journal.Close();
+
+	// The group was left open, so the next start rolls the package back
+	CHECK(journal.Open((folder + "\\" + JOURNAL_FILE_NAME).c_str()));
+	CHECK(journal.PendingCount() == 1);
+	JOURNAL_RECOVERY report;
+	CHECK(journal.Recover(root, &archive, &report));
+	CHECK(report.rolledBack == 1 && report.failed == 0);
+	vector<BYTE> recovered;
+	CHECK(ReadFile(root + "\\PACKAGE", recovered));
+	CHECK(recovered == original);
+}
+
+static void PutLE16(BYTE* p, DWORD value)
+{
+	p[0] = (BYTE)value;
+	p[1] = (BYTE)(value >> 8);
+}
+
+static void PutLE32(BYTE* p, DWORD value)
+{
+	PutLE16(p, value);
+	PutLE16(p + 2, value >> 16);
+}
+
+static void PutBE32(BYTE* p, DWORD value)
+{
+	p[0] = (BYTE)(value >> 24);
+	p[1] = (BYTE)(value >> 16);
+	p[2] = (BYTE)(value >> 8);
+	p[3] = (BYTE)value;
+}
+
+// A bare game partition: the volume descriptor, a root table holding data.bin
+// and default.xex, the two files, then padding that trimming should drop
+static vector<BYTE> BuildDiscImage(DWORD dataSize, DWORD padding, unsigned long long* used)
+{
+	const DWORD rootSector = XDVDFS_VOLUME_SECTOR + 1;
+	const DWORD xexSector = rootSector + 1;
+	const DWORD xexSize = 0x38;
+	const DWORD dataSector = xexSector + 1;
+	DWORD dataSectors = (dataSize + XDVDFS_SECTOR_SIZE - 1) / XDVDFS_SECTOR_SIZE;
+	*used = (unsigned long long)(dataSector + dataSectors) * XDVDFS_SECTOR_SIZE;
+	vector<BYTE> image((size_t)*used + padding);
+	FillRandom(&image[0], image.size());
+
+	BYTE* volume = &image[XDVDFS_VOLUME_SECTOR * XDVDFS_SECTOR_SIZE];
+	memcpy(volume, XDVDFS_MAGIC, XDVDFS_MAGIC_SIZE);
+	PutLE32(volume + 0x14, rootSector);
+	PutLE32(volume + 0x18, XDVDFS_SECTOR_SIZE);
+	memcpy(volume + XDVDFS_SECTOR_SIZE - XDVDFS_MAGIC_SIZE, XDVDFS_MAGIC, XDVDFS_MAGIC_SIZE);
+
+	// data.bin sorts first, so it's the tree's root with default.xex to its right
+	BYTE* table = &image[rootSector * XDVDFS_SECTOR_SIZE];
+	memset(table, 0xFF, XDVDFS_SECTOR_SIZE);
+	PutLE16(table, 0);
+	PutLE16(table + 2, 24 / 4);
+	PutLE32(table + 4, dataSector);
+	PutLE32(table + 8, dataSize);
+	table[12] = 0;
+	table[13] = 8;
+	memcpy(table + XDVDFS_DIRENT_MIN_SIZE, "data.bin", 8);
+	BYTE* xexEntry = table + 24;
+	PutLE16(xexEntry, 0);
+	PutLE16(xexEntry + 2, 0);
+	PutLE32(xexEntry + 4, xexSector);
+	PutLE32(xexEntry + 8, xexSize);
+	xexEntry[12] = 0;
+	xexEntry[13] = 11;
+	memcpy(xexEntry + XDVDFS_DIRENT_MIN_SIZE, "default.xex", 11);
+
+	// XEX2 with one optional header, the execution id
+	BYTE* xex = &image[xexSector * XDVDFS_SECTOR_SIZE];
+	memset(xex, 0, xexSize);
+	PutBE32(xex, 0x58455832);
+	PutBE32(xex + 0x14, 1);
+	PutBE32(xex + 0x18, CONVERT_XEX_EXECUTION_INFO);
+	PutBE32(xex + 0x1C, 0x20);
+	PutBE32(xex + 0x20, TEST_MEDIA_ID);
+	PutBE32(xex + 0x24, 1);
+	PutBE32(xex + 0x28, 0);
+	PutBE32(xex + 0x2C, TEST_TITLE_ID);
+	xex[0x32] = 1;
+	xex[0x33] = 1;
+	return image;
+}
+
+static void TestConvert()
+{
+	printf("disc image to GOD and back\n");
+	string root = scratch + "\\convert";
+	VfsCreateDir(root.c_str());
+	// Several groups and a partial last block, with a megabyte of padding behind it
+	unsigned long long used;
+	vector<BYTE> image = BuildDiscImage(3 * SVOD_BLOCKS_PER_GROUP * SVOD_BLOCK_SIZE + 0x1234, 0x100000, &used);
+	string imagePath = root + "\\game.iso";
+	CHECK(WriteFile(imagePath, image));
+
+	string content = root + "\\Content";
+	CONVERT_REPORT report;
+	unsigned long start = TickCount();
+	CHECK(ConvertISO(imagePath.c_str(), content.c_str(), L"Synthetic", true, true, CpuCount(), &report) == CONVERT_OK);
+	printf("  converted %llu KB in %lu ms, %u parts\n", report.bytesRead >> 10, TickCount() - start, report.parts);
+	CHECK(report.bytesRead == used);
+	CHECK(report.bytesSaved == image.size() - used);
+
+	GOD_HEADER_INFO info;
+	CHECK(ClassifyHeader(report.headerPath.c_str(), &info) == GOD_TYPE_UNLOCKED);
+	CHECK(info.titleId == TEST_TITLE_ID && info.mediaId == TEST_MEDIA_ID);
+
+	VERIFY_REPORT verify;
+	CHECK(VerifyGOD(report.headerPath.c_str(), CpuCount(), &verify) == VERIFY_OK);
+
+	// The image comes back byte for byte, up to the block the package was padded to
+	string extracted = root + "\\extracted.iso";
+	EXTRACT_REPORT extract;
+	CHECK(ExtractGOD(report.headerPath.c_str(), extracted.c_str(), true, &extract) == EXTRACT_OK);
+	vector<BYTE> roundTrip;
+	CHECK(ReadFile(extracted, roundTrip));
+	CHECK(roundTrip.size() >= used && memcmp(&roundTrip[0], &image[0], (size_t)used) == 0);
+	bool padded = true;
+	for (size_t i = (size_t)used; i < roundTrip.size(); i++)
+		padded = padded && roundTrip[i] == 0;
+	CHECK(padded);
+
+	// Extracting again must leave the image already there alone
+	vector<BYTE> marker(16, 0xA5);
+	CHECK(WriteFile(extracted, marker));
+	CHECK(ExtractGOD(report.headerPath.c_str(), extracted.c_str(), true, &extract) == EXTRACT_EXISTS);
+	vector<BYTE> untouched;
+	CHECK(ReadFile(extracted, untouched));
+	CHECK(untouched == marker);
+	VfsRemove(extracted.c_str());
+
+	// A second conversion must leave the package it would collide with alone
+	vector<BYTE> header;
+	CHECK(ReadFile(report.headerPath, header));
+	CONVERT_REPORT again;
+	CHECK(ConvertISO(imagePath.c_str(), content.c_str(), L"Synthetic", true, true, CpuCount(), &again) == CONVERT_EXISTS);
+	vector<BYTE> kept;
+	CHECK(ReadFile(report.headerPath, kept));
+	CHECK(kept == header);
+	CHECK(VerifyGOD(report.headerPath.c_str(), CpuCount(), &verify) == VERIFY_OK);
+
+	// A flipped bit in the data is found in the block that holds it
+	string part = SvodPartPath(report.headerPath, 0);
+	vector<BYTE> data;
+	CHECK(ReadFile(part, data));
+	unsigned long long corrupt = SVOD_BLOCK_SIZE + SVOD_GROUP_SIZE + 2 * SVOD_BLOCK_SIZE + 7;
+	data[(size_t)corrupt] ^= 0x01;
+	CHECK(WriteFile(part, data));
+	CHECK(VerifyGOD(report.headerPath.c_str(), CpuCount(), &verify) == VERIFY_HASH_MISMATCH);
+	CHECK(verify.part == 0 && verify.block == SVOD_BLOCKS_PER_GROUP + 1);
+
+	// Packages whose data doesn't start at block 0 are refused
+	StfsHeaderWriter writer(&header[0], header.size());
+	writer.Set<STFS_SVOD_DATA_BLOCK_OFFSET>(1);
+	CHECK(WriteFile(report.headerPath, header));
+	CHECK(VerifyGOD(report.headerPath.c_str(), CpuCount(), &verify) == VERIFY_UNSUPPORTED);
+	CHECK(ExtractGOD(report.headerPath.c_str(), extracted.c_str(), false, &extract) == EXTRACT_UNSUPPORTED);
+}
+
+// A directory standing in for a device, with a fixed delay on every listing and
+// open like a slow bus. Paths under prefix map to the folder.
+class StandInDevice : public Vfs
+{
+public:
+	StandInDevice(const string& prefix, const string& folder) : m_prefix(prefix), m_folder(folder) {}
+
+	VfsFile* Open(const char* path, VFS_MODE mode)
+	{
+		SleepFor(TEST_DEVICE_LATENCY);
+		return NativeVfs()->Open(Map(path).c_str(), mode);
+	}
+	bool List(const char* dir, vector<VFS_ENTRY>& entries)
+	{
+		SleepFor(TEST_DEVICE_LATENCY);
+		return NativeVfs()->List(Map(dir).c_str(), entries);
+	}
+	bool CreateDir(const char* path) { return NativeVfs()->CreateDir(Map(path).c_str()); }
+	bool Remove(const char* path) { return NativeVfs()->Remove(Map(path).c_str()); }
+
+private:
+	string Map(const char* path) const { return m_folder + (path + m_prefix.length()); }
+
+	string m_prefix;
+	string m_folder;
+};
+
+struct SCAN_COUNTS
+{
+	CriticalSection lock;
+	Catalog catalog;
+	unsigned int found[TEST_DEVICES];
+	unsigned long elapsed[TEST_DEVICES];
+};
+
+static void OnFound(int device, const string& fileName, const string& path, const GOD_HEADER_INFO& header, void* context)
+{
+	SCAN_COUNTS* counts = (SCAN_COUNTS*)context;
+	counts->catalog.Add(device, fileName, path, header);
+}
+
+static void OnDevice(int device, const string& /*root*/, unsigned int found, unsigned long elapsedMs, void* context)
+{
+	SCAN_COUNTS* counts = (SCAN_COUNTS*)context;
+	ScopedLock lock(counts->lock);
+	counts->found[device] = found;
+	counts->elapsed[device] = elapsedMs;
+}
+
+static void TestParallelScan()
+{
+	printf("scan of %u stand-in devices\n", TEST_DEVICES);
+	string root = scratch + "\\devices";
+	VfsCreateDir(root.c_str());
+	vector<BYTE> package = BuildPackage(0x4C495645, TEST_TITLE_ID);
+	SCAN_COUNTS counts;
+	memset(counts.found, 0, sizeof(counts.found));
+	memset(counts.elapsed, 0, sizeof(counts.elapsed));
+	ScanScheduler* scanner = new ScanScheduler(OnFound, OnDevice, &counts);
+	for (unsigned int device = 0; device < TEST_DEVICES; device++)
+	{
+		char name[32];
+		sprintf(name, "\\dev%u", device);
+		string folder = root + name;
+		for (unsigned int title = 0; title < TEST_DEVICE_TITLES; title++)
+		{
+			char titlePath[64];
+			sprintf(titlePath, "\\Content\\0000000000000000\\%08X\\00007000", TEST_TITLE_ID + title);
+			CreateDirs(folder + titlePath);
+			WriteFile(folder + titlePath + "\\PACKAGE", package);
+		}
+		sprintf(name, "standin%u:", device);
+		VfsMount(strdup(name), new StandInDevice(name, folder));
+		scanner->AddDevice(string(name) + "\\Content\\0000000000000000");
+	}
+
+	unsigned long start = TickCount();
+	scanner->Start();
+	scanner->Wait();
+	unsigned long wall = TickCount() - start;
+	delete scanner;
+
+	unsigned long sum = 0;
+	for (unsigned int device = 0; device < TEST_DEVICES; device++)
+	{
+		CHECK(counts.found[device] == TEST_DEVICE_TITLES);
+		sum += counts.elapsed[device];
+	}
+	CHECK(counts.catalog.Count() == TEST_DEVICES * TEST_DEVICE_TITLES);
+	printf("  %u titles in %lu ms, %lu ms if the devices were scanned one after another\n", counts.catalog.Count(), wall, sum);
+	// The devices overlap, so the scan takes about as long as the slowest one
+	CHECK(wall * 4 < sum * 3);
+
+	// A root per device and a title folder per title, however many devices hold it
+	std::set<STRING_ID> roots;
+	std::set<STRING_ID> folders;
+	for (unsigned int i = 0; i < counts.catalog.Count(); i++)
+	{
+		roots.insert(counts.catalog.Entry(i).root);
+		folders.insert(counts.catalog.Entry(i).folder);
+	}
+	CHECK(roots.size() == TEST_DEVICES && folders.size() == TEST_DEVICE_TITLES);
+}
+
+int main(int argc, char** argv)
+{
+	char folder[] = "/tmp/godtestXXXXXX";
+	if (argc > 1)
+		scratch = argv[1];
+	else if (mkdtemp(folder))
+		scratch = folder;
+	else
+	{
+		fprintf(stderr, "Unable to create a scratch folder\n");
+		return 2;
+	}
+	VfsCreateDir(scratch.c_str());
+
+	TestPatch();
+	TestUnlockExecutor();
+	TestJournalRecovery();
+	TestTornUnlock();
+	TestConvert();
+	TestParallelScan();
+
+	RemoveTree(scratch);
+	printf("%u checks, %u failed\n", checks, failures);
+	return failures ? 1 : 0;
+}
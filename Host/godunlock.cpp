@@ -0,0 +1,589 @@
+// Command line front end for the scan/unlock engine, for driving it from a PC
+// against a mounted device, a copy of its Content folder, or a raw FATX image
+// (drive dump, partition dump or block device) read without mounting.
+// Built with the Makefile beside it.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "backup.h"
+#include "catalog.h"
+#include "convert.h"
+#include "extract.h"
+#include "fatx.h"
+#include "header.h"
+#include "index.h"
+#include "journal.h"
+#include "log.h"
+#include "patch.h"
+#include "rules.h"
+#include "scan.h"
+#include "unlock.h"
+#include "verify.h"
+#include "vfs.h"
+
+using std::string;
+using std::vector;
+
+// Same profile folder the console build scans
+static const char* ContentPath = "\\Content\\0000000000000000";
+
+static Catalog catalog;
+static RuleTable rules;
+static vector<string> devices;
+static vector<string> archiveFiles;
+static vector<BackupArchive*> backups;
+static vector<string> journalFiles;
+static vector<PatchJournal*> journals;
+static vector<FatxVolume*> volumes;
+
+static void OnGODFound(int device, const string& fileName, const string& path, const GOD_HEADER_INFO& header, void* /*context*/)
+{
+	GOD_HEADER_INFO classified = header;
+	classified.type = rules.Classify(header);
+	catalog.Add(device, fileName, path, classified);
+}
+
+static void OnDeviceScanned(int device, const string& /*root*/, unsigned int found, unsigned long elapsedMs, void* /*context*/)
+{
+	printf("%s: %u GOD titles in %lu ms\n", devices[device].c_str(), found, elapsedMs);
+}
+
+static BackupArchive* GetBackupArchive(int device)
+{
+	if (backups[device] == NULL)
+	{
+		backups[device] = new BackupArchive;
+		if (!backups[device]->Open(archiveFiles[device].c_str()))
+			fprintf(stderr, "Unable to open backup archive at: %s\n", archiveFiles[device].c_str());
+	}
+	return backups[device];
+}
+
+static PatchJournal* GetJournal(int device)
+{
+	if (journals[device] == NULL)
+	{
+		journals[device] = new PatchJournal;
+		if (!journals[device]->Open(journalFiles[device].c_str()))
+			fprintf(stderr, "Unable to open patch journal at: %s\n", journalFiles[device].c_str());
+	}
+	return journals[device];
+}
+
+// Settles unlocks a crash cut short, before anything reads or patches the headers
+static unsigned int RecoverJournals()
+{
+	unsigned int failed = 0;
+	for (unsigned int i = 0; i < devices.size(); i++)
+	{
+		// Also empties a journal whose groups all committed
+		PatchJournal* journal = GetJournal(i);
+		unsigned int pending = journal->PendingCount();
+		JOURNAL_RECOVERY report;
+		journal->Recover(devices[i], GetBackupArchive(i), &report);
+		if (pending == 0)
+			continue;
+		printf("%s: recovered %u interrupted unlocks (%u completed, %u rolled back), %u failed\n", devices[i].c_str(),
+			report.completed + report.rolledBack, report.completed, report.rolledBack, report.failed);
+		failed += report.failed;
+	}
+	return failed;
+}
+
+// The backup archive and journal are opened here, before the executor's workers start
+static void AddUnlockJob(UnlockExecutor& executor, unsigned int index, bool setLicense)
+{
+	UNLOCK_JOB job;
+	job.index = index;
+	job.device = catalog.Entry(index).device;
+	job.path = catalog.FullPath(index);
+	job.rootLength = devices[job.device].length();
+	job.titleId = catalog.Entry(index).titleId;
+	job.setLicense = setLicense;
+	job.archive = GetBackupArchive(job.device);
+	job.journal = GetJournal(job.device);
+	executor.Add(job);
+}
+
+static void OnUnlocked(const UNLOCK_RESULT& result, unsigned int done, unsigned int total, void* /*context*/)
+{
+	unsigned int index = result.index;
+	bool unlocked = result.result == PATCH_OK || result.result == PATCH_ALREADY_UNLOCKED;
+	const char* status = result.result == PATCH_OK ? "Unlocked" : unlocked ? "Already unlocked" : "FAILED";
+	printf("[%u/%u] %s %ls (%08X): %s", done, total, status, catalog.Title(index),
+		catalog.Entry(index).titleId, catalog.FullPath(index).c_str());
+	if (!unlocked)
+		printf(" (%d)", result.result);
+	printf("\n");
+	catalog.SetStatus(index, unlocked ? CATALOG_STATUS_UNLOCKED : CATALOG_STATUS_FAILED);
+}
+
+static bool VerifyGODData(unsigned int index, unsigned int threads, VerifyCheckpoints* checkpoints)
+{
+	string godFile = catalog.FullPath(index);
+	VERIFY_REPORT report;
+	VERIFY_RESULT result = VerifyGOD(godFile.c_str(), threads, &report, checkpoints);
+	printf("%08X %ls: ", catalog.Entry(index).titleId, catalog.Title(index));
+	switch (result)
+	{
+	case VERIFY_OK:
+		printf("OK, %llu MB in %lu ms (%u MB/s)", report.bytes >> 20, report.elapsedMs, report.MBps());
+		if (report.partsSkipped)
+			printf(", %u parts unchanged since last verified", report.partsSkipped);
+		printf("\n");
+		return true;
+	case VERIFY_BAD_HEADER:
+		printf("not an SVOD package\n");
+		break;
+	case VERIFY_UNSUPPORTED:
+		printf("data doesn't start at block 0, not supported\n");
+		break;
+	case VERIFY_MISSING_PART:
+		printf("Data%04u is missing or the wrong size\n", report.part);
+		break;
+	case VERIFY_READ_FAILED:
+		printf("read failed in Data%04u at 0x%llX\n", report.part, report.offset);
+		break;
+	case VERIFY_HASH_MISMATCH:
+		if (report.block == VERIFY_HASH_BLOCK)
+			printf("BAD hash block in Data%04u at 0x%llX\n", report.part, report.offset);
+		else
+			printf("BAD data block %u (Data%04u at 0x%llX)\n", report.block, report.part, report.offset);
+		break;
+	}
+	return false;
+}
+
+static void OnConvertProgress(unsigned long long done, unsigned long long total, void* /*context*/)
+{
+	// A line every 64MB is plenty
+	if ((done >> 26) != ((done - 1) >> 26) || done == total)
+		fprintf(stderr, "\r%llu / %llu MB", done >> 20, total >> 20);
+}
+
+static bool PrintConversion(const char* source, CONVERT_RESULT result, const CONVERT_REPORT& report)
+{
+	fprintf(stderr, "\n");
+	switch (result)
+	{
+	case CONVERT_OK:
+		printf("%s: %u parts, %llu MB in %lu ms (%u MB/s)\n", report.headerPath.c_str(), report.parts,
+			report.bytesWritten >> 20, report.elapsedMs, report.MBps());
+		if (report.bytesSaved)
+			printf("  trimmed %llu MB of unused sectors\n", report.bytesSaved >> 20);
+		return true;
+	case CONVERT_OPEN_FAILED:
+		printf("%s: unable to open\n", source);
+		break;
+	case CONVERT_NOT_XDVDFS:
+		printf("%s: no Xbox game partition found\n", source);
+		break;
+	case CONVERT_NO_XEX:
+		printf("%s: default.xex is missing or has no execution id\n", source);
+		break;
+	case CONVERT_UNSUPPORTED:
+		printf("%s: data doesn't start at block 0, not supported\n", source);
+		break;
+	case CONVERT_EXISTS:
+		printf("%s: already exists, not overwritten\n", report.headerPath.c_str());
+		break;
+	case CONVERT_CREATE_FAILED:
+		printf("%s: unable to create the package\n", report.headerPath.c_str());
+		break;
+	case CONVERT_READ_FAILED:
+		printf("%s: read failed\n", source);
+		break;
+	case CONVERT_WRITE_FAILED:
+		printf("%s: write failed\n", report.headerPath.c_str());
+		break;
+	}
+	return false;
+}
+
+static int ConvertImage(const char* image, const char* root, const char* name, bool setLicense, bool trim, unsigned int threads)
+{
+	vector<WCHAR> wideName;
+	if (name)
+	{
+		for (; *name; name++)
+			wideName.push_back((WCHAR)(unsigned char)*name);
+		wideName.push_back(0);
+	}
+
+	CONVERT_REPORT report;
+	CONVERT_RESULT result = ConvertISO(image, (string(root) + ContentPath).c_str(), wideName.empty() ? NULL : &wideName[0],
+		setLicense, trim, threads, &report, OnConvertProgress, NULL);
+	return PrintConversion(image, result, report) ? 0 : 1;
+}
+
+// Each install becomes a GOD package on the device it was found on
+static unsigned int ConvertNXEInstalls(bool setLicense, bool trim, unsigned int threads)
+{
+	vector<NXE> installs;
+	for (unsigned int i = 0; i < devices.size(); i++)
+		FindNXEInstalls(i, devices[i] + ContentPath, installs);
+	printf("%u NXE installs found\n", (unsigned int)installs.size());
+
+	unsigned int failed = 0;
+	for (unsigned int i = 0; i < installs.size(); i++)
+	{
+		printf("%08X %ls: %s\n", installs[i].title.titleId, installs[i].title.name, installs[i].path.c_str());
+		CONVERT_REPORT report;
+		CONVERT_RESULT result = ConvertNXE(installs[i], (devices[installs[i].device] + ContentPath).c_str(), setLicense,
+			trim, threads, &report, OnConvertProgress, NULL);
+		if (!PrintConversion(installs[i].path.c_str(), result, report))
+			failed++;
+	}
+	return failed;
+}
+
+static bool ExtractGODImage(unsigned int index, const char* folder, bool verify)
+{
+	EXTRACT_REPORT report;
+	EXTRACT_RESULT result = ExtractGOD(catalog, index, folder, verify, &report, OnConvertProgress, NULL);
+	fprintf(stderr, "\n");
+	printf("%08X %ls: ", catalog.Entry(index).titleId, catalog.Title(index));
+	switch (result)
+	{
+	case EXTRACT_OK:
+		printf("%llu MB in %lu ms (%u MB/s)%s\n", report.bytes >> 20, report.elapsedMs, report.MBps(), verify ? ", verified" : "");
+		return true;
+	case EXTRACT_BAD_HEADER:
+		printf("not an SVOD package\n");
+		break;
+	case EXTRACT_EXISTS:
+		printf("an image is already in %s, not overwritten\n", folder);
+		break;
+	case EXTRACT_UNSUPPORTED:
+		printf("data doesn't start at block 0, not supported\n");
+		break;
+	case EXTRACT_MISSING_PART:
+		printf("Data%04u is missing or the wrong size\n", report.part);
+		break;
+	case EXTRACT_READ_FAILED:
+		printf("read failed in Data%04u at 0x%llX\n", report.part, report.offset);
+		break;
+	case EXTRACT_WRITE_FAILED:
+		printf("unable to write the image in %s\n", folder);
+		break;
+	case EXTRACT_HASH_MISMATCH:
+		printf("BAD block in Data%04u at 0x%llX, nothing kept\n", report.part, report.offset);
+		break;
+	}
+	return false;
+}
+
+static void ListGODs(const char* heading, GOD_TYPE type)
+{
+	const CatalogView& view = catalog.View(type);
+	if (view.empty())
+		return;
+	printf("%s\n", heading);
+	for (unsigned int i = 0; i < view.size(); i++)
+		printf("  %08X  %ls  %s\n", catalog.Entry(view[i]).titleId, catalog.Title(view[i]), catalog.FullPath(view[i]).c_str());
+}
+
+static void ListDuplicates()
+{
+	vector<CatalogView> groups;
+	catalog.FindDuplicates(groups);
+	if (groups.empty())
+		return;
+	printf("Duplicates (* is the copy kept):\n");
+	for (unsigned int g = 0; g < groups.size(); g++)
+	{
+		const CatalogView& group = groups[g];
+		printf("  %08X  %ls  %llu MB each\n", catalog.Entry(group[0]).titleId, catalog.Title(group[0]), catalog.Entry(group[0]).dataSize >> 20);
+		for (unsigned int i = 0; i < group.size(); i++)
+			printf("    %s %s\n", catalog.IsDuplicate(group[i]) ? " " : "*", catalog.FullPath(group[i]).c_str());
+	}
+	printf("%llu MB reclaimable\n", catalog.ReclaimableBytes() >> 20);
+}
+
+// A title id restores every package of that title, anything else is read as a
+// package path relative to the device root. Each is looked for on every device.
+// Returns how many failed, counting any that have no backup anywhere.
+static unsigned int RestoreSelected(const vector<string>& which)
+{
+	unsigned int failed = 0;
+	for (unsigned int w = 0; w < which.size(); w++)
+	{
+		char* end;
+		DWORD titleId = strtoul(which[w].c_str(), &end, 16);
+		bool isTitleId = which[w].length() == 8 && *end == '\0';
+		string path = which[w];
+		for (unsigned int i = 0; i < path.length(); i++)
+		{
+			if (path[i] == '/')
+				path[i] = '\\';
+		}
+		if (path[0] != '\\')
+			path.insert(0, "\\");
+
+		unsigned int restored = 0;
+		unsigned int restoreFailed = 0;
+		for (unsigned int i = 0; i < devices.size(); i++)
+		{
+			BackupArchive& archive = *GetBackupArchive(i);
+			unsigned int deviceFailed = 0;
+			const BACKUP_ENTRY* entry = isTitleId ? NULL : archive.Find(path.c_str());
+			if (isTitleId)
+				restored += RestoreTitle(archive, devices[i], titleId, &deviceFailed);
+			else if (entry && RestoreHeader(archive, *entry, devices[i]) == RESTORE_OK)
+				restored++;
+			else if (entry)
+				deviceFailed++;
+			restoreFailed += deviceFailed;
+		}
+		if (restored == 0 && restoreFailed == 0)
+		{
+			printf("%s: no backup found\n", which[w].c_str());
+			failed++;
+		}
+		else
+			printf("%s: %u restored, %u failed\n", which[w].c_str(), restored, restoreFailed);
+		failed += restoreFailed;
+	}
+	return failed;
+}
+
+static int Usage()
+{
+	fprintf(stderr,
+		"usage: godunlock [options] scan|unlock|restore|verify <device root or FATX image>...\n"
+		"       godunlock [options] convert <disc image> <device root>\n"
+		"       godunlock [options] nxe2god <device root>...\n"
+		"       godunlock [options] extract <output folder> <device root>...\n"
+		"  -r <file>   extra title rules (\"<title id> set|wipe|skip\" per line)\n"
+		"  -i <file>   scan index to reuse between runs\n"
+		"  -L <file>   debug log\n"
+		"  -n          unlock without setting the license\n"
+		"  -j <count>  hashing threads for verify (default: one per CPU)\n"
+		"  -c <file>   verify checkpoints, to skip parts unchanged since they verified\n"
+		"  -t <name>   title name for convert (default: the image's file name)\n"
+		"  -v          verify the hash tree while extracting\n"
+		"  -f          convert the full image, without trimming unused sectors\n"
+		"  -d          act on one copy of each package found on several devices\n"
+		"  -k <n>      keep the copy on the nth device root (from 0) as the canonical one\n"
+		"  -s <which>  restore only a title id (8 hex digits) or a package path relative to\n"
+		"              the device root; may be given more than once\n");
+	return 2;
+}
+
+int main(int argc, char** argv)
+{
+	const char* rulesFile = NULL;
+	const char* indexFile = NULL;
+	const char* logFile = NULL;
+	const char* checkpointFile = NULL;
+	const char* titleName = NULL;
+	bool setLicense = true;
+	bool verifyExtract = false;
+	bool trim = true;
+	bool skipDuplicates = false;
+	int keepDevice = -1;
+	unsigned int threads = CpuCount();
+	vector<string> restoreOnly;
+
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-'; arg++)
+	{
+		if (strcmp(argv[arg], "-n") == 0)
+			setLicense = false;
+		else if (strcmp(argv[arg], "-v") == 0)
+			verifyExtract = true;
+		else if (strcmp(argv[arg], "-f") == 0)
+			trim = false;
+		else if (strcmp(argv[arg], "-d") == 0)
+			skipDuplicates = true;
+		else if (arg + 1 < argc && strcmp(argv[arg], "-r") == 0)
+			rulesFile = argv[++arg];
+		else if (arg + 1 < argc && strcmp(argv[arg], "-i") == 0)
+			indexFile = argv[++arg];
+		else if (arg + 1 < argc && strcmp(argv[arg], "-L") == 0)
+			logFile = argv[++arg];
+		else if (arg + 1 < argc && strcmp(argv[arg], "-j") == 0)
+			threads = atoi(argv[++arg]);
+		else if (arg + 1 < argc && strcmp(argv[arg], "-c") == 0)
+			checkpointFile = argv[++arg];
+		else if (arg + 1 < argc && strcmp(argv[arg], "-k") == 0)
+			keepDevice = atoi(argv[++arg]);
+		else if (arg + 1 < argc && strcmp(argv[arg], "-t") == 0)
+			titleName = argv[++arg];
+		else if (arg + 1 < argc && strcmp(argv[arg], "-s") == 0)
+			restoreOnly.push_back(argv[++arg]);
+		else
+			return Usage();
+	}
+	if (argc - arg < 2)
+		return Usage();
+	string command = argv[arg++];
+	if (command == "convert")
+	{
+		if (argc - arg != 2)
+			return Usage();
+		if (logFile)
+			StartDebugLog(logFile);
+		int status = ConvertImage(argv[arg], argv[arg + 1], titleName, setLicense, trim, threads);
+		StopDebugLog();
+		return status;
+	}
+	const char* extractFolder = NULL;
+	if (command == "extract")
+	{
+		if (argc - arg < 2)
+			return Usage();
+		extractFolder = argv[arg++];
+	}
+	else if (command != "scan" && command != "unlock" && command != "restore" && command != "verify" && command != "nxe2god")
+		return Usage();
+
+	if (logFile)
+		StartDebugLog(logFile);
+	if (rulesFile && rules.LoadFile(rulesFile) < 0)
+		fprintf(stderr, "Unable to read rules from %s\n", rulesFile);
+
+	ScanIndex index;
+	if (indexFile)
+		index.Load(indexFile);
+
+	for (; arg < argc; arg++)
+	{
+		string root = argv[arg];
+		while (root.length() > 1 && (root[root.length() - 1] == '/' || root[root.length() - 1] == '\\'))
+			root.erase(root.length() - 1);
+
+		vector<VFS_ENTRY> entries;
+		if (VfsList(root.c_str(), entries))
+		{
+			devices.push_back(root);
+			archiveFiles.push_back(root + "\\" + BACKUP_ARCHIVE_NAME);
+			journalFiles.push_back(root + "\\" + JOURNAL_FILE_NAME);
+			continue;
+		}
+
+		// Anything that isn't a directory is read as a FATX image. The FAT is never
+		// written, so its backup archive and journal live beside the image rather than inside it.
+		FatxVolume* volume = new FatxVolume;
+		if (!volume->OpenImage(root.c_str(), command == "unlock" || command == "restore"))
+		{
+			fprintf(stderr, "%s is neither a directory nor a FATX image\n", root.c_str());
+			delete volume;
+			return 1;
+		}
+		char prefix[16];
+		sprintf(prefix, "fatx%u:", (unsigned int)volumes.size());
+		VfsMount(prefix, volume);
+		volumes.push_back(volume);
+		printf("%s: FATX partition at 0x%llX mounted as %s\n", root.c_str(), volume->PartitionOffset(), prefix);
+		devices.push_back(prefix);
+		archiveFiles.push_back(root + "." + BACKUP_ARCHIVE_NAME);
+		journalFiles.push_back(root + "." + JOURNAL_FILE_NAME);
+	}
+	backups.resize(devices.size(), NULL);
+	journals.resize(devices.size(), NULL);
+
+	int failed = 0;
+	if (command == "unlock" || command == "restore")
+		failed += RecoverJournals();
+	if (command == "restore")
+	{
+		// Restoring works from the archives alone, no scan needed
+		if (restoreOnly.empty())
+		{
+			for (unsigned int i = 0; i < devices.size(); i++)
+			{
+				unsigned int restoreFailed = 0;
+				unsigned int restored = RestoreAll(*GetBackupArchive(i), devices[i], &restoreFailed);
+				printf("%s: %u restored, %u failed\n", devices[i].c_str(), restored, restoreFailed);
+				failed += restoreFailed;
+			}
+		}
+		else
+			failed += RestoreSelected(restoreOnly);
+	}
+	else if (command == "nxe2god")
+		failed = ConvertNXEInstalls(setLicense, trim, threads);
+	else
+	{
+		ScanScheduler scanner(OnGODFound, OnDeviceScanned, NULL);
+		if (indexFile)
+			scanner.SetIndex(&index);
+		vector<string> scanRoots;
+		for (unsigned int i = 0; i < devices.size(); i++)
+		{
+			scanRoots.push_back(devices[i] + ContentPath);
+			scanner.AddDevice(scanRoots.back());
+		}
+		scanner.Start();
+		scanner.Wait();
+		if (indexFile)
+			index.Save(indexFile, scanRoots);
+		unsigned int duplicates = catalog.MarkDuplicates();
+		if (keepDevice >= 0)
+			catalog.PreferDevice(keepDevice);
+		if (duplicates && command != "scan")
+			printf("%u duplicate copies %s\n", duplicates, skipDuplicates ? "skipped" : "included (-d to skip)");
+
+		if (command == "verify")
+		{
+			VerifyCheckpoints checkpoints;
+			if (checkpointFile && !checkpoints.Open(checkpointFile))
+				fprintf(stderr, "Unable to open checkpoints %s\n", checkpointFile);
+			for (unsigned int i = 0; i < catalog.Count(); i++)
+			{
+				if (skipDuplicates && catalog.IsDuplicate(i))
+					continue;
+				if (!VerifyGODData(i, threads, checkpointFile ? &checkpoints : NULL))
+					failed++;
+			}
+		}
+		else if (command == "extract")
+		{
+			VfsCreateDir(extractFolder);
+			for (unsigned int i = 0; i < catalog.Count(); i++)
+			{
+				if (skipDuplicates && catalog.IsDuplicate(i))
+					continue;
+				if (!ExtractGODImage(i, extractFolder, verifyExtract))
+					failed++;
+			}
+		}
+		else if (command == "scan")
+		{
+			ListGODs("Locked (LIVE):", GOD_TYPE_LIVE);
+			ListGODs("Locked (PIRS):", GOD_TYPE_PIRS);
+			ListGODs("Bundles:", GOD_TYPE_BUNDLE);
+			ListGODs("Unlocked:", GOD_TYPE_UNLOCKED);
+			ListGODs("Skipped by rule:", GOD_TYPE_SKIPPED);
+			ListDuplicates();
+		}
+		else
+		{
+			static const GOD_TYPE Unlockable[] = { GOD_TYPE_LIVE, GOD_TYPE_PIRS, GOD_TYPE_BUNDLE };
+			UnlockExecutor executor;
+			for (unsigned int t = 0; t < sizeof(Unlockable) / sizeof(Unlockable[0]); t++)
+			{
+				// Bundles always get their license wiped, never set
+				const CatalogView& view = catalog.View(Unlockable[t]);
+				for (unsigned int i = 0; i < view.size(); i++)
+				{
+					if (!skipDuplicates || !catalog.IsDuplicate(view[i]))
+						AddUnlockJob(executor, view[i], setLicense && Unlockable[t] != GOD_TYPE_BUNDLE);
+				}
+			}
+			failed += executor.Run(OnUnlocked, NULL);
+		}
+	}
+
+	for (unsigned int i = 0; i < backups.size(); i++)
+		delete backups[i];
+	for (unsigned int i = 0; i < journals.size(); i++)
+		delete journals[i];
+	for (unsigned int i = 0; i < volumes.size(); i++)
+		delete volumes[i];
+	StopDebugLog();
+	return failed ? 1 : 0;
+}
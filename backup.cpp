@@ -0,0 +1,208 @@
+#include <string.h>
+#include "backup.h"
+
+using std::string;
+
+static void PutBE32(unsigned char* p, DWORD value)
+{
+	p[0] = (unsigned char)(value >> 24);
+	p[1] = (unsigned char)(value >> 16);
+	p[2] = (unsigned char)(value >> 8);
+	p[3] = (unsigned char)value;
+}
+
+static DWORD GetBE32(const unsigned char* p)
+{
+	return ((DWORD)p[0] << 24) | ((DWORD)p[1] << 16) | ((DWORD)p[2] << 8) | (DWORD)p[3];
+}
+
+// Paths are case-insensitive on FATX, so the index keys on the lower case form
+static string FoldPath(const char* path)
+{
+	string folded = path;
+	for (unsigned int i = 0; i < folded.length(); i++)
+	{
+		if (folded[i] >= 'A' && folded[i] <= 'Z')
+			folded[i] = folded[i] - 'A' + 'a';
+	}
+	return folded;
+}
+
+void HashRegions(const PATCH_REGIONS& regions, unsigned char* hash)
+{
+	Sha1(regions.signature, sizeof(regions.signature), regions.license, sizeof(regions.license), hash);
+}
+
+BackupArchive::BackupArchive() : m_file(NULL), m_size(0)
+{
+}
+
+BackupArchive::~BackupArchive()
+{
+	Close();
+}
+
+bool BackupArchive::Open(const char* file)
+{
+	Close();
+	m_file = VfsOpen(file, VFS_OPEN_ALWAYS);
+	if (m_file == NULL)
+		return false;
+	unsigned long long fileSize = m_file->Size();
+
+	// Walk the record headers only, skipping over the saved bytes
+	for (;;)
+	{
+		unsigned char header[BACKUP_RECORD_HEADER_SIZE];
+		if (!VfsReadExact(m_file, m_size, header, sizeof(header)))
+			break;
+		if (GetBE32(header) != BACKUP_RECORD_MAGIC)
+			break;
+
+		BACKUP_ENTRY entry;
+		entry.offset = m_size;
+		entry.titleId = GetBE32(header + 4);
+		unsigned int pathLength = (header[8] << 8) | header[9];
+		memcpy(entry.hash, header + 12, sizeof(entry.hash));
+		if (pathLength == 0 || pathLength >= MAX_PATH)
+			break;
+		char path[MAX_PATH];
+		if (!VfsReadExact(m_file, m_size + BACKUP_RECORD_HEADER_SIZE, path, pathLength))
+			break;
+		entry.path.assign(path, pathLength);
+
+		// Only index records whose payload made it to disk completely
+		long end = m_size + BACKUP_RECORD_HEADER_SIZE + pathLength + sizeof(PATCH_REGIONS);
+		if ((unsigned long long)end > fileSize)
+			break;
+		AddEntry(entry);
+		m_size = end;
+	}
+	return true;
+}
+
+void BackupArchive::Close()
+{
+	if (m_file)
+	{
+		m_file->Flush();
+		delete m_file;
+		m_file = NULL;
+	}
+	m_size = 0;
+	m_entries.clear();
+	m_latest.clear();
+}
+
+void BackupArchive::AddEntry(const BACKUP_ENTRY& entry)
+{
+	// A newer record for the same path supersedes the older one
+	m_latest[FoldPath(entry.path.c_str())] = m_entries.size();
+	m_entries.push_back(entry);
+}
+
+const BACKUP_ENTRY* BackupArchive::Find(const char* path) const
+{
+	std::map<string, unsigned int>::const_iterator it = m_latest.find(FoldPath(path));
+	return it == m_latest.end() ? NULL : &m_entries[it->second];
+}
+
+bool BackupArchive::Append(DWORD titleId, const char* path, const PATCH_REGIONS& original, bool flush)
+{
+	if (m_file == NULL)
+		return false;
+	unsigned int pathLength = strlen(path);
+	if (pathLength == 0 || pathLength >= MAX_PATH || IsUnlockedRegions(original))
+		return false;
+
+	BACKUP_ENTRY entry;
+	entry.titleId = titleId;
+	entry.path = path;
+	entry.offset = m_size;
+	HashRegions(original, entry.hash);
+
+	const BACKUP_ENTRY* latest = Find(path);
+	if (latest && memcmp(latest->hash, entry.hash, sizeof(entry.hash)) == 0)
+		return true;
+
+	unsigned char record[BACKUP_RECORD_HEADER_SIZE + MAX_PATH + sizeof(PATCH_REGIONS)];
+	unsigned char* header = record;
+	memset(header, 0, BACKUP_RECORD_HEADER_SIZE);
+	PutBE32(header, BACKUP_RECORD_MAGIC);
+	PutBE32(header + 4, titleId);
+	header[8] = (unsigned char)(pathLength >> 8);
+	header[9] = (unsigned char)pathLength;
+	memcpy(header + 12, entry.hash, sizeof(entry.hash));
+	memcpy(record + BACKUP_RECORD_HEADER_SIZE, path, pathLength);
+	memcpy(record + BACKUP_RECORD_HEADER_SIZE + pathLength, &original, sizeof(original));
+	DWORD recordSize = BACKUP_RECORD_HEADER_SIZE + pathLength + sizeof(original);
+
+	// One sequential append per title, flushed before the caller patches the package
+	// unless a journal already holds the original bytes
+	if (!m_file->Write(m_size, record, recordSize) || (flush && !m_file->Flush()))
+		return false;
+
+	m_size += recordSize;
+	AddEntry(entry);
+	return true;
+}
+
+bool BackupArchive::Read(const BACKUP_ENTRY& entry, PATCH_REGIONS* original)
+{
+	if (m_file == NULL)
+		return false;
+	long offset = entry.offset + BACKUP_RECORD_HEADER_SIZE + entry.path.length();
+	return VfsReadExact(m_file, offset, original, sizeof(PATCH_REGIONS));
+}
+
+RESTORE_RESULT RestoreHeader(BackupArchive& archive, const BACKUP_ENTRY& entry, const std::string& deviceRoot)
+{
+	PATCH_REGIONS original;
+	unsigned char hash[SHA1_DIGEST_SIZE];
+	if (!archive.Read(entry, &original))
+		return RESTORE_BAD_BACKUP;
+	HashRegions(original, hash);
+	if (memcmp(hash, entry.hash, sizeof(hash)) != 0)
+		return RESTORE_BAD_BACKUP;
+
+	// Only the two patched regions move, the package is never rewritten
+	string file = deviceRoot + entry.path;
+	PATCH_REGIONS restored;
+	if (WriteHeaderRegions(file.c_str(), original, &restored) != PATCH_OK)
+		return RESTORE_WRITE_FAILED;
+	HashRegions(restored, hash);
+	if (memcmp(hash, entry.hash, sizeof(hash)) != 0)
+		return RESTORE_VERIFY_FAILED;
+	return RESTORE_OK;
+}
+
+// Restores the latest record of each package, all of them or only one title's
+static unsigned int RestoreLatest(BackupArchive& archive, const std::string& deviceRoot, bool allTitles, DWORD titleId, unsigned int* failed)
+{
+	unsigned int restored = 0;
+	*failed = 0;
+	const std::vector<BACKUP_ENTRY>& entries = archive.Entries();
+	for (unsigned int i = 0; i < entries.size(); i++)
+	{
+		if (!allTitles && entries[i].titleId != titleId)
+			continue;
+		// Older records for the same package are superseded by the latest one
+		if (archive.Find(entries[i].path.c_str()) != &entries[i])
+			continue;
+		if (RestoreHeader(archive, entries[i], deviceRoot) == RESTORE_OK)
+			restored++;
+		else
+			(*failed)++;
+	}
+	return restored;
+}
+
+unsigned int RestoreAll(BackupArchive& archive, const std::string& deviceRoot, unsigned int* failed)
+{
+	return RestoreLatest(archive, deviceRoot, true, 0, failed);
+}
+
+unsigned int RestoreTitle(BackupArchive& archive, const std::string& deviceRoot, DWORD titleId, unsigned int* failed)
+{
+	return RestoreLatest(archive, deviceRoot, false, titleId, failed);
+}
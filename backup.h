@@ -0,0 +1,87 @@
+#ifndef BACKUP_H
+#define BACKUP_H
+#include <map>
+#include <string>
+#include <vector>
+#include "patch.h"
+#include "sha1.h"
+#include "vfs.h"
+
+#define BACKUP_ARCHIVE_NAME		"godbackup.bin"
+#define BACKUP_RECORD_MAGIC		0x4742414B	// GBAK
+#define BACKUP_RECORD_HEADER_SIZE	32
+
+// Index entry for one record in the archive
+struct BACKUP_ENTRY
+{
+	DWORD titleId;
+	std::string path;	// Package path relative to the device root
+	unsigned char hash[SHA1_DIGEST_SIZE];	// SHA-1 of the original signature and license regions
+	long offset;		// Where the record starts in the archive
+};
+
+// One append-only archive per device holding only the header bytes the unlock
+// patch overwrites. Each record is a 32 byte header (magic, title id, path
+// length, hash), the path, then the original signature and license regions.
+// The index is rebuilt from the record headers when the archive is opened.
+class BackupArchive
+{
+public:
+	BackupArchive();
+	~BackupArchive();
+
+	// Opens or creates the archive and indexes the records already in it.
+	// A torn record at the end (from a crash mid-append) is overwritten by the next append.
+	bool Open(const char* file);
+	void Close();
+	bool IsOpen() const { return m_file != NULL; }
+
+	// Appends the original header regions of a package. Skipped if the latest
+	// record for the same path already holds identical bytes, refused if the
+	// regions are already unlocked since they would shadow the real original. Without flush the
+	// record is only on disk once Flush is called, for callers that batch appends.
+	bool Append(DWORD titleId, const char* path, const PATCH_REGIONS& original, bool flush = true);
+	bool Flush() { return m_file != NULL && m_file->Flush(); }
+
+	// Latest record for a path, or NULL. Looked up in the index, paths compare ignoring case.
+	const BACKUP_ENTRY* Find(const char* path) const;
+
+	// Seeks straight to a record and reads its original regions back
+	bool Read(const BACKUP_ENTRY& entry, PATCH_REGIONS* original);
+
+	const std::vector<BACKUP_ENTRY>& Entries() const { return m_entries; }
+
+private:
+	VfsFile* m_file;
+	long m_size;	// End of the last complete record
+	std::vector<BACKUP_ENTRY> m_entries;
+	std::map<std::string, unsigned int> m_latest;	// Case folded path -> its latest record in m_entries
+
+	void AddEntry(const BACKUP_ENTRY& entry);
+
+	BackupArchive(const BackupArchive&);
+	BackupArchive& operator=(const BackupArchive&);
+};
+
+void HashRegions(const PATCH_REGIONS& regions, unsigned char* hash);
+
+enum RESTORE_RESULT
+{
+	RESTORE_OK = 0,
+	RESTORE_NO_BACKUP,		// No record for this package in the archive
+	RESTORE_BAD_BACKUP,		// The archived bytes don't match their recorded hash, nothing written
+	RESTORE_WRITE_FAILED,	// The package couldn't be opened or written
+	RESTORE_VERIFY_FAILED	// The header read back doesn't match the recorded hash
+};
+
+// Writes the original header regions of one package back in place. deviceRoot
+// is prepended to the record's device relative path.
+RESTORE_RESULT RestoreHeader(BackupArchive& archive, const BACKUP_ENTRY& entry, const std::string& deviceRoot);
+
+// Restores the latest record of every package in the archive. Returns how many
+// were restored; failures are counted in failed.
+unsigned int RestoreAll(BackupArchive& archive, const std::string& deviceRoot, unsigned int* failed);
+
+// As RestoreAll, for the packages of one title only
+unsigned int RestoreTitle(BackupArchive& archive, const std::string& deviceRoot, DWORD titleId, unsigned int* failed);
+#endif
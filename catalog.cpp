@@ -0,0 +1,141 @@
+#include <string.h>
+#include <algorithm>
+#include "catalog.h"
+
+using std::string;
+using std::vector;
+
+// Where <title id>\00007000\ starts in a package folder, or 0 if the folder is shorter
+static string::size_type TitleFolderStart(const string& path)
+{
+	string::size_type slash = path.length() > 1 ? path.rfind('\\', path.length() - 2) : string::npos;
+	if (slash == string::npos || slash == 0)
+		return 0;
+	slash = path.rfind('\\', slash - 1);
+	return slash == string::npos ? 0 : slash + 1;
+}
+
+unsigned int Catalog::Add(int device, const string& fileName, const string& path, const GOD_HEADER_INFO& header)
+{
+	CATALOG_ENTRY entry;
+	string::size_type split = TitleFolderStart(path);
+	entry.root = m_paths.Intern(path.substr(0, split).c_str());
+	entry.folder = m_paths.Intern(path.c_str() + split);
+	entry.fileName = m_paths.Intern(fileName.c_str());
+	entry.title = m_titles.Intern(header.displayName);
+	entry.titleId = header.titleId;
+	entry.mediaId = header.mediaId;
+	memcpy(entry.contentId, header.contentId, sizeof(entry.contentId));
+	entry.dataSize = header.dataSize;
+	entry.type = (BYTE)header.type;
+	entry.device = (BYTE)device;
+	entry.status = CATALOG_STATUS_FOUND;
+	entry.flags = 0;
+
+	unsigned int index = m_entries.size();
+	m_entries.push_back(entry);
+	m_views[header.type].push_back(index);
+	return index;
+}
+
+// Fingerprint order, with device and discovery order breaking ties so the
+// copies within a group come out canonical first
+struct FingerprintOrder
+{
+	const Catalog* catalog;
+	bool operator()(unsigned int a, unsigned int b) const
+	{
+		int cmp = Compare(catalog->Entry(a), catalog->Entry(b));
+		if (cmp != 0)
+			return cmp < 0;
+		if (catalog->Entry(a).device != catalog->Entry(b).device)
+			return catalog->Entry(a).device < catalog->Entry(b).device;
+		return a < b;
+	}
+
+	static int Compare(const CATALOG_ENTRY& a, const CATALOG_ENTRY& b)
+	{
+		if (a.titleId != b.titleId)
+			return a.titleId < b.titleId ? -1 : 1;
+		if (a.mediaId != b.mediaId)
+			return a.mediaId < b.mediaId ? -1 : 1;
+		return memcmp(a.contentId, b.contentId, sizeof(a.contentId));
+	}
+};
+
+void Catalog::FindDuplicates(vector<CatalogView>& groups) const
+{
+	groups.clear();
+	CatalogView order(m_entries.size());
+	for (unsigned int i = 0; i < order.size(); i++)
+		order[i] = i;
+	FingerprintOrder fingerprint;
+	fingerprint.catalog = this;
+	std::sort(order.begin(), order.end(), fingerprint);
+
+	for (unsigned int start = 0, end; start < order.size(); start = end)
+	{
+		for (end = start + 1; end < order.size(); end++)
+		{
+			if (FingerprintOrder::Compare(m_entries[order[start]], m_entries[order[end]]) != 0)
+				break;
+		}
+		if (end - start > 1)
+			groups.push_back(CatalogView(order.begin() + start, order.begin() + end));
+	}
+}
+
+unsigned int Catalog::MarkDuplicates()
+{
+	vector<CatalogView> groups;
+	FindDuplicates(groups);
+	unsigned int marked = 0;
+	for (unsigned int g = 0; g < groups.size(); g++)
+	{
+		m_entries[groups[g][0]].flags &= ~CATALOG_FLAG_DUPLICATE;
+		for (unsigned int i = 1; i < groups[g].size(); i++)
+		{
+			m_entries[groups[g][i]].flags |= CATALOG_FLAG_DUPLICATE;
+			marked++;
+		}
+	}
+	return marked;
+}
+
+void Catalog::SetCanonical(unsigned int index)
+{
+	for (unsigned int i = 0; i < m_entries.size(); i++)
+	{
+		if (FingerprintOrder::Compare(m_entries[i], m_entries[index]) == 0)
+			m_entries[i].flags |= CATALOG_FLAG_DUPLICATE;
+	}
+	m_entries[index].flags &= ~CATALOG_FLAG_DUPLICATE;
+}
+
+void Catalog::PreferDevice(int device)
+{
+	vector<CatalogView> groups;
+	FindDuplicates(groups);
+	for (unsigned int g = 0; g < groups.size(); g++)
+	{
+		for (unsigned int i = 0; i < groups[g].size(); i++)
+		{
+			if (m_entries[groups[g][i]].device == device)
+			{
+				SetCanonical(groups[g][i]);
+				break;
+			}
+		}
+	}
+}
+
+unsigned long long Catalog::ReclaimableBytes() const
+{
+	unsigned long long bytes = 0;
+	for (unsigned int i = 0; i < m_entries.size(); i++)
+	{
+		if (m_entries[i].flags & CATALOG_FLAG_DUPLICATE)
+			bytes += m_entries[i].dataSize;
+	}
+	return bytes;
+}
@@ -0,0 +1,173 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+#include <string>
+#include <vector>
+#include "header.h"
+
+typedef unsigned int STRING_ID;
+#define INVALID_STRING_ID 0xFFFFFFFF
+
+// Append-only pool of null terminated strings. Each distinct string is stored once
+// and referred to by its offset. Pointers returned by Get are only valid until the
+// next Intern, so keep the id rather than the pointer.
+template <typename T> class StringPool
+{
+public:
+	StringPool() : m_count(0) { m_buckets.resize(64, INVALID_STRING_ID); }
+
+	STRING_ID Intern(const T* str)
+	{
+		unsigned int len = 0;
+		while (str[len])
+			len++;
+		unsigned int hash = Hash(str, len);
+		unsigned int mask = m_buckets.size() - 1;
+		for (unsigned int slot = hash & mask;; slot = (slot + 1) & mask)
+		{
+			STRING_ID id = m_buckets[slot];
+			if (id == INVALID_STRING_ID)
+				break;
+			if (Equals(id, str, len))
+				return id;
+		}
+
+		STRING_ID id = m_data.size();
+		m_data.insert(m_data.end(), str, str + len);
+		m_data.push_back(0);
+		if (++m_count * 2 > m_buckets.size())
+			Rehash(m_buckets.size() * 2);
+		else
+			Insert(id, hash);
+		return id;
+	}
+
+	const T* Get(STRING_ID id) const { return &m_data[id]; }
+	unsigned int Count() const { return m_count; }
+	unsigned int Bytes() const { return m_data.size() * sizeof(T); }
+
+private:
+	static unsigned int Hash(const T* str, unsigned int len)
+	{
+		unsigned int hash = 2166136261U; // FNV-1a
+		for (unsigned int i = 0; i < len; i++)
+			hash = (hash ^ (unsigned int)str[i]) * 16777619U;
+		return hash;
+	}
+
+	bool Equals(STRING_ID id, const T* str, unsigned int len) const
+	{
+		if (id + len >= m_data.size() || m_data[id + len] != 0)
+			return false;
+		for (unsigned int i = 0; i < len; i++)
+			if (m_data[id + i] != str[i])
+				return false;
+		return true;
+	}
+
+	void Insert(STRING_ID id, unsigned int hash)
+	{
+		unsigned int mask = m_buckets.size() - 1;
+		unsigned int slot = hash & mask;
+		while (m_buckets[slot] != INVALID_STRING_ID)
+			slot = (slot + 1) & mask;
+		m_buckets[slot] = id;
+	}
+
+	void Rehash(unsigned int buckets)
+	{
+		m_buckets.assign(buckets, INVALID_STRING_ID);
+		for (STRING_ID id = 0; id < m_data.size();)
+		{
+			unsigned int len = 0;
+			while (m_data[id + len])
+				len++;
+			Insert(id, Hash(&m_data[id], len));
+			id += len + 1;
+		}
+	}
+
+	std::vector<T> m_data;
+	std::vector<STRING_ID> m_buckets;
+	unsigned int m_count;
+};
+
+// Fixed size record for one header package. Strings live in the catalog pools.
+struct CATALOG_ENTRY
+{
+	STRING_ID root;		// Device and profile folder, shared by every title on it
+	STRING_ID folder;	// <title id>\00007000\ under the root, shared by every copy of the title
+	STRING_ID fileName;	// Header package name
+	STRING_ID title;	// Display name
+	DWORD titleId;
+	DWORD mediaId;
+	BYTE contentId[STFS_HEADER_HASH::SIZE];
+	unsigned long long dataSize;
+	BYTE type;			// GOD_TYPE
+	BYTE device;		// Index of the device it was found on
+	BYTE status;		// CATALOG_STATUS
+	BYTE flags;			// CATALOG_FLAG_*
+};
+
+#define CATALOG_FLAG_DUPLICATE	0x01	// Another copy of the same package is the canonical one
+
+enum CATALOG_STATUS
+{
+	CATALOG_STATUS_FOUND = 0,
+	CATALOG_STATUS_UNLOCKED,
+	CATALOG_STATUS_FAILED,
+	CATALOG_STATUS_RESTORED
+};
+
+typedef std::vector<unsigned int> CatalogView;
+
+// Single store for every package found by the scanner. Category lists are views of
+// indices into the record array, so nothing is copied when filtering or sorting.
+class Catalog
+{
+public:
+	// Not locked: the scheduler serializes its found callbacks and the ScanFeed
+	// consumer is a single thread. path is split into its root and title folder.
+	unsigned int Add(int device, const std::string& fileName, const std::string& path, const GOD_HEADER_INFO& header);
+
+	unsigned int Count() const { return m_entries.size(); }
+	const CATALOG_ENTRY& Entry(unsigned int index) const { return m_entries[index]; }
+	void SetStatus(unsigned int index, CATALOG_STATUS status) { m_entries[index].status = (BYTE)status; }
+
+	// Records of one classification, in the order they were found
+	const CatalogView& View(GOD_TYPE type) const { return m_views[type]; }
+	unsigned int Count(GOD_TYPE type) const { return m_views[type].size(); }
+
+	// Folder holding the package, with its trailing backslash
+	std::string Path(unsigned int index) const { return std::string(m_paths.Get(m_entries[index].root)) + m_paths.Get(m_entries[index].folder); }
+	const char* FileName(unsigned int index) const { return m_paths.Get(m_entries[index].fileName); }
+	const WCHAR* Title(unsigned int index) const { return m_titles.Get(m_entries[index].title); }
+	std::string FullPath(unsigned int index) const { return Path(index) + FileName(index); }
+
+	// Groups the copies of each package found more than once. Copies match on
+	// their fingerprint: title id, media id and content id, all from the header,
+	// so nothing beyond the scan's header read is needed. Each group is ordered
+	// by device, then by when it was found.
+	void FindDuplicates(std::vector<CatalogView>& groups) const;
+
+	// Flags every copy in each group but the first (the copy on the lowest
+	// device) as a duplicate. Returns how many were flagged.
+	unsigned int MarkDuplicates();
+
+	// Makes index the one copy of its group that isn't flagged
+	void SetCanonical(unsigned int index);
+
+	// Keeps the copy on device as the canonical one in every group that has one there
+	void PreferDevice(int device);
+
+	bool IsDuplicate(unsigned int index) const { return (m_entries[index].flags & CATALOG_FLAG_DUPLICATE) != 0; }
+
+	// Data bytes held by the flagged copies, i.e. what deleting them would free
+	unsigned long long ReclaimableBytes() const;
+
+private:
+	std::vector<CATALOG_ENTRY> m_entries;
+	CatalogView m_views[GOD_TYPE_COUNT];
+	StringPool<char> m_paths;
+	StringPool<WCHAR> m_titles;
+};
+#endif
@@ -0,0 +1,546 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "convert.h"
+#include "patch.h"
+#include "queue.h"
+#include "sha1.h"
+#include "svod.h"
+#include "vfs.h"
+#include "xdvdfs.h"
+
+using std::string;
+using std::vector;
+
+#define XEX2_MAGIC			0x58455832	// XEX2
+#define XEX_HEADER_MAX		0x10000		// Plenty for the optional headers of any title
+
+// One group on its way through the pipeline: the hash block followed by up to
+// SVOD_BLOCKS_PER_GROUP data blocks, laid out exactly as it lands in the part
+struct CONVERT_JOB
+{
+	BYTE* buffer;
+	DWORD blocks;
+	DWORD part;
+	DWORD group;
+	BYTE hash[SHA1_DIGEST_SIZE];	// Of the finished hash block, for the master block
+};
+
+struct CONVERT_STATE
+{
+	BoundedQueue<CONVERT_JOB*>* hash;
+	BoundedQueue<CONVERT_JOB*>* write;
+	BoundedQueue<CONVERT_JOB*>* idle;
+	vector<VfsFile*> files;
+	vector<BYTE> masters;			// One master block per part, only touched by the writer until it exits
+	CriticalSection lock;
+	volatile bool failed;
+	CONVERT_RESULT result;
+	unsigned long long written;
+};
+
+static DWORD GetBE32(const BYTE* p)
+{
+	return ((DWORD)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void RecordFailure(CONVERT_STATE* state, CONVERT_RESULT result)
+{
+	ScopedLock lock(state->lock);
+	if (!state->failed)
+		state->result = result;
+	state->failed = true;
+}
+
+static void HashWorker(void* param)
+{
+	CONVERT_STATE* state = (CONVERT_STATE*)param;
+	for (;;)
+	{
+		// A NULL job tells the worker to finish
+		CONVERT_JOB* job = state->hash->Pop();
+		if (job == NULL)
+			return;
+		if (!state->failed)
+		{
+			memset(job->buffer, 0, SVOD_BLOCK_SIZE);
+			for (DWORD i = 0; i < job->blocks; i++)
+				Sha1(job->buffer + (1 + i) * SVOD_BLOCK_SIZE, SVOD_BLOCK_SIZE, job->buffer + i * SHA1_DIGEST_SIZE);
+			Sha1(job->buffer, SVOD_BLOCK_SIZE, job->hash);
+		}
+		state->write->Push(job);
+	}
+}
+
+static void WriteWorker(void* param)
+{
+	CONVERT_STATE* state = (CONVERT_STATE*)param;
+	for (;;)
+	{
+		CONVERT_JOB* job = state->write->Pop();
+		if (job == NULL)
+			return;
+		if (!state->failed)
+		{
+			// Groups may arrive slightly out of order, each has its own place in the part
+			unsigned long long offset = SVOD_BLOCK_SIZE + (unsigned long long)job->group * SVOD_GROUP_SIZE;
+			DWORD length = (1 + job->blocks) * SVOD_BLOCK_SIZE;
+			if (state->files[job->part]->Write(offset, job->buffer, length))
+			{
+				memcpy(&state->masters[job->part * SVOD_BLOCK_SIZE + job->group * SHA1_DIGEST_SIZE], job->hash, SHA1_DIGEST_SIZE);
+				state->written += length;
+			}
+			else
+				RecordFailure(state, CONVERT_WRITE_FAILED);
+		}
+		state->idle->Push(job);
+	}
+}
+
+// Creates every folder along path that doesn't exist yet
+static void CreateDirs(const string& path)
+{
+	for (string::size_type slash = path.find('\\', 1); slash != string::npos; slash = path.find('\\', slash + 1))
+		VfsCreateDir(path.substr(0, slash).c_str());
+	VfsCreateDir(path.c_str());
+}
+
+static void ResetReport(CONVERT_REPORT* report)
+{
+	report->result = CONVERT_OK;
+	report->bytesSaved = 0;
+	report->headerPath.clear();
+	report->parts = 0;
+	report->bytesRead = 0;
+	report->bytesWritten = 0;
+	report->elapsedMs = 0;
+}
+
+// Links the parts from the last back to the first, each master block carrying
+// the hash of the next one's, and writes them. rootHash receives Data0000's.
+static bool WriteMasterBlocks(CONVERT_STATE* state, BYTE* rootHash)
+{
+	BYTE next[SHA1_DIGEST_SIZE];
+	for (DWORD part = state->files.size(); part > 0; part--)
+	{
+		BYTE* master = &state->masters[(part - 1) * SVOD_BLOCK_SIZE];
+		if (part < state->files.size())
+			memcpy(master + SVOD_NEXT_PART_HASH_OFFSET, next, sizeof(next));
+		if (!state->files[part - 1]->Write(0, master, SVOD_BLOCK_SIZE) || !state->files[part - 1]->Flush())
+			return false;
+		state->written += SVOD_BLOCK_SIZE;
+		Sha1(master, SVOD_BLOCK_SIZE, next);
+	}
+	memcpy(rootHash, next, sizeof(next));
+	return true;
+}
+
+static void BuildHeader(const CONVERT_TITLE& title, bool setLicense, const BYTE* rootHash, DWORD parts,
+	DWORD blocks, unsigned long long dataSize, BYTE* header)
+{
+	memset(header, 0, CONVERT_HEADER_FILE_SIZE);
+	memcpy(header + PATCH_SIGNATURE_OFFSET, HeaderMain, PATCH_SIGNATURE_SIZE);
+	BuildLicenseBlock(header + PATCH_LICENSE_OFFSET, setLicense);
+
+	StfsHeaderWriter writer(header, CONVERT_HEADER_FILE_SIZE);
+	writer.Set<STFS_HEADER_SIZE_FIELD>(CONVERT_HEADER_SIZE);
+	writer.Set<STFS_CONTENT_TYPE>(GOD_CONTENT_TYPE);
+	writer.Set<STFS_METADATA_VERSION>(CONVERT_METADATA_VERSION);
+	writer.Set<STFS_CONTENT_SIZE>(dataSize);
+	writer.Set<STFS_MEDIA_ID>(title.mediaId);
+	writer.Set<STFS_VERSION>(title.version);
+	writer.Set<STFS_BASE_VERSION>(title.baseVersion);
+	writer.Set<STFS_TITLE_ID>(title.titleId);
+	writer.Set<STFS_PLATFORM>(title.platform);
+	writer.Set<STFS_EXECUTABLE_TYPE>(title.executableType);
+	writer.Set<STFS_DISC_NUMBER>(title.discNumber);
+	writer.Set<STFS_DISCS_IN_SET>(title.discsInSet);
+	writer.Set<STFS_SAVEGAME_ID>(title.savegameId);
+
+	writer.Set<STFS_SVOD_DESCRIPTOR_SIZE>(STFS_VOLUME_DESCRIPTOR::SIZE);
+	writer.Set<STFS_SVOD_ROOT_HASH>(rootHash);
+	writer.Set<STFS_SVOD_DATA_BLOCK_COUNT>(blocks);
+	writer.Set<STFS_SVOD_DATA_BLOCK_OFFSET>(0);
+	writer.Set<STFS_DATA_FILE_COUNT>(parts);
+	writer.Set<STFS_DATA_FILE_SIZE>(dataSize);
+	writer.Set<STFS_DESCRIPTOR_TYPE_FIELD>(STFS_DESCRIPTOR_SVOD);
+
+	writer.SetString<STFS_DISPLAY_NAME>(0, title.name);
+	writer.SetString<STFS_TITLE_NAME>(0, title.name);
+
+	BYTE hash[SHA1_DIGEST_SIZE];
+	Sha1(header + STFS_HEADER_HASHED_OFFSET, CONVERT_HEADER_FILE_SIZE - STFS_HEADER_HASHED_OFFSET, hash);
+	writer.Set<STFS_HEADER_HASH>(hash);
+}
+
+CONVERT_RESULT WriteGODPackage(const CONVERT_TITLE& title, CONVERT_READ_CALLBACK read, void* readContext,
+	unsigned long long size, const char* contentRoot, bool setLicense, unsigned int threads, CONVERT_REPORT* report,
+	CONVERT_PROGRESS_CALLBACK progress, void* context)
+{
+	ResetReport(report);
+	unsigned long start = TickCount();
+
+	DWORD blocks = (DWORD)((size + SVOD_BLOCK_SIZE - 1) / SVOD_BLOCK_SIZE);
+	DWORD groups = (blocks + SVOD_BLOCKS_PER_GROUP - 1) / SVOD_BLOCKS_PER_GROUP;
+	DWORD parts = (groups + SVOD_GROUPS_PER_PART - 1) / SVOD_GROUPS_PER_PART;
+	if (blocks == 0)
+	{
+		report->result = CONVERT_READ_FAILED;
+		return report->result;
+	}
+	report->parts = parts;
+
+	// <content root>\<title id>\00007000\<media id>, with its parts in <media id>.data
+	char name[32];
+	sprintf(name, "\\%08X\\%08X\\%08X", title.titleId, GOD_CONTENT_TYPE, title.mediaId);
+	string path = string(contentRoot) + name;
+	report->headerPath = path;
+	string dataPath = path + ".data";
+
+	// Writing over a title the user already has would truncate it, and the
+	// cleanup below would then delete it
+	vector<VFS_ENTRY> existing;
+	VfsFile* header = VfsOpen(path.c_str(), VFS_READ);
+	if (header != NULL || VfsList(dataPath.c_str(), existing))
+	{
+		delete header;
+		report->result = CONVERT_EXISTS;
+		return report->result;
+	}
+	CreateDirs(dataPath);
+
+	CONVERT_STATE state;
+	state.failed = false;
+	state.result = CONVERT_OK;
+	state.written = 0;
+	state.masters.resize((size_t)parts * SVOD_BLOCK_SIZE);
+	for (DWORD part = 0; part < parts; part++)
+	{
+		VfsFile* file = VfsOpen(SvodPartPath(path, part).c_str(), VFS_CREATE);
+		if (file == NULL)
+		{
+			RecordFailure(&state, CONVERT_CREATE_FAILED);
+			break;
+		}
+		state.files.push_back(file);
+	}
+
+	// The budget decides the buffers, not the thread count: every hasher needs
+	// one while the next is read and the last written, and the rest let the
+	// reader run ahead while the writer waits on the disk
+	unsigned int buffers = CONVERT_MEMORY_BUDGET / SVOD_GROUP_SIZE;
+	if (threads == 0)
+		threads = 1;
+	if (threads + 3 > buffers)
+		threads = buffers - 3;
+	BoundedQueue<CONVERT_JOB*> hash(buffers + threads);
+	BoundedQueue<CONVERT_JOB*> write(buffers + 1);
+	BoundedQueue<CONVERT_JOB*> idle(buffers);
+	vector<CONVERT_JOB> jobs(buffers);
+	vector<BYTE> memory((size_t)buffers * SVOD_GROUP_SIZE);
+	for (unsigned int i = 0; i < buffers; i++)
+	{
+		jobs[i].buffer = &memory[(size_t)i * SVOD_GROUP_SIZE];
+		idle.Push(&jobs[i]);
+	}
+	state.hash = &hash;
+	state.write = &write;
+	state.idle = &idle;
+
+	vector<THREAD_HANDLE> hashers;
+	THREAD_HANDLE writer;
+	bool writing = !state.failed && StartThread(WriteWorker, &state, &writer);
+	for (unsigned int i = 0; writing && i < threads; i++)
+	{
+		THREAD_HANDLE handle;
+		if (StartThread(HashWorker, &state, &handle))
+			hashers.push_back(handle);
+	}
+	if (!writing || hashers.empty())
+		RecordFailure(&state, CONVERT_CREATE_FAILED);
+
+	unsigned long long offset = 0;
+	for (DWORD group = 0; group < groups && !state.failed; group++)
+	{
+		CONVERT_JOB* job = idle.Pop();
+		job->part = group / SVOD_GROUPS_PER_PART;
+		job->group = group % SVOD_GROUPS_PER_PART;
+		job->blocks = blocks - group * SVOD_BLOCKS_PER_GROUP;
+		if (job->blocks > SVOD_BLOCKS_PER_GROUP)
+			job->blocks = SVOD_BLOCKS_PER_GROUP;
+
+		// The image need not end on a block boundary, the last one is zero padded
+		BYTE* data = job->buffer + SVOD_BLOCK_SIZE;
+		DWORD length = job->blocks * SVOD_BLOCK_SIZE;
+		if (offset + length > size)
+		{
+			length = (DWORD)(size - offset);
+			memset(data + length, 0, job->blocks * SVOD_BLOCK_SIZE - length);
+		}
+		if (!read(offset, data, length, readContext))
+		{
+			RecordFailure(&state, CONVERT_READ_FAILED);
+			idle.Push(job);
+			break;
+		}
+		offset += length;
+		hash.Push(job);
+		if (progress)
+			progress(offset, size, context);
+	}
+	report->bytesRead = offset;
+
+	for (unsigned int i = 0; i < hashers.size(); i++)
+		hash.Push(NULL);
+	for (unsigned int i = 0; i < hashers.size(); i++)
+		JoinThread(hashers[i]);
+	if (writing)
+	{
+		write.Push(NULL);
+		JoinThread(writer);
+	}
+
+	BYTE rootHash[SHA1_DIGEST_SIZE];
+	if (!state.failed && !WriteMasterBlocks(&state, rootHash))
+		RecordFailure(&state, CONVERT_WRITE_FAILED);
+	unsigned long long dataSize = state.written;
+	for (unsigned int i = 0; i < state.files.size(); i++)
+		delete state.files[i];
+
+	if (!state.failed)
+	{
+		vector<BYTE> header(CONVERT_HEADER_FILE_SIZE);
+		BuildHeader(title, setLicense, rootHash, parts, blocks, dataSize, &header[0]);
+		VfsFile* file = VfsOpen(path.c_str(), VFS_CREATE);
+		if (file == NULL)
+			RecordFailure(&state, CONVERT_CREATE_FAILED);
+		else
+		{
+			if (!file->Write(0, &header[0], header.size()) || !file->Flush())
+				RecordFailure(&state, CONVERT_WRITE_FAILED);
+			delete file;
+		}
+		state.written += header.size();
+	}
+
+	// Nothing half written is left behind for the scanner to find
+	if (state.failed)
+	{
+		VfsRemove(path.c_str());
+		for (DWORD part = 0; part < parts; part++)
+			VfsRemove(SvodPartPath(path, part).c_str());
+		VfsRemove(dataPath.c_str());
+	}
+
+	report->bytesWritten = state.written;
+	report->elapsedMs = TickCount() - start;
+	report->result = state.failed ? state.result : CONVERT_OK;
+	return report->result;
+}
+
+// Pulls the execution id out of the XEX optional headers
+static bool ReadExecutionInfo(XdvdfsImage& image, const XDVDFS_ENTRY& xex, CONVERT_TITLE* title)
+{
+	vector<BYTE> header(xex.size < XEX_HEADER_MAX ? xex.size : XEX_HEADER_MAX);
+	DWORD read = 0;
+	if (header.size() < 0x18 || !image.Read(xex, 0, &header[0], header.size(), &read) || read != header.size())
+		return false;
+	if (GetBE32(&header[0]) != XEX2_MAGIC)
+		return false;
+
+	DWORD count = GetBE32(&header[0x14]);
+	for (DWORD i = 0; i < count && 0x18 + (i + 1) * 8 <= read; i++)
+	{
+		const BYTE* entry = &header[0x18 + i * 8];
+		if (GetBE32(entry) != CONVERT_XEX_EXECUTION_INFO)
+			continue;
+		DWORD offset = GetBE32(entry + 4);
+		if (offset + 0x18 > read)
+			return false;
+		const BYTE* info = &header[offset];
+		title->mediaId = GetBE32(info);
+		title->version = GetBE32(info + 4);
+		title->baseVersion = GetBE32(info + 8);
+		title->titleId = GetBE32(info + 0xC);
+		title->platform = info[0x10];
+		title->executableType = info[0x11];
+		title->discNumber = info[0x12];
+		title->discsInSet = info[0x13];
+		title->savegameId = GetBE32(info + 0x14);
+		return true;
+	}
+	return false;
+}
+
+struct ISO_SOURCE
+{
+	VfsFile* file;
+	unsigned long long partition;
+};
+
+static bool ReadISO(unsigned long long offset, void* buffer, DWORD size, void* context)
+{
+	ISO_SOURCE* source = (ISO_SOURCE*)context;
+	return VfsReadExact(source->file, source->partition + offset, buffer, size);
+}
+
+// With trim, the length of the image up to the last sector in use. Falls back
+// to the whole image if the tree can't be walked.
+static unsigned long long TrimmedSize(XdvdfsImage& image, bool trim)
+{
+	unsigned long long used;
+	if (trim && image.UsedSize(&used))
+		return used;
+	return image.PartitionSize();
+}
+
+CONVERT_RESULT ConvertISO(const char* isoPath, const char* contentRoot, const WCHAR* name, bool setLicense, bool trim,
+	unsigned int threads, CONVERT_REPORT* report, CONVERT_PROGRESS_CALLBACK progress, void* context)
+{
+	ResetReport(report);
+	VfsFile* file = VfsOpen(isoPath, VFS_READ);
+	if (file == NULL)
+	{
+		report->result = CONVERT_OPEN_FAILED;
+		return report->result;
+	}
+
+	XdvdfsImage image;
+	XDVDFS_ENTRY xex;
+	CONVERT_TITLE title;
+	memset(&title, 0, sizeof(title));
+	if (!image.Open(file))
+		report->result = CONVERT_NOT_XDVDFS;
+	else if (!image.Find("default.xex", &xex) || !ReadExecutionInfo(image, xex, &title))
+		report->result = CONVERT_NO_XEX;
+	if (report->result != CONVERT_OK)
+	{
+		delete file;
+		return report->result;
+	}
+
+	// Without a name the image's file name stands in, less its folder and extension
+	unsigned int length = 0;
+	if (name)
+	{
+		for (; name[length] && length < GOD_DISPLAY_NAME_CHARS; length++)
+			title.name[length] = name[length];
+	}
+	else
+	{
+		string base = isoPath;
+		string::size_type slash = base.find_last_of("\\/:");
+		if (slash != string::npos)
+			base.erase(0, slash + 1);
+		string::size_type dot = base.rfind('.');
+		if (dot != string::npos && dot > 0)
+			base.erase(dot);
+		for (; length < base.length() && length < GOD_DISPLAY_NAME_CHARS; length++)
+			title.name[length] = (WCHAR)(unsigned char)base[length];
+	}
+	title.name[length] = 0;
+
+	ISO_SOURCE source;
+	source.file = file;
+	source.partition = image.PartitionOffset();
+	unsigned long long size = TrimmedSize(image, trim);
+	WriteGODPackage(title, ReadISO, &source, size, contentRoot, setLicense, threads, report, progress, context);
+	report->bytesSaved = image.PartitionSize() - size;
+	delete file;
+	return report->result;
+}
+
+bool ReadNXEHeader(const char* path, NXE* nxe)
+{
+	BYTE page[GOD_HEADER_PAGE_SIZE];
+	DWORD read = 0;
+	VfsFile* file = VfsOpen(path, VFS_READ);
+	if (file == NULL)
+		return false;
+	if (!file->Read(0, page, sizeof(page), &read))
+		read = 0;
+	delete file;
+
+	StfsHeaderView header(page, read);
+	if (!header.Has<STFS_DISPLAY_NAME>() || header.Get<STFS_CONTENT_TYPE>() != NXE_CONTENT_TYPE
+		|| header.Get<STFS_DESCRIPTOR_TYPE_FIELD>() != STFS_DESCRIPTOR_SVOD || header.Get<STFS_DATA_FILE_COUNT>() == 0)
+		return false;
+
+	nxe->path = path;
+	nxe->title.mediaId = header.Get<STFS_MEDIA_ID>();
+	nxe->title.version = header.Get<STFS_VERSION>();
+	nxe->title.baseVersion = header.Get<STFS_BASE_VERSION>();
+	nxe->title.titleId = header.Get<STFS_TITLE_ID>();
+	nxe->title.platform = header.Get<STFS_PLATFORM>();
+	nxe->title.executableType = header.Get<STFS_EXECUTABLE_TYPE>();
+	nxe->title.discNumber = header.Get<STFS_DISC_NUMBER>();
+	nxe->title.discsInSet = header.Get<STFS_DISCS_IN_SET>();
+	nxe->title.savegameId = header.Get<STFS_SAVEGAME_ID>();
+	header.GetString<STFS_DISPLAY_NAME>(0, nxe->title.name, GOD_DISPLAY_NAME_CHARS + 1);
+	nxe->parts = header.Get<STFS_DATA_FILE_COUNT>();
+	nxe->dataBlockOffset = header.Get<STFS_SVOD_DATA_BLOCK_OFFSET>();
+
+	// The block count says how much of the last part is image rather than padding
+	DWORD blocks = header.Get<STFS_SVOD_DATA_BLOCK_COUNT>();
+	nxe->size = (unsigned long long)blocks * SVOD_BLOCK_SIZE;
+	if (blocks == 0 || blocks > nxe->parts * SVOD_BLOCKS_PER_PART || blocks <= (nxe->parts - 1) * SVOD_BLOCKS_PER_PART)
+		return false;
+	return true;
+}
+
+// Installs sit beside GOD titles as <profile>\<title id>\00004000\<name>
+unsigned int FindNXEInstalls(int device, const string& root, vector<NXE>& found)
+{
+	unsigned int added = 0;
+	vector<VFS_ENTRY> titles;
+	VfsList(root.c_str(), titles);
+	for (unsigned int i = 0; i < titles.size(); i++)
+	{
+		if (!titles[i].directory || titles[i].name[0] == '.')
+			continue;
+		char folder[16];
+		sprintf(folder, "\\%08X\\", NXE_CONTENT_TYPE);
+		string nxePath = root + "\\" + titles[i].name + folder;
+		vector<VFS_ENTRY> files;
+		if (!VfsList(nxePath.c_str(), files))
+			continue;
+		for (unsigned int j = 0; j < files.size(); j++)
+		{
+			NXE nxe;
+			nxe.device = device;
+			if (!files[j].directory && ReadNXEHeader((nxePath + files[j].name).c_str(), &nxe))
+			{
+				found.push_back(nxe);
+				added++;
+			}
+		}
+	}
+	return added;
+}
+
+static bool ReadNXE(unsigned long long offset, void* buffer, DWORD size, void* context)
+{
+	return VfsReadExact((SvodReader*)context, offset, buffer, size);
+}
+
+CONVERT_RESULT ConvertNXE(const NXE& nxe, const char* contentRoot, bool setLicense, bool trim, unsigned int threads,
+	CONVERT_REPORT* report, CONVERT_PROGRESS_CALLBACK progress, void* context)
+{
+	if (nxe.dataBlockOffset != 0)
+	{
+		ResetReport(report);
+		report->result = CONVERT_UNSUPPORTED;
+		return report->result;
+	}
+
+	// Installs hold the bare game partition, so it's trimmed the same way an image is
+	SvodReader reader(nxe.path, nxe.parts, nxe.size);
+	unsigned long long size = nxe.size;
+	XdvdfsImage image;
+	if (image.Open(&reader) && image.PartitionOffset() == 0)
+		size = TrimmedSize(image, trim);
+	WriteGODPackage(nxe.title, ReadNXE, &reader, size, contentRoot, setLicense, threads, report, progress, context);
+	report->bytesSaved = nxe.size - size;
+	return report->result;
+}
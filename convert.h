@@ -0,0 +1,110 @@
+#ifndef CONVERT_H
+#define CONVERT_H
+#include <string>
+#include <vector>
+#include "header.h"
+
+// Size of the header file written for a new package: the version 2 header
+// (0xAD0E bytes) rounded up to whole blocks. Its hash covers everything from
+// STFS_HEADER_HASHED_OFFSET to the end of this.
+#define CONVERT_HEADER_FILE_SIZE	0xB000
+#define CONVERT_HEADER_SIZE			0xAD0E
+#define CONVERT_METADATA_VERSION	2
+#define CONVERT_XEX_EXECUTION_INFO	0x00040006	// Optional XEX header key of the execution id
+#define CONVERT_MEMORY_BUDGET		0x1000000	// Group buffers in flight, whatever the thread count
+
+enum CONVERT_RESULT
+{
+	CONVERT_OK = 0,
+	CONVERT_OPEN_FAILED,	// Couldn't open the source
+	CONVERT_NOT_XDVDFS,		// No game partition in the image
+	CONVERT_NO_XEX,			// default.xex is missing or has no execution id
+	CONVERT_CREATE_FAILED,	// Couldn't create the package folders or files
+	CONVERT_EXISTS,			// The target package or its data folder is already there, nothing touched
+	CONVERT_READ_FAILED,
+	CONVERT_WRITE_FAILED,
+	CONVERT_UNSUPPORTED		// The install's data doesn't start at block 0, which isn't handled
+};
+
+struct CONVERT_REPORT
+{
+	CONVERT_RESULT result;
+	std::string headerPath;			// The package written, once its folders exist
+	DWORD parts;
+	unsigned long long bytesRead;	// Disc image bytes taken from the source
+	unsigned long long bytesWritten;	// Data parts plus header
+	unsigned long long bytesSaved;	// Unused sectors past the end of the file system left out by trimming
+	unsigned long elapsedMs;
+
+	DWORD MBps() const { return elapsedMs ? (DWORD)(bytesRead / 1000 / elapsedMs) : 0; }
+};
+
+// Identity of the title being packaged, as the execution id in its default.xex gives it
+struct CONVERT_TITLE
+{
+	DWORD mediaId;
+	DWORD version;
+	DWORD baseVersion;
+	DWORD titleId;
+	BYTE platform;
+	BYTE executableType;
+	BYTE discNumber;
+	BYTE discsInSet;
+	DWORD savegameId;
+	WCHAR name[GOD_DISPLAY_NAME_CHARS + 1];
+};
+
+// An installed disc found by FindNXEInstalls
+struct NXE
+{
+	int device;
+	std::string path;		// Header package
+	CONVERT_TITLE title;
+	DWORD parts;
+	unsigned long long size;	// Disc image bytes held in the parts
+	DWORD dataBlockOffset;		// First data block of the image, only 0 can be converted
+};
+
+// Called on the reading thread after each group is queued
+typedef void (*CONVERT_PROGRESS_CALLBACK)(unsigned long long done, unsigned long long total, void* context);
+
+// Fills buffer with size bytes of the disc image at offset. Offsets only ever go
+// forwards, one group of data blocks at a time.
+typedef bool (*CONVERT_READ_CALLBACK)(unsigned long long offset, void* buffer, DWORD size, void* context);
+
+// Packages size bytes of disc image as an SVOD package under contentRoot, in
+// <title id>\00007000\<media id>. The header is written last, already unlocked:
+// LIVE magic, our signature and the license block. A package already at that
+// path is never overwritten, so a failed conversion only removes what it created.
+//
+// Three stages overlap: the calling thread reads groups of data blocks into a
+// pool of buffers sized by CONVERT_MEMORY_BUDGET, threads workers build each
+// group's hash block, and one writer thread puts groups into the part files.
+// The master hash blocks are chained and written once every group is in place.
+CONVERT_RESULT WriteGODPackage(const CONVERT_TITLE& title, CONVERT_READ_CALLBACK read, void* readContext,
+	unsigned long long size, const char* contentRoot, bool setLicense, unsigned int threads, CONVERT_REPORT* report,
+	CONVERT_PROGRESS_CALLBACK progress = NULL, void* context = NULL);
+
+// Converts a disc image (full dump or bare game partition) to a GOD package. The
+// title's identity comes from the image's default.xex; name defaults to the
+// image's file name. trim stops the package at the last sector the XDVDFS tree
+// uses, dropping the padding that fills out the rest of the disc.
+CONVERT_RESULT ConvertISO(const char* isoPath, const char* contentRoot, const WCHAR* name, bool setLicense, bool trim,
+	unsigned int threads, CONVERT_REPORT* report, CONVERT_PROGRESS_CALLBACK progress = NULL, void* context = NULL);
+
+// Reads an NXE header package, false if it isn't one
+bool ReadNXEHeader(const char* path, NXE* nxe);
+
+// Adds every NXE install under root (a profile folder, as scanned for GOD
+// titles) to found. Returns how many were added.
+unsigned int FindNXEInstalls(int device, const std::string& root, std::vector<NXE>& found);
+
+// Repackages an NXE install as a GOD package under contentRoot. The disc image
+// is streamed out of the install's parts, hash blocks dropped, straight into
+// WriteGODPackage, so the new hash tree and the unlocked header are produced in
+// the same pass. The install itself is left in place. trim works as for ConvertISO.
+// An install whose data block offset isn't 0 is refused with CONVERT_UNSUPPORTED,
+// since the package written always starts its data at block 0.
+CONVERT_RESULT ConvertNXE(const NXE& nxe, const char* contentRoot, bool setLicense, bool trim, unsigned int threads,
+	CONVERT_REPORT* report, CONVERT_PROGRESS_CALLBACK progress = NULL, void* context = NULL);
+#endif
@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "extract.h"
+#include "queue.h"
+#include "sha1.h"
+#include "svod.h"
+#include "vfs.h"
+
+using std::string;
+using std::vector;
+
+#define EXTRACT_BUFFER_SIZE	(EXTRACT_BUFFER_GROUPS * SVOD_GROUP_SIZE)
+
+// A run of whole groups read from one part, exactly as they sit in the file
+struct EXTRACT_BUFFER
+{
+	BYTE* data;
+	DWORD part;
+	DWORD firstGroup;
+	DWORD length;
+	BYTE expected[EXTRACT_BUFFER_GROUPS][SHA1_DIGEST_SIZE];	// Hash block hashes from the master block
+};
+
+struct EXTRACT_STATE
+{
+	BoundedQueue<EXTRACT_BUFFER*>* full;
+	BoundedQueue<EXTRACT_BUFFER*>* idle;
+	VfsFile* image;
+	unsigned long long imageSize;
+	unsigned long long written;
+	bool verify;
+	CriticalSection lock;
+	EXTRACT_REPORT* report;
+	volatile bool failed;
+};
+
+// Keeps the earliest failure in the package, whichever thread finds it first
+static void RecordFailure(EXTRACT_STATE* state, EXTRACT_RESULT result, DWORD part, unsigned long long offset)
+{
+	ScopedLock lock(state->lock);
+	EXTRACT_REPORT* report = state->report;
+	if (state->failed && (report->part < part || (report->part == part && report->offset <= offset)))
+		return;
+	report->result = result;
+	report->part = part;
+	report->offset = offset;
+	state->failed = true;
+}
+
+static bool VerifyBuffer(EXTRACT_STATE* state, EXTRACT_BUFFER* buffer)
+{
+	BYTE digest[SHA1_DIGEST_SIZE];
+	for (DWORD start = 0, group = 0; start < buffer->length; start += SVOD_GROUP_SIZE, group++)
+	{
+		unsigned long long groupOffset = SVOD_BLOCK_SIZE + (unsigned long long)(buffer->firstGroup + group) * SVOD_GROUP_SIZE;
+		const BYTE* hashes = buffer->data + start;
+		Sha1(hashes, SVOD_BLOCK_SIZE, digest);
+		if (memcmp(digest, buffer->expected[group], sizeof(digest)) != 0)
+		{
+			RecordFailure(state, EXTRACT_HASH_MISMATCH, buffer->part, groupOffset);
+			return false;
+		}
+		DWORD end = start + SVOD_GROUP_SIZE < buffer->length ? start + SVOD_GROUP_SIZE : buffer->length;
+		for (DWORD i = 0; start + (1 + i) * SVOD_BLOCK_SIZE < end; i++)
+		{
+			Sha1(buffer->data + start + (1 + i) * SVOD_BLOCK_SIZE, SVOD_BLOCK_SIZE, digest);
+			if (memcmp(digest, hashes + i * SHA1_DIGEST_SIZE, sizeof(digest)) != 0)
+			{
+				RecordFailure(state, EXTRACT_HASH_MISMATCH, buffer->part, groupOffset + (1 + i) * SVOD_BLOCK_SIZE);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void WriteWorker(void* param)
+{
+	EXTRACT_STATE* state = (EXTRACT_STATE*)param;
+	for (;;)
+	{
+		// A NULL buffer tells the writer to finish
+		EXTRACT_BUFFER* buffer = state->full->Pop();
+		if (buffer == NULL)
+			return;
+		if (!state->failed && (!state->verify || VerifyBuffer(state, buffer)))
+		{
+			// Close the gaps left by the hash blocks so the data goes out in one write
+			DWORD length = 0;
+			for (DWORD start = 0; start < buffer->length; start += SVOD_GROUP_SIZE)
+			{
+				DWORD end = start + SVOD_GROUP_SIZE < buffer->length ? start + SVOD_GROUP_SIZE : buffer->length;
+				DWORD data = end - start - SVOD_BLOCK_SIZE;
+				memmove(buffer->data + length, buffer->data + start + SVOD_BLOCK_SIZE, data);
+				length += data;
+			}
+
+			// The last block may run past the end of the image
+			if (length > state->imageSize - state->written)
+				length = (DWORD)(state->imageSize - state->written);
+			if (length > 0 && !state->image->Write(state->written, buffer->data, length))
+				RecordFailure(state, EXTRACT_WRITE_FAILED, buffer->part, SVOD_BLOCK_SIZE + (unsigned long long)buffer->firstGroup * SVOD_GROUP_SIZE);
+			else
+				state->written += length;
+		}
+		state->idle->Push(buffer);
+	}
+}
+
+// Reads one part's master block, checking it against the chain when verifying,
+// then queues its groups a buffer at a time. expected is replaced with the next
+// part's master hash.
+static bool ReadPart(EXTRACT_STATE* state, const string& path, DWORD part, bool last, BYTE* expected,
+	unsigned long long* done, unsigned long long total, EXTRACT_PROGRESS_CALLBACK progress, void* context)
+{
+	VfsFile* file = VfsOpen(path.c_str(), VFS_READ);
+	if (file == NULL)
+	{
+		RecordFailure(state, EXTRACT_MISSING_PART, part, 0);
+		return false;
+	}
+
+	// Every part but the last is full size, and all of them are whole blocks
+	unsigned long long size = file->Size();
+	if (size < SVOD_BLOCK_SIZE * 3 || size % SVOD_BLOCK_SIZE != 0 || size > SVOD_PART_SIZE || (!last && size != SVOD_PART_SIZE))
+	{
+		delete file;
+		RecordFailure(state, EXTRACT_MISSING_PART, part, 0);
+		return false;
+	}
+
+	BYTE master[SVOD_BLOCK_SIZE];
+	if (!VfsReadExact(file, 0, master, sizeof(master)))
+	{
+		delete file;
+		RecordFailure(state, EXTRACT_READ_FAILED, part, 0);
+		return false;
+	}
+	if (state->verify)
+	{
+		BYTE digest[SHA1_DIGEST_SIZE];
+		Sha1(master, sizeof(master), digest);
+		if (memcmp(digest, expected, sizeof(digest)) != 0)
+		{
+			delete file;
+			RecordFailure(state, EXTRACT_HASH_MISMATCH, part, 0);
+			return false;
+		}
+	}
+	memcpy(expected, master + SVOD_NEXT_PART_HASH_OFFSET, SHA1_DIGEST_SIZE);
+
+	bool ok = true;
+	for (unsigned long long offset = SVOD_BLOCK_SIZE; offset < size && !state->failed;)
+	{
+		DWORD length = size - offset < EXTRACT_BUFFER_SIZE ? (DWORD)(size - offset) : EXTRACT_BUFFER_SIZE;
+		EXTRACT_BUFFER* buffer = state->idle->Pop();
+		buffer->part = part;
+		buffer->firstGroup = (DWORD)((offset - SVOD_BLOCK_SIZE) / SVOD_GROUP_SIZE);
+		buffer->length = length;
+		for (DWORD group = 0; group * SVOD_GROUP_SIZE < length; group++)
+			memcpy(buffer->expected[group], master + (buffer->firstGroup + group) * SHA1_DIGEST_SIZE, SHA1_DIGEST_SIZE);
+		if (!VfsReadExact(file, offset, buffer->data, length))
+		{
+			state->idle->Push(buffer);
+			RecordFailure(state, EXTRACT_READ_FAILED, part, offset);
+			ok = false;
+			break;
+		}
+		state->full->Push(buffer);
+		offset += length;
+		*done += length;
+		if (progress)
+			progress(*done, total, context);
+	}
+	delete file;
+	return ok && !state->failed;
+}
+
+EXTRACT_RESULT ExtractGOD(const char* headerPath, const char* imagePath, bool verify, EXTRACT_REPORT* report,
+	EXTRACT_PROGRESS_CALLBACK progress, void* context)
+{
+	memset(report, 0, sizeof(EXTRACT_REPORT));
+	unsigned long start = TickCount();
+
+	BYTE page[SVOD_BLOCK_SIZE];
+	DWORD read = 0;
+	VfsFile* headerFile = VfsOpen(headerPath, VFS_READ);
+	if (headerFile)
+	{
+		if (!headerFile->Read(0, page, sizeof(page), &read))
+			read = 0;
+		delete headerFile;
+	}
+	StfsHeaderView header(page, read);
+	DWORD parts = header.Get<STFS_DATA_FILE_COUNT>();
+	DWORD blocks = header.Get<STFS_SVOD_DATA_BLOCK_COUNT>();
+	if (!header.Has<STFS_DESCRIPTOR_TYPE_FIELD>() || header.Get<STFS_DESCRIPTOR_TYPE_FIELD>() != STFS_DESCRIPTOR_SVOD
+		|| parts == 0 || blocks == 0 || blocks > parts * SVOD_BLOCKS_PER_PART)
+	{
+		report->result = EXTRACT_BAD_HEADER;
+		return report->result;
+	}
+	// The image is read from the first block of Data0000 on
+	if (header.Get<STFS_SVOD_DATA_BLOCK_OFFSET>() != 0)
+	{
+		report->result = EXTRACT_UNSUPPORTED;
+		return report->result;
+	}
+	unsigned long long total = header.Get<STFS_DATA_FILE_SIZE>();
+
+	// Truncating an image the user already has, then removing it on failure, would lose it
+	VfsFile* existing = VfsOpen(imagePath, VFS_READ);
+	if (existing != NULL)
+	{
+		delete existing;
+		report->result = EXTRACT_EXISTS;
+		return report->result;
+	}
+
+	EXTRACT_STATE state;
+	state.image = VfsOpen(imagePath, VFS_CREATE);
+	if (state.image == NULL)
+	{
+		report->result = EXTRACT_WRITE_FAILED;
+		return report->result;
+	}
+	state.imageSize = (unsigned long long)blocks * SVOD_BLOCK_SIZE;
+	state.written = 0;
+	state.verify = verify;
+	state.report = report;
+	state.failed = false;
+
+	// Two buffers, block aligned so the console can hand them straight to the drive
+	BoundedQueue<EXTRACT_BUFFER*> full(3);
+	BoundedQueue<EXTRACT_BUFFER*> idle(2);
+	EXTRACT_BUFFER buffers[2];
+	vector<BYTE> memory(2 * EXTRACT_BUFFER_SIZE + SVOD_BLOCK_SIZE);
+	BYTE* aligned = &memory[0] + (SVOD_BLOCK_SIZE - ((size_t)&memory[0] % SVOD_BLOCK_SIZE)) % SVOD_BLOCK_SIZE;
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		buffers[i].data = aligned + i * EXTRACT_BUFFER_SIZE;
+		idle.Push(&buffers[i]);
+	}
+	state.full = &full;
+	state.idle = &idle;
+
+	THREAD_HANDLE writer;
+	if (!StartThread(WriteWorker, &state, &writer))
+	{
+		delete state.image;
+		VfsRemove(imagePath);
+		report->result = EXTRACT_WRITE_FAILED;
+		return report->result;
+	}
+
+	BYTE expected[SHA1_DIGEST_SIZE];
+	memcpy(expected, header.Get<STFS_SVOD_ROOT_HASH>(), sizeof(expected));
+	unsigned long long done = 0;
+	for (DWORD part = 0; part < parts; part++)
+	{
+		if (!ReadPart(&state, SvodPartPath(headerPath, part), part, part + 1 == parts, expected, &done, total, progress, context))
+			break;
+	}
+	full.Push(NULL);
+	JoinThread(writer);
+
+	if (!state.failed && state.written != state.imageSize)
+		RecordFailure(&state, EXTRACT_MISSING_PART, parts - 1, 0);
+	if (!state.failed && !state.image->Flush())
+		RecordFailure(&state, EXTRACT_WRITE_FAILED, parts - 1, 0);
+	delete state.image;
+	if (state.failed)
+		VfsRemove(imagePath);
+
+	report->bytes = state.written;
+	report->elapsedMs = TickCount() - start;
+	if (!state.failed)
+		report->result = EXTRACT_OK;
+	return report->result;
+}
+
+EXTRACT_RESULT ExtractGOD(const Catalog& catalog, unsigned int index, const char* folder, bool verify,
+	EXTRACT_REPORT* report, EXTRACT_PROGRESS_CALLBACK progress, void* context)
+{
+	char titleId[16];
+	sprintf(titleId, "\\%08X ", catalog.Entry(index).titleId);
+	string imagePath = string(folder) + titleId + catalog.FileName(index) + ".iso";
+	return ExtractGOD(catalog.FullPath(index).c_str(), imagePath.c_str(), verify, report, progress, context);
+}
@@ -0,0 +1,47 @@
+#ifndef EXTRACT_H
+#define EXTRACT_H
+#include "catalog.h"
+
+#define EXTRACT_BUFFER_GROUPS	8	// Hash groups per read, about 6.4MB
+
+enum EXTRACT_RESULT
+{
+	EXTRACT_OK = 0,
+	EXTRACT_BAD_HEADER,		// Header unreadable or not an SVOD package
+	EXTRACT_MISSING_PART,	// A data part is missing or the wrong size
+	EXTRACT_READ_FAILED,
+	EXTRACT_WRITE_FAILED,	// Couldn't create or write the image
+	EXTRACT_HASH_MISMATCH,	// Only when verifying
+	EXTRACT_UNSUPPORTED,	// The data doesn't start at block 0, nothing written
+	EXTRACT_EXISTS			// A file is already at the image path, nothing touched
+};
+
+struct EXTRACT_REPORT
+{
+	EXTRACT_RESULT result;
+	DWORD part;					// Where reading or verifying failed
+	unsigned long long offset;	// Byte offset within that part
+	unsigned long long bytes;	// Image bytes written
+	unsigned long elapsedMs;
+
+	DWORD MBps() const { return elapsedMs ? (DWORD)(bytes / 1000 / elapsedMs) : 0; }
+};
+
+// Called on the reading thread after each buffer is queued
+typedef void (*EXTRACT_PROGRESS_CALLBACK)(unsigned long long done, unsigned long long total, void* context);
+
+// Writes the disc image held in a GOD package to imagePath. The parts are read
+// in order, EXTRACT_BUFFER_GROUPS whole groups at a time, into two aligned
+// buffers: one fills while a writer thread strips the hash blocks out of the
+// other and writes its data blocks as a single sequential write. With verify,
+// the writer also checks each group against the hash tree before writing it,
+// from the same buffer, so verifying costs no extra reads. An existing file at
+// imagePath is never overwritten, so a failed extraction only removes the
+// partial image it created.
+EXTRACT_RESULT ExtractGOD(const char* headerPath, const char* imagePath, bool verify, EXTRACT_REPORT* report,
+	EXTRACT_PROGRESS_CALLBACK progress = NULL, void* context = NULL);
+
+// Extracts a cataloged package into folder as "<title id> <file name>.iso"
+EXTRACT_RESULT ExtractGOD(const Catalog& catalog, unsigned int index, const char* folder, bool verify,
+	EXTRACT_REPORT* report, EXTRACT_PROGRESS_CALLBACK progress = NULL, void* context = NULL);
+#endif
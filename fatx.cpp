@@ -0,0 +1,356 @@
+#ifndef _XBOX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include <string.h>
+#include "fatx.h"
+
+using std::string;
+using std::vector;
+
+static DWORD GetBE32(const BYTE* p)
+{
+	return ((DWORD)p[0] << 24) | ((DWORD)p[1] << 16) | ((DWORD)p[2] << 8) | (DWORD)p[3];
+}
+
+// A file inside the volume. It keeps a pointer to its cached cluster chain, so
+// reads and writes go straight to the right clusters of the image.
+class FatxFile : public VfsFile
+{
+public:
+	FatxFile(FatxVolume* volume, const vector<DWORD>* chain, DWORD size, bool writable)
+		: m_volume(volume), m_chain(chain), m_size(size), m_writable(writable) {}
+
+	bool Read(unsigned long long offset, void* buffer, DWORD size, DWORD* read)
+	{
+		*read = 0;
+		if (offset >= m_size)
+			return true;
+		if (size > m_size - offset)
+			size = (DWORD)(m_size - offset);
+		if (!m_volume->ReadChain(*m_chain, offset, buffer, size))
+			return false;
+		*read = size;
+		return true;
+	}
+
+	bool Write(unsigned long long offset, const void* buffer, DWORD size)
+	{
+		// Files can't grow, that would need clusters allocated
+		if (!m_writable || offset + size > m_size)
+			return false;
+		return m_volume->WriteChain(*m_chain, offset, buffer, size);
+	}
+
+	unsigned long long Size() { return m_size; }
+	bool Flush() { return m_volume->Flush(); }
+
+private:
+	FatxVolume* m_volume;
+	const vector<DWORD>* m_chain;
+	DWORD m_size;
+	bool m_writable;
+};
+
+FatxVolume::FatxVolume()
+	: m_image(NULL), m_partition(0), m_dataStart(0), m_clusterSize(0), m_clusterCount(0),
+	m_entrySize(0), m_rootCluster(0), m_writable(false), m_fat(NULL), m_fatSize(0)
+#ifndef _XBOX
+	, m_mapping(NULL), m_mappingSize(0)
+#endif
+{
+}
+
+FatxVolume::~FatxVolume()
+{
+	Close();
+}
+
+bool FatxVolume::OpenImage(const char* image, bool writable)
+{
+	Close();
+	m_image = VfsOpen(image, writable ? VFS_READWRITE : VFS_READ);
+	if (m_image == NULL)
+		return false;
+	m_writable = writable;
+	unsigned long long imageSize = m_image->Size();
+
+	// A partition dump starts with the header, a whole drive has the data partition further in
+	static const unsigned long long Candidates[] = { 0, FATX_HDD_DATA_OFFSET };
+	BYTE header[FATX_HEADER_SIZE];
+	for (unsigned int i = 0; i < sizeof(Candidates) / sizeof(Candidates[0]); i++)
+	{
+		if (Candidates[i] + FATX_HEADER_SIZE > imageSize)
+			continue;
+		if (!VfsReadExact(m_image, Candidates[i], header, sizeof(header)) || GetBE32(header) != FATX_MAGIC)
+			continue;
+
+		DWORD sectorsPerCluster = GetBE32(header + 8);
+		m_partition = Candidates[i];
+		m_clusterSize = sectorsPerCluster * FATX_SECTOR_SIZE;
+		m_rootCluster = GetBE32(header + 12);
+		if (m_clusterSize == 0 || (m_clusterSize & (m_clusterSize - 1)) != 0)
+			continue;
+
+		// The table has one entry per cluster and is padded to a whole page
+		unsigned long long partitionSize = imageSize - m_partition;
+		m_clusterCount = (DWORD)(partitionSize / m_clusterSize);
+		m_entrySize = m_clusterCount < 0xFFF0 ? 2 : 4;
+		m_fatSize = ((unsigned long long)m_clusterCount * m_entrySize + 0xFFF) & ~0xFFFULL;
+		m_dataStart = m_partition + FATX_HEADER_SIZE + m_fatSize;
+		if (m_dataStart >= imageSize || m_rootCluster == 0 || m_rootCluster >= m_clusterCount)
+			continue;
+		if (MapTable(image))
+			return true;
+	}
+	Close();
+	return false;
+}
+
+// Maps just the allocation table. Host builds use mmap so a large drive's table
+// is paged in as chains touch it; the console reads it into memory once.
+bool FatxVolume::MapTable(const char* image)
+{
+	unsigned long long tableOffset = m_partition + FATX_HEADER_SIZE;
+#ifndef _XBOX
+	int fd = open(image, O_RDONLY);
+	if (fd >= 0)
+	{
+		unsigned long long page = sysconf(_SC_PAGESIZE);
+		unsigned long long mapStart = tableOffset & ~(page - 1);
+		m_mappingSize = (size_t)(tableOffset - mapStart + m_fatSize);
+		m_mapping = mmap(NULL, m_mappingSize, PROT_READ, MAP_SHARED, fd, (off_t)mapStart);
+		close(fd);
+		if (m_mapping != MAP_FAILED)
+		{
+			m_fat = (const BYTE*)m_mapping + (tableOffset - mapStart);
+			return true;
+		}
+		m_mapping = NULL;
+		m_mappingSize = 0;
+	}
+#endif
+	m_fatCopy.resize((size_t)m_fatSize);
+	if (!VfsReadExact(m_image, tableOffset, &m_fatCopy[0], (DWORD)m_fatSize))
+		return false;
+	m_fat = &m_fatCopy[0];
+	return true;
+}
+
+void FatxVolume::Close()
+{
+#ifndef _XBOX
+	if (m_mapping)
+		munmap(m_mapping, m_mappingSize);
+	m_mapping = NULL;
+	m_mappingSize = 0;
+#endif
+	m_fat = NULL;
+	m_fatCopy.clear();
+	m_chains.clear();
+	m_directories.clear();
+	if (m_image)
+	{
+		delete m_image;
+		m_image = NULL;
+	}
+}
+
+DWORD FatxVolume::NextCluster(DWORD cluster) const
+{
+	const BYTE* entry = m_fat + (unsigned long long)cluster * m_entrySize;
+	DWORD next;
+	if (m_entrySize == 2)
+	{
+		next = (entry[0] << 8) | entry[1];
+		if (next >= 0xFFF0)
+			return 0;
+	}
+	else
+	{
+		next = GetBE32(entry);
+		if (next >= 0xFFFFFFF0)
+			return 0;
+	}
+	return next;
+}
+
+unsigned long long FatxVolume::ClusterOffset(DWORD cluster) const
+{
+	// Cluster numbering starts at 1
+	return m_dataStart + (unsigned long long)(cluster - 1) * m_clusterSize;
+}
+
+const vector<DWORD>* FatxVolume::Chain(DWORD first)
+{
+	ScopedLock lock(m_lock);
+	std::map<DWORD, vector<DWORD> >::iterator it = m_chains.find(first);
+	if (it != m_chains.end())
+		return &it->second;
+
+	// A chain can't be longer than the volume, which also stops a looped table
+	vector<DWORD>& chain = m_chains[first];
+	for (DWORD cluster = first; cluster != 0 && cluster < m_clusterCount && chain.size() < m_clusterCount; cluster = NextCluster(cluster))
+		chain.push_back(cluster);
+	return &chain;
+}
+
+bool FatxVolume::TransferChain(const vector<DWORD>& chain, unsigned long long offset, void* buffer, DWORD size, bool write)
+{
+	BYTE* p = (BYTE*)buffer;
+	size_t index = (size_t)(offset / m_clusterSize);
+	DWORD within = (DWORD)(offset % m_clusterSize);
+	ScopedLock lock(m_lock);
+	while (size > 0)
+	{
+		if (index >= chain.size())
+			return false;
+
+		// Extend the request over clusters that follow each other on disk
+		size_t run = 1;
+		while (index + run < chain.size() && chain[index + run] == chain[index] + run
+			&& (unsigned long long)run * m_clusterSize < within + (unsigned long long)size)
+			run++;
+		unsigned long long available = (unsigned long long)run * m_clusterSize - within;
+		DWORD count = available < size ? (DWORD)available : size;
+
+		unsigned long long position = ClusterOffset(chain[index]) + within;
+		bool ok = write ? m_image->Write(position, p, count) : VfsReadExact(m_image, position, p, count);
+		if (!ok)
+			return false;
+		p += count;
+		size -= count;
+		index += run;
+		within = 0;
+	}
+	return true;
+}
+
+bool FatxVolume::ReadChain(const vector<DWORD>& chain, unsigned long long offset, void* buffer, DWORD size)
+{
+	return TransferChain(chain, offset, buffer, size, false);
+}
+
+bool FatxVolume::WriteChain(const vector<DWORD>& chain, unsigned long long offset, const void* buffer, DWORD size)
+{
+	if (!m_writable)
+		return false;
+	return TransferChain(chain, offset, (void*)buffer, size, true);
+}
+
+bool FatxVolume::Flush()
+{
+	ScopedLock lock(m_lock);
+	return m_image != NULL && (!m_writable || m_image->Flush());
+}
+
+bool FatxVolume::ReadDirectory(DWORD firstCluster, vector<FATX_DIRENT>& entries)
+{
+	{
+		ScopedLock lock(m_lock);
+		std::map<DWORD, vector<FATX_DIRENT> >::iterator it = m_directories.find(firstCluster);
+		if (it != m_directories.end())
+		{
+			entries = it->second;
+			return true;
+		}
+	}
+
+	const vector<DWORD>* chain = Chain(firstCluster);
+	if (chain->empty())
+		return false;
+	vector<BYTE> data(chain->size() * m_clusterSize);
+	if (!ReadChain(*chain, 0, &data[0], (DWORD)data.size()))
+		return false;
+
+	entries.clear();
+	for (size_t offset = 0; offset + FATX_DIRENT_SIZE <= data.size(); offset += FATX_DIRENT_SIZE)
+	{
+		const BYTE* dirent = &data[offset];
+		BYTE nameLength = dirent[0];
+		// 0x00 or 0xFF marks the end of the directory
+		if (nameLength == 0x00 || nameLength == 0xFF)
+			break;
+		if (nameLength == FATX_DIRENT_DELETED || nameLength > FATX_NAME_MAX)
+			continue;
+		FATX_DIRENT entry;
+		entry.attributes = dirent[1];
+		entry.name.assign((const char*)dirent + 2, nameLength);
+		entry.firstCluster = GetBE32(dirent + 0x2C);
+		entry.size = GetBE32(dirent + 0x30);
+		entry.lastWrite = GetBE32(dirent + 0x38);
+		entries.push_back(entry);
+	}
+
+	ScopedLock lock(m_lock);
+	m_directories[firstCluster] = entries;
+	return true;
+}
+
+bool FatxVolume::Lookup(const char* path, FATX_DIRENT* entry)
+{
+	// Everything up to the device colon is the mount prefix
+	const char* p = strchr(path, ':');
+	p = p ? p + 1 : path;
+
+	entry->name.clear();
+	entry->attributes = FATX_ATTRIBUTE_DIRECTORY;
+	entry->firstCluster = m_rootCluster;
+	entry->size = 0;
+	entry->lastWrite = 0;
+
+	vector<FATX_DIRENT> entries;
+	while (*p)
+	{
+		if (*p == '\\' || *p == '/')
+		{
+			p++;
+			continue;
+		}
+		const char* end = p;
+		while (*end && *end != '\\' && *end != '/')
+			end++;
+		string component(p, end - p);
+		p = end;
+
+		if (!(entry->attributes & FATX_ATTRIBUTE_DIRECTORY) || !ReadDirectory(entry->firstCluster, entries))
+			return false;
+		unsigned int i = 0;
+		while (i < entries.size() && _stricmp(entries[i].name.c_str(), component.c_str()) != 0)
+			i++;
+		if (i == entries.size())
+			return false;
+		*entry = entries[i];
+	}
+	return true;
+}
+
+VfsFile* FatxVolume::Open(const char* path, VFS_MODE mode)
+{
+	if (m_image == NULL || mode == VFS_CREATE || (mode != VFS_READ && !m_writable))
+		return NULL;
+	FATX_DIRENT entry;
+	if (!Lookup(path, &entry) || (entry.attributes & FATX_ATTRIBUTE_DIRECTORY))
+		return NULL;
+	return new FatxFile(this, Chain(entry.firstCluster), entry.size, mode != VFS_READ);
+}
+
+bool FatxVolume::List(const char* dir, vector<VFS_ENTRY>& entries)
+{
+	FATX_DIRENT directory;
+	vector<FATX_DIRENT> found;
+	if (m_image == NULL || !Lookup(dir, &directory) || !(directory.attributes & FATX_ATTRIBUTE_DIRECTORY)
+		|| !ReadDirectory(directory.firstCluster, found))
+		return false;
+	for (unsigned int i = 0; i < found.size(); i++)
+	{
+		VFS_ENTRY entry;
+		entry.name = found[i].name;
+		entry.directory = (found[i].attributes & FATX_ATTRIBUTE_DIRECTORY) != 0;
+		entry.size = found[i].size;
+		entry.lastWrite = found[i].lastWrite;
+		entries.push_back(entry);
+	}
+	return true;
+}
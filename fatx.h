@@ -0,0 +1,95 @@
+#ifndef FATX_H
+#define FATX_H
+#include <map>
+#include <string>
+#include <vector>
+#include "thread.h"
+#include "vfs.h"
+
+#define FATX_MAGIC					0x58544146	// XTAF
+#define FATX_HEADER_SIZE			0x1000
+#define FATX_SECTOR_SIZE			0x200
+#define FATX_DIRENT_SIZE			0x40
+#define FATX_NAME_MAX				42
+#define FATX_ATTRIBUTE_DIRECTORY	0x10
+#define FATX_DIRENT_DELETED			0xE5
+#define FATX_HDD_DATA_OFFSET		0x130EB0000ULL	// Partition1 on a retail hard drive
+
+struct FATX_DIRENT
+{
+	std::string name;
+	BYTE attributes;
+	DWORD firstCluster;
+	DWORD size;
+	DWORD lastWrite;	// Packed FAT date/time as stored
+};
+
+// Reads a FATX partition straight out of a raw drive image, partition dump or
+// block device. Paths look like "<prefix>:\Content\..." where the prefix is
+// whatever the volume was mounted as with VfsMount.
+//
+// Only the contents of existing files can be written; the FAT and directories
+// are never modified, so nothing can be created, resized or removed.
+class FatxVolume : public Vfs
+{
+public:
+	FatxVolume();
+	~FatxVolume();
+
+	// Finds the partition by its magic, either at the start of the image or at
+	// the retail Partition1 offset, and maps its FAT. writable opens the image
+	// read/write so headers can be patched in place.
+	bool OpenImage(const char* image, bool writable);
+	void Close();
+
+	unsigned long long PartitionOffset() const { return m_partition; }
+	DWORD ClusterSize() const { return m_clusterSize; }
+
+	VfsFile* Open(const char* path, VFS_MODE mode);
+	bool List(const char* dir, std::vector<VFS_ENTRY>& entries);
+	bool CreateDir(const char* /*path*/) { return false; }
+	bool Remove(const char* /*path*/) { return false; }
+
+	// The clusters of the chain starting at first, cached after the first walk
+	const std::vector<DWORD>* Chain(DWORD first);
+
+	// Reads or writes size bytes at offset within a chain, coalescing runs of
+	// adjacent clusters into single requests
+	bool ReadChain(const std::vector<DWORD>& chain, unsigned long long offset, void* buffer, DWORD size);
+	bool WriteChain(const std::vector<DWORD>& chain, unsigned long long offset, const void* buffer, DWORD size);
+	bool Flush();
+
+private:
+	VfsFile* m_image;
+	CriticalSection m_lock;		// Serializes image I/O and the chain cache
+	unsigned long long m_partition;
+	unsigned long long m_dataStart;
+	DWORD m_clusterSize;
+	DWORD m_clusterCount;
+	DWORD m_entrySize;			// 2 or 4 byte FAT entries
+	DWORD m_rootCluster;
+	bool m_writable;
+
+	const BYTE* m_fat;			// The mapped (or, on the console, loaded) allocation table
+	unsigned long long m_fatSize;
+	std::vector<BYTE> m_fatCopy;
+#ifndef _XBOX
+	void* m_mapping;
+	size_t m_mappingSize;
+#endif
+
+	// Nothing ever changes the FAT or a directory, so both caches stay valid while open
+	std::map<DWORD, std::vector<DWORD> > m_chains;
+	std::map<DWORD, std::vector<FATX_DIRENT> > m_directories;
+
+	bool MapTable(const char* image);
+	DWORD NextCluster(DWORD cluster) const;
+	unsigned long long ClusterOffset(DWORD cluster) const;
+	bool ReadDirectory(DWORD firstCluster, std::vector<FATX_DIRENT>& entries);
+	bool Lookup(const char* path, FATX_DIRENT* entry);
+	bool TransferChain(const std::vector<DWORD>& chain, unsigned long long offset, void* buffer, DWORD size, bool write);
+
+	FatxVolume(const FatxVolume&);
+	FatxVolume& operator=(const FatxVolume&);
+};
+#endif
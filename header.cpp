@@ -0,0 +1,58 @@
+#include <string.h>
+#include "header.h"
+#include "vfs.h"
+
+GOD_TYPE ClassifyHeaderPage(const unsigned char* page, DWORD size, GOD_HEADER_INFO* info)
+{
+	memset(info, 0, sizeof(GOD_HEADER_INFO));
+	if (size < GOD_HEADER_MIN_SIZE)
+		return GOD_TYPE_NONE;
+	StfsHeaderView header(page, size);
+
+	// Confirm it's a GOD content package
+	info->contentType = header.Get<STFS_CONTENT_TYPE>();
+	if (info->contentType != GOD_CONTENT_TYPE)
+		return GOD_TYPE_NONE;
+	info->titleId = header.Get<STFS_TITLE_ID>();
+	info->mediaId = header.Get<STFS_MEDIA_ID>();
+	if (header.Has<STFS_HEADER_HASH>())
+		memcpy(info->contentId, header.Get<STFS_HEADER_HASH>(), sizeof(info->contentId));
+	info->dataSize = header.Get<STFS_DATA_FILE_SIZE>();
+
+	// Display name is stored as UTF-16BE, decode the first locale
+	header.GetString<STFS_DISPLAY_NAME>(0, info->displayName, GOD_DISPLAY_NAME_CHARS + 1);
+
+	// Lock state check. We replace the package signature with ByromWasHereUnlockingYourGODGame repeatedly when unlocking
+	// Package signature is ignored on modified consoles.
+	static const unsigned char ByromHeader[] = { 0x42, 0x79, 0x72, 0x6F }; // B y r o
+	static const DWORD LIVEHeader = 0x4C495645; // L I V E
+	static const DWORD PIRSHeader = 0x50495253; // P I R S
+	DWORD magic = header.Get<STFS_MAGIC>();
+	if (memcmp(header.Get<STFS_SIGNATURE>(), ByromHeader, sizeof(ByromHeader)) == 0)
+		info->type = GOD_TYPE_UNLOCKED;
+	else if (magic == LIVEHeader)
+		info->type = GOD_TYPE_LIVE;
+	else if (magic == PIRSHeader)
+		info->type = GOD_TYPE_PIRS;
+	else
+		info->type = GOD_TYPE_NONE; // Header must be corrupted or something for this
+
+	return info->type;
+}
+
+GOD_TYPE ClassifyHeader(const char* path, GOD_HEADER_INFO* info)
+{
+	memset(info, 0, sizeof(GOD_HEADER_INFO));
+
+	VfsFile* file = VfsOpen(path, VFS_READ);
+	if (file == NULL)
+		return GOD_TYPE_NONE;
+
+	// One aligned read covers the magic, lock marker, content id, title and media ids, data size and display name
+	unsigned char page[GOD_HEADER_PAGE_SIZE];
+	DWORD read;
+	if (!file->Read(0, page, sizeof(page), &read))
+		read = 0;
+	delete file;
+	return ClassifyHeaderPage(page, read, info);
+}
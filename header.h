@@ -0,0 +1,45 @@
+#ifndef HEADER_H
+#define HEADER_H
+#include "platform.h"
+#include "stfs.h"
+
+// Everything the scanner needs lives in the first page of the package
+#define GOD_HEADER_PAGE_SIZE		0x1000
+#define GOD_HEADER_MIN_SIZE			(STFS_TITLE_ID::OFFSET + STFS_TITLE_ID::SIZE)
+
+#define GOD_CONTENT_TYPE			0x00007000
+#define NXE_CONTENT_TYPE			0x00004000	// Disc installed to the drive from the dashboard
+#define GOD_DISPLAY_NAME_CHARS		STFS_DISPLAY_NAME::CHARS	// First locale only
+
+// Values match the old isGOD return codes. The header classifier only produces
+// NONE, LIVE, PIRS and UNLOCKED, the title rules map those onto BUNDLE and SKIPPED.
+enum GOD_TYPE
+{
+	GOD_TYPE_NONE = 0,		// Not a GOD package (or a corrupted header)
+	GOD_TYPE_LIVE = 1,		// Regular GOD file downloaded officially or created with nxe2god
+	GOD_TYPE_PIRS = 2,		// MSP Spoofed GOD file. Will be fixed to have a LIVE header
+	GOD_TYPE_UNLOCKED = 3,	// Already unlocked by this application (either format)
+	GOD_TYPE_BUNDLE = 4,	// Game bundle downloader. License info must be wiped rather than set
+	GOD_TYPE_SKIPPED = 5,	// A title rule says never to patch it
+	GOD_TYPE_COUNT
+};
+
+struct GOD_HEADER_INFO
+{
+	GOD_TYPE type;
+	DWORD contentType;
+	DWORD titleId;
+	DWORD mediaId;
+	// The header hash doubles as the content id. It only covers the header from
+	// STFS_HEADER_HASHED_OFFSET on, so unlocking a copy doesn't change it.
+	BYTE contentId[STFS_HEADER_HASH::SIZE];
+	unsigned long long dataSize;	// Combined size of the data parts
+	WCHAR displayName[GOD_DISPLAY_NAME_CHARS + 1];
+};
+
+// Decodes a header page that has already been read into memory
+GOD_TYPE ClassifyHeaderPage(const unsigned char* page, DWORD size, GOD_HEADER_INFO* info);
+
+// Opens the package, reads the first header page once and classifies it
+GOD_TYPE ClassifyHeader(const char* path, GOD_HEADER_INFO* info);
+#endif
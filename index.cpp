@@ -0,0 +1,170 @@
+#include <string.h>
+#include "index.h"
+#include "vfs.h"
+
+using std::string;
+using std::vector;
+
+// The index is stored big-endian regardless of the platform that wrote it
+static void PutBE(vector<unsigned char>& out, unsigned long long value, int bytes)
+{
+	for (int i = bytes - 1; i >= 0; i--)
+		out.push_back((unsigned char)(value >> (i * 8)));
+}
+
+static bool GetBE(const unsigned char*& p, const unsigned char* end, int bytes, unsigned long long* value)
+{
+	if (end - p < bytes)
+		return false;
+	*value = 0;
+	for (int i = 0; i < bytes; i++)
+		*value = (*value << 8) | *p++;
+	return true;
+}
+
+ScanIndex::ScanIndex() : m_dirty(false), m_hits(0), m_misses(0)
+{
+}
+
+bool ScanIndex::Load(const char* file)
+{
+	vector<char> buffer;
+	if (!VfsReadFile(file, buffer) || buffer.empty())
+		return false;
+
+	const unsigned char* p = (const unsigned char*)&buffer[0];
+	const unsigned char* end = p + buffer.size();
+	unsigned long long magic, version, count;
+	if (!GetBE(p, end, 4, &magic) || magic != SCAN_INDEX_MAGIC
+		|| !GetBE(p, end, 4, &version) || version != SCAN_INDEX_VERSION
+		|| !GetBE(p, end, 4, &count))
+		return false;
+
+	EntryMap entries;
+	for (unsigned long long i = 0; i < count; i++)
+	{
+		unsigned long long pathLen, type, contentType, titleId, mediaId, nameLen;
+		SCAN_INDEX_ENTRY entry;
+		memset(&entry, 0, sizeof(entry));
+		if (!GetBE(p, end, 2, &pathLen) || end - p < (long)pathLen)
+			return false;
+		string path((const char*)p, (size_t)pathLen);
+		p += pathLen;
+		if (!GetBE(p, end, 8, &entry.size) || !GetBE(p, end, 8, &entry.lastWrite)
+			|| !GetBE(p, end, 1, &type) || !GetBE(p, end, 4, &contentType)
+			|| !GetBE(p, end, 4, &titleId) || !GetBE(p, end, 4, &mediaId)
+			|| end - p < (long)sizeof(entry.header.contentId))
+			return false;
+		memcpy(entry.header.contentId, p, sizeof(entry.header.contentId));
+		p += sizeof(entry.header.contentId);
+		if (!GetBE(p, end, 8, &entry.header.dataSize) || !GetBE(p, end, 1, &nameLen) || nameLen > GOD_DISPLAY_NAME_CHARS)
+			return false;
+		entry.header.type = (GOD_TYPE)type;
+		entry.header.contentType = (DWORD)contentType;
+		entry.header.titleId = (DWORD)titleId;
+		entry.header.mediaId = (DWORD)mediaId;
+		for (unsigned long long c = 0; c < nameLen; c++)
+		{
+			unsigned long long ch;
+			if (!GetBE(p, end, 2, &ch))
+				return false;
+			entry.header.displayName[c] = (WCHAR)ch;
+		}
+		entries[path] = entry;
+	}
+
+	ScopedLock lock(m_lock);
+	m_entries.swap(entries);
+	m_dirty = false;
+	return true;
+}
+
+bool ScanIndex::Save(const char* file, const vector<string>& scannedRoots)
+{
+	ScopedLock lock(m_lock);
+
+	// Forget packages that have gone from a device we just walked
+	EntryMap::iterator it = m_entries.begin();
+	while (it != m_entries.end())
+	{
+		bool stale = false;
+		if (!it->second.seen)
+		{
+			for (unsigned int i = 0; i < scannedRoots.size(); i++)
+			{
+				if (it->first.compare(0, scannedRoots[i].length(), scannedRoots[i]) == 0)
+				{
+					stale = true;
+					break;
+				}
+			}
+		}
+		if (stale)
+		{
+			m_entries.erase(it++);
+			m_dirty = true;
+		}
+		else
+			++it;
+	}
+	if (!m_dirty)
+		return true;
+
+	vector<unsigned char> out;
+	PutBE(out, SCAN_INDEX_MAGIC, 4);
+	PutBE(out, SCAN_INDEX_VERSION, 4);
+	PutBE(out, m_entries.size(), 4);
+	for (it = m_entries.begin(); it != m_entries.end(); ++it)
+	{
+		const SCAN_INDEX_ENTRY& entry = it->second;
+		PutBE(out, it->first.length(), 2);
+		out.insert(out.end(), it->first.begin(), it->first.end());
+		PutBE(out, entry.size, 8);
+		PutBE(out, entry.lastWrite, 8);
+		PutBE(out, entry.header.type, 1);
+		PutBE(out, entry.header.contentType, 4);
+		PutBE(out, entry.header.titleId, 4);
+		PutBE(out, entry.header.mediaId, 4);
+		out.insert(out.end(), entry.header.contentId, entry.header.contentId + sizeof(entry.header.contentId));
+		PutBE(out, entry.header.dataSize, 8);
+		unsigned int nameLen = wcslen(entry.header.displayName);
+		PutBE(out, nameLen, 1);
+		for (unsigned int c = 0; c < nameLen; c++)
+			PutBE(out, entry.header.displayName[c], 2);
+	}
+
+	VfsFile* fd = VfsOpen(file, VFS_CREATE);
+	if (fd == NULL)
+		return false;
+	bool written = fd->Write(0, &out[0], out.size()) && fd->Flush();
+	delete fd;
+	if (written)
+		m_dirty = false;
+	return written;
+}
+
+bool ScanIndex::Lookup(const string& path, unsigned long long size, unsigned long long lastWrite, GOD_HEADER_INFO* header)
+{
+	ScopedLock lock(m_lock);
+	EntryMap::iterator it = m_entries.find(path);
+	if (it == m_entries.end() || it->second.size != size || it->second.lastWrite != lastWrite)
+	{
+		m_misses++;
+		return false;
+	}
+	it->second.seen = true;
+	*header = it->second.header;
+	m_hits++;
+	return true;
+}
+
+void ScanIndex::Update(const string& path, unsigned long long size, unsigned long long lastWrite, const GOD_HEADER_INFO& header)
+{
+	ScopedLock lock(m_lock);
+	SCAN_INDEX_ENTRY& entry = m_entries[path];
+	entry.size = size;
+	entry.lastWrite = lastWrite;
+	entry.header = header;
+	entry.seen = true;
+	m_dirty = true;
+}
@@ -0,0 +1,50 @@
+#ifndef INDEX_H
+#define INDEX_H
+#include <map>
+#include <string>
+#include <vector>
+#include "header.h"
+#include "thread.h"
+
+#define SCAN_INDEX_MAGIC	0x47494458	// GIDX
+#define SCAN_INDEX_VERSION	3
+
+struct SCAN_INDEX_ENTRY
+{
+	unsigned long long size;
+	unsigned long long lastWrite;
+	GOD_HEADER_INFO header;
+	bool seen;	// Listed during this run
+};
+
+// Remembers the classification of every header package by path, size and last
+// write time, so unchanged packages are never reopened on the next scan.
+// Lookups and updates are safe to call from several scan workers at once.
+class ScanIndex
+{
+public:
+	ScanIndex();
+
+	// A missing, truncated or out of date index just means a full scan
+	bool Load(const char* file);
+
+	// Only writes when something changed. Entries that weren't seen this run are
+	// dropped if they live under one of the scanned roots.
+	bool Save(const char* file, const std::vector<std::string>& scannedRoots);
+
+	// Returns true and fills header if path is indexed with the same size and time
+	bool Lookup(const std::string& path, unsigned long long size, unsigned long long lastWrite, GOD_HEADER_INFO* header);
+	void Update(const std::string& path, unsigned long long size, unsigned long long lastWrite, const GOD_HEADER_INFO& header);
+
+	unsigned int Hits() const { return m_hits; }
+	unsigned int Misses() const { return m_misses; }
+
+private:
+	typedef std::map<std::string, SCAN_INDEX_ENTRY> EntryMap;
+	EntryMap m_entries;
+	CriticalSection m_lock;
+	bool m_dirty;
+	unsigned int m_hits;
+	unsigned int m_misses;
+};
+#endif
@@ -0,0 +1,245 @@
+#include <string.h>
+#include "journal.h"
+#include "sha1.h"
+
+using std::string;
+using std::vector;
+
+#define JOURNAL_ENTRY_FIXED_SIZE	(6 + 2 * sizeof(PATCH_REGIONS))	// Title id and path length, then both region sets
+
+static void PutBE32(unsigned char* p, DWORD value)
+{
+	p[0] = (unsigned char)(value >> 24);
+	p[1] = (unsigned char)(value >> 16);
+	p[2] = (unsigned char)(value >> 8);
+	p[3] = (unsigned char)value;
+}
+
+static DWORD GetBE32(const unsigned char* p)
+{
+	return ((DWORD)p[0] << 24) | ((DWORD)p[1] << 16) | ((DWORD)p[2] << 8) | (DWORD)p[3];
+}
+
+// Parses a BEGIN payload, false if it doesn't hold what its count says
+static bool ParseEntries(const vector<unsigned char>& payload, vector<JOURNAL_ENTRY>& entries)
+{
+	if (payload.size() < 4)
+		return false;
+	DWORD count = GetBE32(&payload[0]);
+	unsigned int offset = 4;
+	for (DWORD i = 0; i < count; i++)
+	{
+		if (offset + JOURNAL_ENTRY_FIXED_SIZE > payload.size())
+			return false;
+		JOURNAL_ENTRY entry;
+		entry.titleId = GetBE32(&payload[offset]);
+		unsigned int pathLength = (payload[offset + 4] << 8) | payload[offset + 5];
+		offset += 6;
+		if (pathLength == 0 || pathLength >= MAX_PATH || offset + pathLength + 2 * sizeof(PATCH_REGIONS) > payload.size())
+			return false;
+		entry.path.assign((const char*)&payload[offset], pathLength);
+		offset += pathLength;
+		memcpy(&entry.original, &payload[offset], sizeof(PATCH_REGIONS));
+		offset += sizeof(PATCH_REGIONS);
+		memcpy(&entry.patched, &payload[offset], sizeof(PATCH_REGIONS));
+		offset += sizeof(PATCH_REGIONS);
+		entries.push_back(entry);
+	}
+	return offset == payload.size();
+}
+
+PatchJournal::PatchJournal() : m_file(NULL), m_size(0), m_sequence(1)
+{
+}
+
+PatchJournal::~PatchJournal()
+{
+	Close();
+}
+
+bool PatchJournal::Open(const char* file)
+{
+	Close();
+	m_file = VfsOpen(file, VFS_OPEN_ALWAYS);
+	if (m_file == NULL)
+		return false;
+	m_path = file;
+	unsigned long long fileSize = m_file->Size();
+
+	// Groups still waiting for their COMMIT, in the order they began
+	vector<DWORD> sequences;
+	vector<vector<JOURNAL_ENTRY> > groups;
+	for (;;)
+	{
+		unsigned char header[JOURNAL_RECORD_HEADER_SIZE];
+		if (!VfsReadExact(m_file, m_size, header, sizeof(header)))
+			break;
+		DWORD magic = GetBE32(header);
+		DWORD sequence = GetBE32(header + 4);
+		DWORD payloadSize = GetBE32(header + 8);
+
+		if (magic == JOURNAL_COMMIT_MAGIC && payloadSize == 0)
+		{
+			for (unsigned int i = 0; i < sequences.size(); i++)
+			{
+				if (sequences[i] == sequence)
+				{
+					sequences.erase(sequences.begin() + i);
+					groups.erase(groups.begin() + i);
+					break;
+				}
+			}
+		}
+		else if (magic == JOURNAL_BEGIN_MAGIC)
+		{
+			// Only trust a BEGIN whose payload made it to disk completely
+			long end = m_size + JOURNAL_RECORD_HEADER_SIZE + payloadSize;
+			if (payloadSize == 0 || (unsigned long long)end > fileSize)
+				break;
+			vector<unsigned char> payload(payloadSize);
+			if (!VfsReadExact(m_file, m_size + JOURNAL_RECORD_HEADER_SIZE, &payload[0], payloadSize))
+				break;
+			unsigned char hash[SHA1_DIGEST_SIZE];
+			Sha1(&payload[0], payloadSize, hash);
+			vector<JOURNAL_ENTRY> entries;
+			if (memcmp(hash, header + 12, sizeof(hash)) != 0 || !ParseEntries(payload, entries))
+				break;
+			sequences.push_back(sequence);
+			groups.push_back(entries);
+		}
+		else
+			break;
+
+		m_size += JOURNAL_RECORD_HEADER_SIZE + payloadSize;
+		if (sequence >= m_sequence)
+			m_sequence = sequence + 1;
+	}
+
+	for (unsigned int i = 0; i < groups.size(); i++)
+		m_pending.insert(m_pending.end(), groups[i].begin(), groups[i].end());
+	return true;
+}
+
+void PatchJournal::Close()
+{
+	if (m_file)
+	{
+		m_file->Flush();
+		delete m_file;
+		m_file = NULL;
+	}
+	m_size = 0;
+	m_pending.clear();
+}
+
+bool PatchJournal::Begin(const vector<JOURNAL_ENTRY>& entries, DWORD* sequence)
+{
+	if (m_file == NULL || entries.empty())
+		return false;
+
+	vector<unsigned char> record(JOURNAL_RECORD_HEADER_SIZE + 4);
+	PutBE32(&record[JOURNAL_RECORD_HEADER_SIZE], entries.size());
+	for (unsigned int i = 0; i < entries.size(); i++)
+	{
+		const JOURNAL_ENTRY& entry = entries[i];
+		unsigned int pathLength = entry.path.length();
+		if (pathLength == 0 || pathLength >= MAX_PATH)
+			return false;
+		unsigned int offset = record.size();
+		record.resize(offset + JOURNAL_ENTRY_FIXED_SIZE + pathLength);
+		unsigned char* p = &record[offset];
+		PutBE32(p, entry.titleId);
+		p[4] = (unsigned char)(pathLength >> 8);
+		p[5] = (unsigned char)pathLength;
+		memcpy(p + 6, entry.path.c_str(), pathLength);
+		memcpy(p + 6 + pathLength, &entry.original, sizeof(PATCH_REGIONS));
+		memcpy(p + 6 + pathLength + sizeof(PATCH_REGIONS), &entry.patched, sizeof(PATCH_REGIONS));
+	}
+
+	DWORD payloadSize = record.size() - JOURNAL_RECORD_HEADER_SIZE;
+	unsigned char* header = &record[0];
+	memset(header, 0, JOURNAL_RECORD_HEADER_SIZE);
+	PutBE32(header, JOURNAL_BEGIN_MAGIC);
+	PutBE32(header + 4, m_sequence);
+	PutBE32(header + 8, payloadSize);
+	Sha1(&record[JOURNAL_RECORD_HEADER_SIZE], payloadSize, header + 12);
+
+	// One sequential append for the whole group, on disk before any package is written
+	if (!m_file->Write(m_size, &record[0], record.size()) || !m_file->Flush())
+		return false;
+
+	m_size += record.size();
+	*sequence = m_sequence++;
+	return true;
+}
+
+bool PatchJournal::Commit(DWORD sequence)
+{
+	if (m_file == NULL)
+		return false;
+	unsigned char header[JOURNAL_RECORD_HEADER_SIZE];
+	memset(header, 0, sizeof(header));
+	PutBE32(header, JOURNAL_COMMIT_MAGIC);
+	PutBE32(header + 4, sequence);
+	if (!m_file->Write(m_size, header, sizeof(header)))
+		return false;
+	m_size += sizeof(header);
+	return true;
+}
+
+bool PatchJournal::Recover(const string& deviceRoot, BackupArchive* archive, JOURNAL_RECOVERY* report)
+{
+	memset(report, 0, sizeof(JOURNAL_RECOVERY));
+	if (m_file == NULL)
+		return false;
+
+	for (unsigned int i = 0; i < m_pending.size(); i++)
+	{
+		const JOURNAL_ENTRY& entry = m_pending[i];
+		string file = deviceRoot + entry.path;
+		PATCH_REGIONS current;
+		if (ReadHeaderRegions(file.c_str(), &current) != PATCH_OK)
+		{
+			report->failed++;
+			continue;
+		}
+
+		if (memcmp(&current, &entry.patched, sizeof(current)) == 0)
+		{
+			// The patch landed but its backup record may not have. A package that
+			// was already unlocked when journaled has no original worth keeping.
+			if (IsUnlockedRegions(entry.original))
+				report->completed++;
+			else if (archive && !archive->Append(entry.titleId, entry.path.c_str(), entry.original, false))
+				report->failed++;
+			else
+				report->completed++;
+		}
+		else if (memcmp(&current, &entry.original, sizeof(current)) == 0)
+			report->untouched++;
+		else
+		{
+			// Part of the patch reached the disk. The original is in the journal
+			// itself, so going back never depends on the backup archive.
+			PATCH_REGIONS verify;
+			if (WriteHeaderRegions(file.c_str(), entry.original, &verify) == PATCH_OK
+				&& memcmp(&verify, &entry.original, sizeof(verify)) == 0)
+				report->rolledBack++;
+			else
+				report->failed++;
+		}
+	}
+	if (archive && !m_pending.empty() && !archive->Flush())
+		return false;
+
+	// Anything that couldn't be settled stays in the journal for the next start
+	if (report->failed > 0)
+		return false;
+	if (m_size == 0 && m_file->Size() == 0)
+		return true;
+	delete m_file;
+	m_file = VfsOpen(m_path.c_str(), VFS_CREATE);
+	m_size = 0;
+	m_pending.clear();
+	return m_file != NULL;
+}
@@ -0,0 +1,74 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include <string>
+#include <vector>
+#include "backup.h"
+#include "patch.h"
+#include "vfs.h"
+
+#define JOURNAL_FILE_NAME			"godjournal.bin"
+#define JOURNAL_BEGIN_MAGIC			0x474A4E42	// GJNB
+#define JOURNAL_COMMIT_MAGIC		0x474A4E43	// GJNC
+#define JOURNAL_RECORD_HEADER_SIZE	32
+
+// One header patch as the journal records it before the package is touched
+struct JOURNAL_ENTRY
+{
+	DWORD titleId;
+	std::string path;		// Package path relative to the device root
+	PATCH_REGIONS original;
+	PATCH_REGIONS patched;
+};
+
+struct JOURNAL_RECOVERY
+{
+	unsigned int completed;		// Patched before the crash; the backup record is made sure of
+	unsigned int rolledBack;	// Torn headers put back to their original bytes
+	unsigned int untouched;		// Never written
+	unsigned int failed;		// Couldn't be read or put back
+};
+
+// Write-ahead log for header patches, one per device beside its backup archive.
+// A group of patches is recorded as one BEGIN record (magic, sequence, payload
+// size, SHA-1 of the payload, then the path, original and new regions of every
+// package), flushed before any package is written. Once the group's packages and
+// backup records are down a 32 byte COMMIT record for the same sequence follows.
+// A BEGIN without its COMMIT is a group that was cut short.
+class PatchJournal
+{
+public:
+	PatchJournal();
+	~PatchJournal();
+
+	// Opens or creates the journal and collects the groups never committed. A
+	// torn record at the end was never acted on and is overwritten by the next append.
+	bool Open(const char* file);
+	void Close();
+	bool IsOpen() const { return m_file != NULL; }
+
+	// Appends and flushes the intent for a group of patches
+	bool Begin(const std::vector<JOURNAL_ENTRY>& entries, DWORD* sequence);
+
+	// Marks a group done. Not flushed: a lost commit only means the group is
+	// checked again by the next Recover, which finds it complete.
+	bool Commit(DWORD sequence);
+
+	unsigned int PendingCount() const { return m_pending.size(); }
+
+	// Settles every entry of the uncommitted groups against what is on disk under
+	// deviceRoot, then empties the journal. A package holding the new bytes is
+	// kept and its original re-appended to archive (a no-op when the record made
+	// it); one holding anything but the original or new bytes is rolled back.
+	bool Recover(const std::string& deviceRoot, BackupArchive* archive, JOURNAL_RECOVERY* report);
+
+private:
+	VfsFile* m_file;
+	std::string m_path;
+	long m_size;		// End of the last complete record
+	DWORD m_sequence;	// Next BEGIN
+	std::vector<JOURNAL_ENTRY> m_pending;
+
+	PatchJournal(const PatchJournal&);
+	PatchJournal& operator=(const PatchJournal&);
+};
+#endif
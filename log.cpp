@@ -0,0 +1,138 @@
+#include <stdarg.h>
+#include <string.h>
+#include <vector>
+#include "log.h"
+#include "thread.h"
+#include "vfs.h"
+#ifdef _XBOX
+#include "AtgLockFreePipe.h"
+#endif
+
+#ifdef _XBOX
+// LockFreePipe allows one reader and one writer, so writers take turns through
+// the lock (uncontended it costs next to nothing) and the flush thread reads.
+static ATG::LockFreePipe<LOG_PIPE_SIZE_LOG2> LogPipe;
+#else
+// The ATG pipe is console only. Host builds queue finished lines in a buffer
+// under the same lock and the flush thread swaps it out.
+static std::vector<char> LogPending;
+#endif
+static CriticalSection LogWriteLock;
+static VfsFile* LogFile = NULL;
+static unsigned long long LogOffset = 0;
+static THREAD_HANDLE LogThread;
+static volatile bool LogRunning = false;
+
+// Moves every complete record in the pipe into one buffer and writes it with a
+// single call. Returns false if the pipe was empty.
+static bool FlushDebugLog()
+{
+#ifdef _XBOX
+	static char batch[1 << LOG_PIPE_SIZE_LOG2];
+	unsigned long used = 0;
+	WORD length;
+	while (LogPipe.BytesAvailable() >= sizeof(length) && used + LOG_RECORD_MAX + 2 <= sizeof(batch))
+	{
+		// Records are written in one piece so the text is always there with its length
+		if (!LogPipe.Read(&length, sizeof(length)) || !LogPipe.Read(batch + used, length))
+			break;
+		used += length;
+		batch[used++] = '\r';
+		batch[used++] = '\n';
+	}
+#else
+	static std::vector<char> pending;
+	{
+		ScopedLock lock(LogWriteLock);
+		pending.swap(LogPending);
+	}
+	const char* batch = pending.empty() ? NULL : &pending[0];
+	unsigned long used = pending.size();
+#endif
+	if (used == 0)
+		return false;
+	bool written = LogFile->Write(LogOffset, batch, used);
+#ifndef _XBOX
+	// Only now that the batch is written can its buffer be reused
+	pending.clear();
+#endif
+	// A failed write drops the batch, the next one goes where it would have
+	if (written)
+		LogOffset += used;
+	return true;
+}
+
+static void DebugLogThread(void* /*param*/)
+{
+	while (LogRunning)
+	{
+		if (!FlushDebugLog())
+			SleepFor(LOG_FLUSH_INTERVAL);
+	}
+}
+
+bool StartDebugLog(const char* file)
+{
+	if (LogFile)
+		return true;
+	LogFile = VfsOpen(file, VFS_OPEN_ALWAYS);
+	if (LogFile == NULL)
+		return false;
+	LogOffset = LogFile->Size();
+	LogRunning = true;
+	if (!StartThread(DebugLogThread, NULL, &LogThread))
+	{
+		LogRunning = false;
+		delete LogFile;
+		LogFile = NULL;
+		return false;
+	}
+	return true;
+}
+
+void StopDebugLog()
+{
+	if (LogFile == NULL)
+		return;
+	LogRunning = false;
+	JoinThread(LogThread);
+	while (FlushDebugLog())
+		;
+	LogFile->Flush();
+	delete LogFile;
+	LogFile = NULL;
+}
+
+void debugLog(const char* format, ...)
+{
+	if (LogFile == NULL)
+		return;
+
+	// Length prefix followed by the text, pushed with one Write
+	char record[sizeof(WORD) + LOG_RECORD_MAX];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf_s(record + sizeof(WORD), LOG_RECORD_MAX, _TRUNCATE, format, args);
+	va_end(args);
+	if (length < 0)
+		length = strlen(record + sizeof(WORD));
+
+#ifdef _XBOX
+	WORD prefix = (WORD)length;
+	memcpy(record, &prefix, sizeof(prefix));
+
+	ScopedLock lock(LogWriteLock);
+	while (!LogPipe.Write(record, sizeof(WORD) + length))
+	{
+		// Pipe is full, give the flush thread a chance to drain it
+		if (!LogRunning)
+			return;
+		SleepFor(0);
+	}
+#else
+	ScopedLock lock(LogWriteLock);
+	LogPending.insert(LogPending.end(), record + sizeof(WORD), record + sizeof(WORD) + length);
+	LogPending.push_back('\r');
+	LogPending.push_back('\n');
+#endif
+}
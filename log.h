@@ -0,0 +1,19 @@
+#ifndef LOG_H
+#define LOG_H
+
+#define LOG_RECORD_MAX		512		// Longer lines are truncated
+#define LOG_PIPE_SIZE_LOG2	16		// 64 KB of records in flight
+#define LOG_FLUSH_INTERVAL	50		// ms the flush thread sleeps when the pipe is empty
+
+// Opens the log once (appending, creating it if needed) and starts the thread
+// that batches records from the pipe into it.
+bool StartDebugLog(const char* file);
+
+// Drains everything still in the pipe and closes the log. Must be called before
+// leaving the application or the last records are lost.
+void StopDebugLog();
+
+// Formats into a fixed buffer on the caller's stack and pushes the record into
+// the pipe. Never touches the file system. Safe to call from any thread.
+void debugLog(const char* format, ...);
+#endif
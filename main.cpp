@@ -7,12 +7,26 @@
 #include <sstream>
 #include <iostream>
 #include <fstream>
-#include <sys/stat.h> 
 #include "xfilecache.h"
 #include <string>
 #include "xbox.h"
 #include <vector>
 #include "mount.h"
+#include "patch.h"
+#include "header.h"
+#include "catalog.h"
+#include "rules.h"
+#include "backup.h"
+#include "journal.h"
+#include "log.h"
+#include "index.h"
+#include "scan.h"
+#include "thread.h"
+#include "verify.h"
+#include "convert.h"
+#include "extract.h"
+#include "titlelist.h"
+#include "unlock.h"
 
 using std::vector;
 using std::string;
@@ -20,459 +34,540 @@ using std::ifstream;
 using std::ofstream;
 using std::fstream;
 
-//class GOD {
-class GOD {
-private:
-	void readTitle() 
-	{
-		string fullPath = path + fileName;
-		ifstream file;
-		file.open ((char*)fullPath.c_str(), ifstream::in);
-		if (file.is_open())
-		{
-			char buffer[_MAX_PATH];
-			file.seekg(0x00000411);
-			file.read(buffer,_MAX_PATH);
-			swprintf_s(title, _MAX_PATH, L"%s", buffer);
-			file.close();
-		}
-	}
-public:
-		string fileName;
-		string path;
-		wchar_t title[_MAX_PATH];
-		//NXE (string, string);
-		GOD(string, string);
-		bool status;	
-};
-
 string filePathzzz = "\\Content\\0000000000000000"; // Byrom - Temp change to dummy directory
 //string filePathzzz = "\\Dummy-GOD-Content";
+const char* IndexFile = "game:\\godindex.bin";
+const char* RulesFile = "game:\\godrules.txt";
+const char* CheckpointFile = "game:\\godverify.bin";
+const char* ISOFolder = "game:\\ISO";
 int fileCount = 0;
 ATG::Console console;
-bool debuglogexists = false;
 
-extern "C" VOID XeCryptSha(LPVOID DataBuffer1, UINT DataSize1, LPVOID DataBuffer2, UINT DataSize2, LPVOID DataBuffer3, UINT DataSize3, LPVOID DigestBuffer, UINT DigestSize);
+vector<NXE> allNXE;
+Catalog catalog;
+TitleList titleList(catalog);
+RuleTable rules;
+vector<string> devices;
+vector<BackupArchive*> backups;
+vector<PatchJournal*> journals;
 
-//GOD::GOD (string strFileName, string strPath) {
-GOD::GOD(string strFileName, string strPath) {
-	fileName = strFileName;
-	path = strPath;
-	readTitle();
-	status = true;
+// Flush the log before handing control back, nothing is written after this
+void ExitToDashboard()
+{
+	StopDebugLog();
+	XLaunchNewImage(XLAUNCH_KEYWORD_DEFAULT_APP, 0);
 }
 
-//vector<NXE> allNXE;
-vector<GOD> allGODRegular;
-vector<GOD> allGODMSPSpoofed;
-vector<GOD> allGODBundle;
-vector<GOD> allGODUnlocked;
-vector<string> devices;
+bool SkipDuplicates = false; // Only the canonical copy of a package found on several devices is worked on
+int KeepDevice = 0; // Device whose copies are canonical
 
-int DeleteDirectory(const std::string &refcstrRootDirectory, bool bDeleteSubdirectories = true)
+// One backup archive per device, opened the first time a title on it is unlocked
+BackupArchive* GetBackupArchive(int device)
 {
-  bool            bSubdirectory = false;       // Flag, indicating whether
-                                               // subdirectories have been found
-  HANDLE          hFile;                       // Handle to directory
-  std::string     strFilePath;                 // Filepath
-  std::string     strPattern;                  // Pattern
-  WIN32_FIND_DATA FileInformation;             // File information
-
-
-  strPattern = refcstrRootDirectory + "\\*.*";
-  hFile = ::FindFirstFile(strPattern.c_str(), &FileInformation);
-  if(hFile != INVALID_HANDLE_VALUE)
-  {
-    do
-    {
-      if(FileInformation.cFileName[0] != '.')
-      {
-        strFilePath = refcstrRootDirectory + "\\" + FileInformation.cFileName;
-
-        if(FileInformation.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-        {
-          if(bDeleteSubdirectories)
-          {
-            // Delete subdirectory
-            int iRC = DeleteDirectory(strFilePath, bDeleteSubdirectories);
-            if(iRC)
-              return iRC;
-          }
-          else
-            bSubdirectory = true;
-        }
-        else
-        {
-          // Set file attributes
-          if(::SetFileAttributes(strFilePath.c_str(), FILE_ATTRIBUTE_NORMAL) == FALSE)
-            return ::GetLastError();
-
-          // Delete file
-          if(::DeleteFile(strFilePath.c_str()) == FALSE)
-			  return ::GetLastError();
-        }
-      }
-    } while(::FindNextFile(hFile, &FileInformation) == TRUE);
-
-    // Close handle
-    ::FindClose(hFile);
-
-    DWORD dwError = ::GetLastError();
-    if(dwError != ERROR_NO_MORE_FILES)
-      return dwError;
-    else
-    {
-      if(!bSubdirectory)
-      {
-        // Set directory attributes
-        if(::SetFileAttributes(refcstrRootDirectory.c_str(), FILE_ATTRIBUTE_NORMAL) == FALSE)
-          return ::GetLastError();
-
-        // Delete directory
-        if(::RemoveDirectory(refcstrRootDirectory.c_str()) == FALSE)
-          return ::GetLastError();
-      }
-    }
-  }
-  return 0;
+	if (backups.size() < devices.size())
+		backups.resize(devices.size(), NULL);
+	if (backups[device] == NULL)
+	{
+		backups[device] = new BackupArchive;
+		string archiveFile = devices[device] + "\\" + BACKUP_ARCHIVE_NAME;
+		if (!backups[device]->Open(archiveFile.c_str()))
+		{
+			debugLog("Unable to open backup archive at: %s", archiveFile.c_str());
+		}
+	}
+	return backups[device];
 }
 
-bool FileExists(const char* strFilename) 
+// One patch journal per device beside its backup archive
+PatchJournal* GetJournal(int device)
 {
-  struct stat tmp;
-  if(stat(strFilename, &tmp) == 0)
-    return true;
-  return false;
+	if (journals.size() < devices.size())
+		journals.resize(devices.size(), NULL);
+	if (journals[device] == NULL)
+	{
+		journals[device] = new PatchJournal;
+		string journalFile = devices[device] + "\\" + JOURNAL_FILE_NAME;
+		if (!journals[device]->Open(journalFile.c_str()))
+		{
+			debugLog("Unable to open patch journal at: %s", journalFile.c_str());
+		}
+	}
+	return journals[device];
 }
 
-void debugLog(char* output)
+// Settles unlocks cut short by a crash or power loss, before the scan reads any header
+void RecoverJournals()
 {
-	FILE* fd;
-	if (fopen_s(&fd, "game:\\debug.log", "ab") == 0)
+	for (unsigned int i = 0; i < devices.size(); i++)
 	{
-		fwrite(output, strlen(output), 1, fd);
-		fprintf(fd, "\r\n");
-		fclose(fd);
+		// Also empties a journal whose groups all committed
+		PatchJournal* journal = GetJournal(i);
+		unsigned int pending = journal->PendingCount();
+		JOURNAL_RECOVERY report;
+		journal->Recover(devices[i], GetBackupArchive(i), &report);
+		if (pending == 0)
+			continue;
+		console.Format("%s: Recovered %u interrupted unlocks (%u completed, %u rolled back)\n", devices[i].c_str(),
+			report.completed + report.rolledBack, report.completed, report.rolledBack);
+		if (report.failed)
+			console.Format("%s: %u could not be recovered, they will be retried next time\n", devices[i].c_str(), report.failed);
+		debugLog("Journal recovery on %s: %u completed, %u rolled back, %u untouched, %u failed", devices[i].c_str(),
+			report.completed, report.rolledBack, report.untouched, report.failed);
 	}
 }
 
-void genlog()
+// Queues a title on the executor. The archive only keeps the header bytes the
+// patch overwrites, keyed by the path relative to the device so it survives the
+// device being renumbered. Bundles get their license wiped rather than set.
+// Titles unlocked earlier in the session are skipped, patching them again would
+// back up the unlocked header over the original.
+void AddUnlockJob(UnlockExecutor& executor, unsigned int index)
 {
-	if (FileExists("game:\\debug.log"))
+	if (catalog.Entry(index).status == CATALOG_STATUS_UNLOCKED)
 		return;
-	FILE* fd;
-	if (fopen_s(&fd, "game:\\debug.log", "w") == 0)
-		fclose(fd);
+	UNLOCK_JOB job;
+	job.index = index;
+	job.device = catalog.Entry(index).device;
+	job.path = catalog.FullPath(index);
+	job.rootLength = devices[job.device].length();
+	job.titleId = catalog.Entry(index).titleId;
+	job.setLicense = catalog.Entry(index).type != GOD_TYPE_BUNDLE;
+	job.archive = GetBackupArchive(job.device);
+	job.journal = GetJournal(job.device);
+	executor.Add(job);
 }
 
-unsigned char HeaderMain[] = {
-	0x4C, 0x49, 0x56, 0x45, 0x42, 0x79, 0x72, 0x6F, 0x6D, 0x57,
-	0x61, 0x73, 0x48, 0x65, 0x72, 0x65, 0x55, 0x6E, 0x6C, 0x6F,
-	0x63, 0x6B, 0x69, 0x6E, 0x67, 0x59, 0x6F, 0x75, 0x72, 0x47,
-	0x4F, 0x44, 0x47, 0x61, 0x6D, 0x65, 0x42, 0x79, 0x72, 0x6F,
-	0x6D, 0x57, 0x61, 0x73, 0x48, 0x65, 0x72, 0x65, 0x55, 0x6E,
-	0x6C, 0x6F, 0x63, 0x6B, 0x69, 0x6E, 0x67, 0x59, 0x6F, 0x75,
-	0x72, 0x47, 0x4F, 0x44, 0x47, 0x61, 0x6D, 0x65, 0x42, 0x79,
-	0x72, 0x6F, 0x6D, 0x57, 0x61, 0x73, 0x48, 0x65, 0x72, 0x65,
-	0x55, 0x6E, 0x6C, 0x6F, 0x63, 0x6B, 0x69, 0x6E, 0x67, 0x59,
-	0x6F, 0x75, 0x72, 0x47, 0x4F, 0x44, 0x47, 0x61, 0x6D, 0x65,
-	0x42, 0x79, 0x72, 0x6F, 0x6D, 0x57, 0x61, 0x73, 0x48, 0x65,
-	0x72, 0x65, 0x55, 0x6E, 0x6C, 0x6F, 0x63, 0x6B, 0x69, 0x6E,
-	0x67, 0x59, 0x6F, 0x75, 0x72, 0x47, 0x4F, 0x44, 0x47, 0x61,
-	0x6D, 0x65, 0x42, 0x79, 0x72, 0x6F, 0x6D, 0x57, 0x61, 0x73,
-	0x48, 0x65, 0x72, 0x65, 0x55, 0x6E, 0x6C, 0x6F, 0x63, 0x6B,
-	0x69, 0x6E, 0x67, 0x59, 0x6F, 0x75, 0x72, 0x47, 0x4F, 0x44,
-	0x47, 0x61, 0x6D, 0x65, 0x42, 0x79, 0x72, 0x6F, 0x6D, 0x57,
-	0x61, 0x73, 0x48, 0x65, 0x72, 0x65, 0x55, 0x6E, 0x6C, 0x6F,
-	0x63, 0x6B, 0x69, 0x6E, 0x67, 0x59, 0x6F, 0x75, 0x72, 0x47,
-	0x4F, 0x44, 0x47, 0x61, 0x6D, 0x65, 0x42, 0x79, 0x72, 0x6F,
-	0x6D, 0x57, 0x61, 0x73, 0x48, 0x65, 0x72, 0x65, 0x55, 0x6E,
-	0x6C, 0x6F, 0x63, 0x6B, 0x69, 0x6E, 0x67, 0x59, 0x6F, 0x75,
-	0x72, 0x47, 0x4F, 0x44, 0x47, 0x61, 0x6D, 0x65, 0x42, 0x79,
-	0x72, 0x6F, 0x6D, 0x57, 0x61, 0x73, 0x48, 0x65, 0x72, 0x65,
-	0x55, 0x6E, 0x6C, 0x6F, 0x63, 0x6B, 0x69, 0x6E, 0x67, 0x59,
-	0x6F, 0x75, 0x72, 0x47, 0x4F, 0x44, 0x47, 0x61, 0x6D, 0x65
-};
-
-unsigned char LicenseInfo[] = {
-0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00,
-0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0xFF, 0xFF, 0xFF, 0xFF,
-0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x01
-};
-
-bool DoNotSetLicense = false; // Enable when unlocking bundles
-
-bool UnlockMe(const char* file)
+// Runs on the UI thread as each title finishes, whichever device it was on
+void OnUnlocked(const UNLOCK_RESULT& result, unsigned int done, unsigned int total, void* context)
 {
-	unsigned char* buffer;
-	int size = 0;
-	FILE* fd;
-	if (fopen_s(&fd, file, "rb") == 0)
+	unsigned int index = result.index;
+	switch (result.result)
 	{
-		fseek(fd, 0, SEEK_END);
-		size = ftell(fd);
-		buffer = new unsigned char[size];
-		fseek(fd, 0, SEEK_SET);
-		if (fread(buffer, size, 1, fd) == 0)
-		{
-			fclose(fd);
-			console.Format("Failed 1\n");
-			return false;
-		}
-		fclose(fd);
+	case PATCH_OK:
+		catalog.SetStatus(index, CATALOG_STATUS_UNLOCKED);
+		console.Format("[%u/%u] Unlocked %ls\n", done, total, catalog.Title(index));
+		debugLog("Unlocked: %s (%lu ms)", catalog.Path(index).c_str(), result.elapsedMs);
+		return;
+	case PATCH_ALREADY_UNLOCKED:
+		catalog.SetStatus(index, CATALOG_STATUS_UNLOCKED);
+		console.Format("[%u/%u] %ls is already unlocked\n", done, total, catalog.Title(index));
+		return;
+	case PATCH_BACKUP_FAILED:
+		console.Format("[%u/%u] FAILED %ls: could not back up the original header, left untouched\n", done, total, catalog.Title(index));
+		break;
+	default:
+		console.Format("[%u/%u] FAILED %ls (%d)\n", done, total, catalog.Title(index), result.result);
+		break;
 	}
-	else
+	catalog.SetStatus(index, CATALOG_STATUS_FAILED);
+	debugLog("Unlock failed (%d): %s", result.result, catalog.FullPath(index).c_str());
+}
+
+void RunUnlocks(UnlockExecutor& executor)
+{
+	unsigned int total = executor.Count();
+	unsigned long start = TickCount();
+	unsigned int failed = executor.Run(OnUnlocked, NULL);
+	console.Format("%u unlocked, %u failed\n", total - failed, failed);
+	debugLog("Unlocked %u titles in %lu ms, %u failed", total - failed, TickCount() - start, failed);
+}
+
+void RestoreGOD(unsigned int index)
+{
+	console.Format("Restoring %ls...\n", catalog.Title(index));
+
+	int device = catalog.Entry(index).device;
+	string godFile = catalog.FullPath(index);
+	BackupArchive* archive = GetBackupArchive(device);
+	const BACKUP_ENTRY* entry = archive->Find(godFile.c_str() + devices[device].length());
+	RESTORE_RESULT result = entry ? RestoreHeader(*archive, *entry, devices[device]) : RESTORE_NO_BACKUP;
+	switch (result)
 	{
-		console.Format("Failed 2\n");
-		return false;
+	case RESTORE_OK:
+		catalog.SetStatus(index, CATALOG_STATUS_RESTORED);
+		debugLog("Restored: %s", godFile.c_str());
+		console.Format("Success!\n");
+		return;
+	case RESTORE_NO_BACKUP:
+		console.Format("No backup found for this title\n");
+		break;
+	case RESTORE_BAD_BACKUP:
+		console.Format("Backup is corrupted, original left untouched\n");
+		break;
+	case RESTORE_WRITE_FAILED:
+		console.Format("Failed to write original header\n");
+		break;
+	case RESTORE_VERIFY_FAILED:
+		console.Format("Restored header failed verification\n");
+		break;
 	}
+	debugLog("Unable to restore original header at: %s", godFile.c_str());
+	catalog.SetStatus(index, CATALOG_STATUS_FAILED);
+}
+
+void RestoreGODs(GOD_TYPE type)
+{
+	const CatalogView& view = catalog.View(type);
+	for (unsigned int i = 0; i < view.size(); i++)
+		RestoreGOD(view[i]);
+}
 
-	if (size < 0x413)
+void AddUnlockJobs(UnlockExecutor& executor, GOD_TYPE type)
+{
+	const CatalogView& view = catalog.View(type);
+	for (unsigned int i = 0; i < view.size(); i++)
+	{
+		if (!SkipDuplicates || !catalog.IsDuplicate(view[i]))
+			AddUnlockJob(executor, view[i]);
+	}
+}
+
+void VerifyGODData(unsigned int index, VerifyCheckpoints* checkpoints)
+{
+	console.Format("Verifying %ls...\n", catalog.Title(index));
+
+	string godFile = catalog.FullPath(index);
+	VERIFY_REPORT report;
+	switch (VerifyGOD(godFile.c_str(), CpuCount(), &report, checkpoints))
 	{
-		console.Format("Failed 3\n");
-		return false;
+	case VERIFY_OK:
+		if (report.partsSkipped)
+			console.Format("OK (%u MB/s, %u parts unchanged)\n", report.MBps(), report.partsSkipped);
+		else
+			console.Format("OK (%u MB/s)\n", report.MBps());
+		debugLog("Verified: %s (%llu bytes in %lu ms, %u parts skipped)", godFile.c_str(), report.bytes, report.elapsedMs, report.partsSkipped);
+		return;
+	case VERIFY_BAD_HEADER:
+		console.Format("Not an SVOD package\n");
+		break;
+	case VERIFY_UNSUPPORTED:
+		console.Format("Data doesn't start at block 0, not supported\n");
+		break;
+	case VERIFY_MISSING_PART:
+		console.Format("Data%04u is missing or the wrong size\n", report.part);
+		break;
+	case VERIFY_READ_FAILED:
+		console.Format("Read failed in Data%04u\n", report.part);
+		break;
+	case VERIFY_HASH_MISMATCH:
+		if (report.block == VERIFY_HASH_BLOCK)
+			console.Format("CORRUPT: hash block in Data%04u at 0x%llX\n", report.part, report.offset);
+		else
+			console.Format("CORRUPT: block %u in Data%04u at 0x%llX\n", report.block, report.part, report.offset);
+		break;
 	}
-	// Add LIVE file header and custom package signature
-	int i;
-	for (i = 0x0; i < sizeof(HeaderMain); i++)
+	debugLog("Verify failed (%d): %s part %u offset 0x%llX", report.result, godFile.c_str(), report.part, report.offset);
+}
+
+void VerifyAllGODs()
+{
+	// Parts that verified on an earlier run are skipped while they are unchanged
+	VerifyCheckpoints checkpoints;
+	if (!checkpoints.Open(CheckpointFile))
+		debugLog("Unable to open %s, verifying without checkpoints", CheckpointFile);
+	for (unsigned int i = 0; i < catalog.Count(); i++)
 	{
-		buffer[i] = HeaderMain[i];
+		if (!SkipDuplicates || !catalog.IsDuplicate(i))
+			VerifyGODData(i, &checkpoints);
 	}
-	// Wipe the license section completely
-	for (i = 0x22C; i < 0x32C; i++)
+}
+
+// Converts every .iso in ISOFolder to a GOD package on the first device
+void ConvertISOs()
+{
+	vector<VFS_ENTRY> entries;
+	if (devices.empty() || !VfsList(ISOFolder, entries))
 	{
-		buffer[i] = 0x0;
+		console.Format("No disc images found in %s\n", ISOFolder);
+		return;
 	}
-	// Add our license info
-	if (!DoNotSetLicense)
+	for (unsigned int i = 0; i < entries.size(); i++)
 	{
-		int bytecounter = 0;
-		for (i = 0x22C; i < (0x22C + sizeof(LicenseInfo)); i++)
+		const string& name = entries[i].name;
+		if (entries[i].directory || name.length() < 4 || _stricmp(name.c_str() + name.length() - 4, ".iso") != 0)
+			continue;
+		console.Format("Converting %s...\n", name.c_str());
+		string isoPath = string(ISOFolder) + "\\" + name;
+		CONVERT_REPORT report;
+		CONVERT_RESULT result = ConvertISO(isoPath.c_str(), (devices[0] + filePathzzz).c_str(), NULL, true, true, CpuCount(), &report);
+		if (result == CONVERT_OK)
 		{
-			buffer[i] = LicenseInfo[bytecounter];
-			bytecounter++;
+			console.Format("OK, %u parts (%u MB/s, %llu MB trimmed)\n", report.parts, report.MBps(), report.bytesSaved >> 20);
+			debugLog("Converted: %s to %s (%llu bytes in %lu ms)", isoPath.c_str(), report.headerPath.c_str(), report.bytesWritten, report.elapsedMs);
+		}
+		else if (result == CONVERT_EXISTS)
+			console.Format("Already installed at %s, skipped\n", report.headerPath.c_str());
+		else
+		{
+			console.Format("FAILED (%d)\n", result);
+			debugLog("Convert failed (%d): %s", result, isoPath.c_str());
 		}
 	}
-	// Open the original file and write our new header data
-	if (fopen_s(&fd, file, "wb") == 0)
-	{
-		fwrite(buffer, size, 1, fd);
-		fclose(fd);
-		return true;
-	}
-	console.Format("Failed 4\n");
-	return false;
 }
 
-void UnlockGOD(GOD godGame)
+// Repackages every NXE install found as a GOD package beside it on the same device
+void ConvertNXEInstalls()
 {
-	console.Format("Unlocking %ls...\n", godGame.title);
-
-	string goddirectory = godGame.path;
-
-	string godFile = godGame.path + godGame.fileName;
-
-	string godBackupDir = goddirectory + "BACKUP";
-
-	::CreateDirectory(godBackupDir.c_str(), 0);
-	string godFileBACKUP = godBackupDir + "\\" + godGame.fileName;
-		//if(::DeleteFile(godFileBACKUP.c_str()))
-		//	console.Format("Backup deleted successfully!\n");
-	//console.Format("Attempting to create backup file\n%s...\n", godFileBACKUP.c_str());
-	if (::CopyFile(godFile.c_str(), godFileBACKUP.c_str(), false))
+	for (unsigned int i = 0; i < allNXE.size(); i++)
 	{
-		console.Format("Backup created successfully!\n");
-		// Unlock GOD
-		if (UnlockMe(godFile.c_str()) != true)
+		const NXE& nxe = allNXE[i];
+		console.Format("Converting %ls...\n", nxe.title.name);
+		CONVERT_REPORT report;
+		CONVERT_RESULT result = ConvertNXE(nxe, (devices[nxe.device] + filePathzzz).c_str(), true, true, CpuCount(), &report);
+		if (result == CONVERT_OK)
 		{
-			genlog();
-			console.Format("FAILED\n");
-			debugLog("Unable to open new Games On Demand Live file at:");
-			debugLog((char*)goddirectory.c_str());
-			godGame.status = false;
+			console.Format("OK, %u parts (%u MB/s, %llu MB trimmed)\n", report.parts, report.MBps(), report.bytesSaved >> 20);
+			debugLog("Converted: %s to %s (%llu bytes in %lu ms)", nxe.path.c_str(), report.headerPath.c_str(), report.bytesWritten, report.elapsedMs);
 		}
-
-		if (godGame.status)
+		else if (result == CONVERT_EXISTS)
+			console.Format("Already installed at %s, skipped\n", report.headerPath.c_str());
+		else if (result == CONVERT_UNSUPPORTED)
+			console.Format("Data block offset %u isn't supported, skipped\n", nxe.dataBlockOffset);
+		else
 		{
-			debugLog("Unlocked: ");
-			debugLog((char*)goddirectory.c_str());
-			console.Format("Success!\n");
+			console.Format("FAILED (%d)\n", result);
+			debugLog("Convert failed (%d): %s", result, nxe.path.c_str());
 		}
 	}
-	else
-		console.Format("Failed to create backup of original file! Aborting...\n");
-	
 }
 
-int isGOD(WCHAR* path, string path2)
+// Writes every cataloged title back out as a disc image in ISOFolder, checking
+// the hash tree on the way
+void ExtractAllGODs()
 {
-	int Result = 0;
-
-	if (!path2.compare(path2.length() - 9, 8, "00007000") == 0)
-		return Result;
-
-	FILE* fd;
-	if (_wfopen_s(&fd, path, L"rb") == 0)
+	VfsCreateDir(ISOFolder);
+	for (unsigned int i = 0; i < catalog.Count(); i++)
 	{
-		// Confirm it's a GOD content package
-		unsigned char buf[4];
-		unsigned char GODID[] = { 0, 0, 0x70, 0 };
-		fseek(fd, 0x344, SEEK_SET);
-		fread(buf, sizeof(buf), 1, fd);
-		if (memcmp(buf, GODID, sizeof(GODID)) != 0) // It's not a GOD package so we close it and return
+		if (SkipDuplicates && catalog.IsDuplicate(i))
+			continue;
+		console.Format("Extracting %ls...\n", catalog.Title(i));
+		EXTRACT_REPORT report;
+		EXTRACT_RESULT result = ExtractGOD(catalog, i, ISOFolder, true, &report);
+		if (result == EXTRACT_OK)
 		{
-			fclose(fd);
-			return Result;
-		}
-
-		// We know it's a GOD at this point so no we determine if it's already unlocked and which header it has
-
-		// Lock state check. We replace the package signature with ByromWasHereUnlockingYourGODGame repeatedly when unlocking
-		// Package signature is ignored on modified consoles.
-		unsigned char buf2[4];
-		unsigned char ByromHeader[] = { 0x42, 0x79, 0x72, 0x6F }; // B y r o
-		fseek(fd, 4, SEEK_SET);
-		fread(buf2, sizeof(buf2), 1, fd);
-		if (memcmp(buf2, ByromHeader, sizeof(ByromHeader)) == 0) // If it's already unlocked we set Result to 3
-		{
-			Result = 3;
+			console.Format("OK (%u MB/s)\n", report.MBps());
+			debugLog("Extracted: %s (%llu bytes in %lu ms)", catalog.FullPath(i).c_str(), report.bytes, report.elapsedMs);
 		}
+		else if (result == EXTRACT_EXISTS)
+			console.Format("Already extracted to %s, skipped\n", ISOFolder);
 		else
 		{
-			// Header type check
-			unsigned char buf3[4];
-			unsigned char LIVEHeader[] = { 0x4C, 0x49, 0x56, 0x45 }; // L I V E
-			unsigned char PIRSHeader[] = { 0x50, 0x49, 0x52, 0x53 }; // P I R S
-			fseek(fd, 0, SEEK_SET);
-			fread(buf3, sizeof(buf3), 1, fd);
-			if (memcmp(buf3, LIVEHeader, sizeof(LIVEHeader)) == 0) // Check it has LIVE header
-				Result = 1; // We set Result to 1
-			else if (memcmp(buf3, PIRSHeader, sizeof(PIRSHeader)) == 0) // Check it has PIRS header
-				Result = 2; // We set Result to 2
-
-			// Check if it's one of the game bundles. These don't work correctly when license info is set
-			unsigned char buf4[4];
-			unsigned char DestinyBundleTID[] = { 0x41, 0x56, 0x09, 0x28 }; // 41560928 - Collector's Edition
-			unsigned char BO3BundleTID[] = { 0x41, 0x56, 0x09, 0x29 }; // 41560929 - Black Ops III Bundle
-			unsigned char CODMWBundleTID[] = { 0x41, 0x56, 0x09, 0x31 }; // 41560931 - COD: MW Bundle
-			unsigned char PrototypeBundleTID[] = { 0x41, 0x56, 0x09, 0x2D }; // 4156092D - Prototype Bio Bundle
-			unsigned char FableBundleTID[] = { 0x4D, 0x53, 0x0A, 0xA2 }; // 4D530AA2 - Fable Trilogy
-			fseek(fd, 0x360, SEEK_SET);
-			fread(buf4, sizeof(buf4), 1, fd);
-			// Compare the title id to see if it's one of the bundles
-			if (memcmp(buf4, DestinyBundleTID, sizeof(DestinyBundleTID)) == 0 || memcmp(buf4, BO3BundleTID, sizeof(BO3BundleTID)) == 0
-				|| memcmp(buf4, CODMWBundleTID, sizeof(CODMWBundleTID)) == 0 || memcmp(buf4, PrototypeBundleTID, sizeof(PrototypeBundleTID)) == 0
-				|| memcmp(buf4, FableBundleTID, sizeof(FableBundleTID)) == 0)
-				Result = 4; // We set Result to 4
-
-			// If it's none of the above we just do nothing (Result will remain 0). Header must be corrupted or something for this
+			console.Format("FAILED (%d) in Data%04u at 0x%llX\n", result, report.part, report.offset);
+			debugLog("Extract failed (%d): %s part %u offset 0x%llX", result, catalog.FullPath(i).c_str(), report.part, report.offset);
 		}
-
-		fclose(fd); // Close the file
 	}
-	return Result; // Finally return the Result
 }
 
-HRESULT ScanDir(string strFind)
+void LogGODs(const char* heading, GOD_TYPE type)
 {
-	HANDLE hFind;
-	WIN32_FIND_DATA wfd;
-	LPSTR lpPath = new char[MAX_PATH];
-	LPWSTR lpPathW = new wchar_t[MAX_PATH];
-	LPSTR lpFileName = new char[MAX_PATH];
-	LPWSTR lpFileNameW = new wchar_t[MAX_PATH];
-	string sFileName;
-	strFind += "\\*";
-	strFind._Copy_s(lpPath, strFind.length(),strFind.length());
-	lpPath[strFind.length()]='\0';
-	::MultiByteToWideChar( CP_ACP, NULL,lpPath, -1, lpPathW, MAX_PATH);
-	hFind = FindFirstFile( lpPath, &wfd );
-	int nIndex = 0;
-	if(INVALID_HANDLE_VALUE == hFind)
+	debugLog("%s", heading);
+	const CatalogView& view = catalog.View(type);
+	for (unsigned int i = 0; i < view.size(); i++)
+		debugLog("%ls: %s", catalog.Title(view[i]), catalog.Path(view[i]).c_str());
+}
+
+void LogDuplicates()
+{
+	vector<CatalogView> groups;
+	catalog.FindDuplicates(groups);
+	if (groups.empty())
+		return;
+	debugLog("--Duplicates--");
+	for (unsigned int g = 0; g < groups.size(); g++)
 	{
-		//debugLog("Invalid handle type - Directory most likely empty");
-		//debugLog(lpPath);
-		//debugLog(lpFileName);
+		for (unsigned int i = 0; i < groups[g].size(); i++)
+			debugLog("%ls: %s%s", catalog.Title(groups[g][i]), catalog.FullPath(groups[g][i]).c_str(), catalog.IsDuplicate(groups[g][i]) ? "" : " (kept)");
 	}
+}
+
+// Moves the canonical copies to the next device that holds any
+void CycleKeepDevice()
+{
+	KeepDevice = (KeepDevice + 1) % devices.size();
+	catalog.PreferDevice(KeepDevice);
+	console.Format("Keeping the copies on %s (%llu MB reclaimable)\n", devices[KeepDevice].c_str(), catalog.ReclaimableBytes() >> 20);
+	LogDuplicates();
+}
+
+void OnGODFound(int device, const string& fileName, const string& path, const GOD_HEADER_INFO& header, void* context)
+{
+	// Title rules decide which category (and so which patch) each title gets
+	GOD_HEADER_INFO classified = header;
+	classified.type = rules.Classify(header);
+	catalog.Add(device, fileName, path, classified);
+}
+
+void OnDeviceScanned(int device, const string& root, unsigned int found, unsigned long elapsedMs, void* context)
+{
+	debugLog("%s scanned: %u GOD titles in %lu ms", devices[device].c_str(), found, elapsedMs);
+}
+
+// The list view asks for a title's text only when it comes into view or changes
+void GetTitleLine(UINT item, WCHAR* line, UINT size, VOID* context)
+{
+	wcsncpy_s(line, size, titleList.Line(item).c_str(), _TRUNCATE);
+}
+
+// X acts on the checked titles: unlocks them, or in restore mode restores them
+const WCHAR* TitleListKeys()
+{
+	return titleList.RestoreMode()
+		? L"UP/DOWN move, LEFT/RIGHT page, A check, Y check all, X restore checked, BACK unlock mode"
+		: L"UP/DOWN move, LEFT/RIGHT page, A check, Y check all, X unlock checked, BACK restore mode";
+}
+
+void ShowTitleList()
+{
+	console.BeginListView(1, 2, GetTitleLine, NULL);
+	console.SetListFixedLine(1, TitleListKeys());
+	titleList.SetPageSize(console.GetListPageSize());
+}
+
+// Only called when a count changes, the console keeps the line until then
+void UpdateTitleListStatus(bool scanning, const ScanFeed& feed, unsigned int devicesDone)
+{
+	WCHAR status[128];
+	if (scanning)
+		swprintf_s(status, 128, L"Scanning... %u titles found, %u of %u devices done", titleList.Count(), devicesDone, feed.Devices());
 	else
+		swprintf_s(status, 128, L"Scan complete, %u titles found, %u checked", titleList.Count(), titleList.CheckedCount());
+	console.SetListFixedLine(0, status);
+	console.SetListFixedLine(2, scanning ? L"B quit" : L"START for more options, B quit");
+}
+
+// Unlocks the checked titles straight away, even while the scan is still running.
+// Progress goes to the console text as before, then the list comes back.
+void UnlockChecked()
+{
+	CatalogView checked;
+	titleList.Checked(checked);
+	console.EndListView();
+	UnlockExecutor executor;
+	for (unsigned int i = 0; i < checked.size(); i++)
+	{
+		titleList.Uncheck(checked[i]);
+		if (!SkipDuplicates || !catalog.IsDuplicate(checked[i]))
+			AddUnlockJob(executor, checked[i]);
+	}
+	RunUnlocks(executor);
+	ShowTitleList();
+}
+
+// Puts back the original headers of the checked titles from the backup
+// archives, then brings the list back
+void RestoreChecked()
+{
+	CatalogView checked;
+	titleList.Checked(checked);
+	console.EndListView();
+	for (unsigned int i = 0; i < checked.size(); i++)
+	{
+		titleList.Uncheck(checked[i]);
+		RestoreGOD(checked[i]);
+	}
+	ShowTitleList();
+}
+
+// Lists titles as the scan workers find them, so they can be checked and
+// unlocked (or in restore mode, restored) before the slower devices are done.
+// Results are added to the catalog here on the UI thread, which keeps the
+// catalog single threaded. Returns once the scan is complete and the user asks
+// for the other options, or straight away if nothing was found.
+void PickTitles(ScanFeed& feed)
+{
+	ShowTitleList();
+	bool scanning = true;
+	bool changed = true;
+	unsigned int devicesDone = 0;
+	for (;;)
 	{
-		nIndex = 0;
-		do
+		if (scanning)
 		{
-			sFileName = wfd.cFileName;
-			sFileName._Copy_s(lpFileName, sFileName.length(), sFileName.length());
-			lpFileName[sFileName.length()]='\0';
-			::MultiByteToWideChar( CP_ACP, NULL,lpFileName, -1, lpFileNameW, MAX_PATH);
-			if(FILE_ATTRIBUTE_DIRECTORY == wfd.dwFileAttributes)
+			// Read before draining: once every device is done, an empty feed is final
+			unsigned int done = feed.DevicesDone();
+			SCAN_RESULT result;
+			while (feed.Next(&result, 0))
+				OnGODFound(result.device, result.fileName, result.path, result.header, NULL);
+			changed |= titleList.Refresh() || done != devicesDone;
+			devicesDone = done;
+			if (done == feed.Devices())
 			{
-				string nextDir;
-				nextDir += lpPath;
-				string nextDir1;
-				nextDir1 += lpFileName;
-				nextDir.erase(nextDir.size() - 1, 1);
-				nextDir += nextDir1;
-				ScanDir(nextDir);
-			}
-			else
-			{
-				string filePath;
-				string filePathX;
-				string fileNameX;
-				filePath += lpPath;
-				string fileName;
-				fileName += lpFileName;
-				filePath.erase(filePath.size() - 1, 1);
-				filePathX += filePath;
-				fileNameX += fileName;
-				filePath += fileName;
-				LPSTR FileA = new char[MAX_PATH];
-				LPSTR FileNameA = new char[MAX_PATH];
-				LPSTR FilePathA = new char[MAX_PATH];
-				filePathX._Copy_s(FilePathA, filePathX.length(),filePathX.length());
-				fileNameX._Copy_s(FileNameA , fileNameX.length(),fileNameX.length());
-				filePath._Copy_s(FileA, filePath.length(),filePath.length());
-				FileA[filePath.length()]='\0';
-				LPWSTR FileB = new wchar_t[MAX_PATH];
-				::MultiByteToWideChar(CP_ACP, NULL, FileA, -1, FileB, MAX_PATH);
-
-				int GODType = isGOD(FileB, filePathX);
-				if (GODType == 1) // Regular GOD file downloaded officially or created with nxe2god (LIVE header)
+				scanning = false;
+				if (catalog.Count() == 0)
 				{
-					//NXE temp(fileNameX,filePathX);
-					//allNXE.push_back(temp);
-					GOD temp(fileNameX, filePathX);
-					allGODRegular.push_back(temp);
+					console.EndListView();
+					return;
 				}
-				else if (GODType == 2) // MSP Spoofed GOD file (PIRS header). Will fix these to have a live header
-				{
-					GOD temp(fileNameX, filePathX);
-					allGODMSPSpoofed.push_back(temp);
-				}
-				else if (GODType == 3) // Already unlocked GOD file (Either format). Will just print how many of these were found
-				{
-					GOD temp(fileNameX, filePathX);
-					allGODUnlocked.push_back(temp);
-				}
-				else if (GODType == 4) // Game bundle downloader. These load but give an error about using the correct account when license info is set so we'll just wipe the license info
-				{
-					GOD temp(fileNameX, filePathX);
-					allGODBundle.push_back(temp);
-				}
-				// 0 is returned for none GOD files and therefore ignored
+				catalog.MarkDuplicates();
+				console.InvalidateList();
+				changed = true;
 			}
-			nIndex++;
 		}
-		while(FindNextFile(hFind, &wfd));
-		FindClose(hFind);
+
+		// The console only redraws when one of these actually moved
+		if (changed)
+			UpdateTitleListStatus(scanning, feed, devicesDone);
+		changed = false;
+		console.SetListCount(titleList.Count());
+		console.SetListTop(titleList.Top());
+		console.SetListSelection(titleList.Cursor());
+		console.RenderListView();
+
+		// Sleep until a button is pressed. While the scan runs or a frame is held
+		// back by the console's frame cap, wake up a frame later to pick them up.
+		DWORD timeout = scanning || console.IsListViewPending() ? ATG::Console::LISTVIEW_FRAME_INTERVAL : INFINITE;
+		WORD pressed = ATG::Input::WaitForMergedInput(timeout)->wPressedButtons;
+		if (pressed & XINPUT_GAMEPAD_DPAD_UP)
+			titleList.Move(-1);
+		if (pressed & XINPUT_GAMEPAD_DPAD_DOWN)
+			titleList.Move(1);
+		if (pressed & XINPUT_GAMEPAD_DPAD_LEFT)
+			titleList.Move(-(int)titleList.PageSize());
+		if (pressed & XINPUT_GAMEPAD_DPAD_RIGHT)
+			titleList.Move(titleList.PageSize());
+		if (pressed & XINPUT_GAMEPAD_A)
+		{
+			titleList.Toggle();
+			console.InvalidateListItem(titleList.Cursor());
+			changed = true;
+		}
+		if (pressed & XINPUT_GAMEPAD_Y)
+		{
+			titleList.CheckAll(titleList.CheckedCount() == 0);
+			console.InvalidateList();
+			changed = true;
+		}
+		if (pressed & XINPUT_GAMEPAD_BACK)
+		{
+			titleList.SetRestoreMode(!titleList.RestoreMode());
+			console.SetListFixedLine(1, TitleListKeys());
+			console.InvalidateList();
+			changed = true;
+		}
+		if ((pressed & XINPUT_GAMEPAD_X) && titleList.CheckedCount() != 0)
+		{
+			if (titleList.RestoreMode())
+				RestoreChecked();
+			else
+				UnlockChecked();
+			changed = true;
+		}
+		if ((pressed & XINPUT_GAMEPAD_START) && !scanning)
+		{
+			console.EndListView();
+			console.Clear();
+			return;
+		}
+		if (pressed & XINPUT_GAMEPAD_B)
+			ExitToDashboard();
 	}
-	return S_OK;
 }
 
 void MountDevice(const char* mountPath, char* path, char* msg, int* mounted){
 	if (Map(mountPath, path) == S_OK)
 	{
 		devices.push_back(mountPath);
-		debugLog(msg);
+		debugLog("%s", msg);
 		*mounted++;
 	}
 }
@@ -515,24 +610,47 @@ VOID __cdecl main()
 	console.Format("This application will unlock GOD format games that were orginally purchased on a different console or KV.bin.\n");
 	console.Format("Credits to Swizzy & Dstruktiv for the NXE2GOD source from which this is based.\n");
 	console.Format("NOTE:\n          Only titles unlocked by this application will be detected as \"Previously Unlocked\".\n          This is to ensure all titles are unlocked using the same method and license flags etc.\n");
-	debuglogexists = FileExists("game:\\debug.log");
-	if (!debuglogexists) genlog();
+	StartDebugLog("game:\\debug.log");
 	mountdrives();
 	console.Format("\n");
+	RecoverJournals();
 
 	unsigned int CombinedResultSize = 0;
 	console.Format("Scanning storage devices for GOD titles...\n");
+	// Built-in title rules can be extended or overridden from a text file
+	int userRules = rules.LoadFile(RulesFile);
+	if (userRules > 0)
+		console.Format("Loaded %d title rules from %s\n", userRules, RulesFile);
+
+	// Packages that haven't changed since the last run are taken from the index
+	ScanIndex index;
+	index.Load(IndexFile);
+
+	// One worker per mounted device, each feeding what it finds to the title list
+	ScanFeed feed(devices.size(), OnDeviceScanned, NULL);
+	ScanScheduler scanner(ScanFeed::OnFound, ScanFeed::OnDevice, &feed);
+	scanner.SetIndex(&index);
+	vector<string> scanRoots;
 	for (unsigned int i = 0; i < devices.size(); i++)
 	{
-		if (devices.size() == 0)
-			break;
-		//console.Format("Scanning %s\\ for GOD titles...", devices[i].c_str());
-		string tmp = devices[i] + filePathzzz;
-		ScanDir(tmp);
-		//console.Format("%s\\ Complete\n", devices[i].c_str());
-		
+		scanRoots.push_back(devices[i] + filePathzzz);
+		scanner.AddDevice(scanRoots[i]);
 	}
-	CombinedResultSize = allGODRegular.size() + allGODMSPSpoofed.size() + allGODUnlocked.size() + allGODBundle.size();
+	scanner.Start();
+	PickTitles(feed);
+	scanner.Wait();
+
+	if (!index.Save(IndexFile, scanRoots))
+		debugLog("Failed to save scan index");
+	debugLog("Scan index: %u unchanged, %u read", index.Hits(), index.Misses());
+
+	// NXE installs live beside GOD titles, one more listing per title
+	for (unsigned int i = 0; i < devices.size(); i++)
+		FindNXEInstalls(i, scanRoots[i], allNXE);
+	if (!allNXE.empty())
+		console.Format("Found %u NXE installs\n", (unsigned int)allNXE.size());
+
+	CombinedResultSize = catalog.Count();
 	
 	if ((CombinedResultSize == 0) && (devices.size() == 0))
 		console.Format("\nNo GOD titles found\n\nPush any key to exit");
@@ -541,46 +659,27 @@ VOID __cdecl main()
 	else
 	{
 		console.Format("Found %d GOD titles!\n", CombinedResultSize);
-		console.Format("%d Previously Unlocked.\n", allGODUnlocked.size());
-		console.Format("%d Regular GOD. (LIVE Header)\n", allGODRegular.size());
-		console.Format("%d MSP Spoofed GOD. (PIRS Header)\n", allGODMSPSpoofed.size());
-		console.Format("%d Game Bundle Downloader GOD. (Need to be patched differently)\n", allGODBundle.size());
+		console.Format("%d Previously Unlocked.\n", catalog.Count(GOD_TYPE_UNLOCKED));
+		console.Format("%d Regular GOD. (LIVE Header)\n", catalog.Count(GOD_TYPE_LIVE));
+		console.Format("%d MSP Spoofed GOD. (PIRS Header)\n", catalog.Count(GOD_TYPE_PIRS));
+		console.Format("%d Game Bundle Downloader GOD. (Need to be patched differently)\n", catalog.Count(GOD_TYPE_BUNDLE));
+		if (catalog.Count(GOD_TYPE_SKIPPED) != 0)
+			console.Format("%d Skipped by title rules.\n", catalog.Count(GOD_TYPE_SKIPPED));
+		unsigned int duplicates = catalog.MarkDuplicates();
+		if (duplicates != 0)
+			console.Format("%u Duplicate copies on other devices. (%llu MB reclaimable)\n", duplicates, catalog.ReclaimableBytes() >> 20);
 		//console.Format("\nGOD Files found:\n\n");
 		
-		//console.Format("--Regular--\n");
-		debugLog("--Regular--");
-		for (unsigned int i = 0; i < allGODRegular.size(); i++)
-		{
-			char* TitleInfo;
-			sprintf(TitleInfo, "%ls: %s", allGODRegular[i].title, allGODRegular[i].path.c_str());
-			debugLog(TitleInfo);
-			//console.Format("%ls at location: %s%s\n", allGODRegular[i].title, allGODRegular[i].path.c_str(), allGODRegular[i].fileName.c_str());
-		//	console.Format("%ls: %s\n", allGODRegular[i].title, allGODRegular[i].path.c_str());
-		}
-		//console.Format("--MSP Spoofed--\n");
-		debugLog("--MSP Spoofed--");
-		for (unsigned int i = 0; i < allGODMSPSpoofed.size(); i++)
-		{
-			char* TitleInfo;
-			sprintf(TitleInfo, "%ls: %s", allGODMSPSpoofed[i].title, allGODMSPSpoofed[i].path.c_str());
-			debugLog(TitleInfo);
-			//	console.Format("%ls: %s\n", allGODMSPSpoofed[i].title, allGODMSPSpoofed[i].path.c_str());
-		}
-		//console.Format("--Bundle Downloader--\n");
-		debugLog("--Bundle Downloader--");
-		for (unsigned int i = 0; i < allGODBundle.size(); i++)
-		{
-			char* TitleInfo;
-			sprintf(TitleInfo, "%ls: %s", allGODBundle[i].title, allGODBundle[i].path.c_str());
-			debugLog(TitleInfo);
-			//	console.Format("%ls: %s\n", allGODBundle[i].title, allGODBundle[i].path.c_str());
-		}
+		LogGODs("--Regular--", GOD_TYPE_LIVE);
+		LogGODs("--MSP Spoofed--", GOD_TYPE_PIRS);
+		LogGODs("--Bundle Downloader--", GOD_TYPE_BUNDLE);
+		LogDuplicates();
 
 		int OptionSelected = 0;
-		console.Format("\nSelect an option:\n - A to unlock all GOD titles\n - X to fix & unlock only MSP Spoofed GOD titles\n - Y to unlock only Bundle Downloaders\n - B to cancel and quit\n\n");
+		console.Format("\nSelect an option:\n - A to unlock all GOD titles\n - X to fix & unlock only MSP Spoofed GOD titles\n - Y to unlock only Bundle Downloaders\n - BACK to restore the original headers of previously unlocked titles\n - RB to verify the data of every GOD title\n - LB to convert the disc images in game:\\ISO to GOD titles\n - START to convert NXE installs to GOD titles\n - DOWN to extract every GOD title to a disc image in game:\\ISO\n - UP to skip or include duplicate copies\n - RIGHT to choose the device whose copies are kept\n - B to cancel and quit\n\n");
 		while (!keypush)
 		{
-			ATG::GAMEPAD* pGamepad = ATG::Input::GetMergedInput();
+			ATG::GAMEPAD* pGamepad = ATG::Input::WaitForMergedInput(INFINITE);
 			if (pGamepad->wPressedButtons & XINPUT_GAMEPAD_A)
 			{
 				OptionSelected = 1;
@@ -596,41 +695,106 @@ VOID __cdecl main()
 				OptionSelected = 3;
 				keypush = true;
 			}
+			if ((pGamepad->wPressedButtons & XINPUT_GAMEPAD_BACK) && catalog.Count(GOD_TYPE_UNLOCKED) != 0)
+			{
+				OptionSelected = 4;
+				keypush = true;
+			}
+			if (pGamepad->wPressedButtons & XINPUT_GAMEPAD_RIGHT_SHOULDER)
+			{
+				OptionSelected = 5;
+				keypush = true;
+			}
+			if (pGamepad->wPressedButtons & XINPUT_GAMEPAD_LEFT_SHOULDER)
+			{
+				OptionSelected = 6;
+				keypush = true;
+			}
+			if ((pGamepad->wPressedButtons & XINPUT_GAMEPAD_START) && !allNXE.empty())
+			{
+				OptionSelected = 7;
+				keypush = true;
+			}
+			if (pGamepad->wPressedButtons & XINPUT_GAMEPAD_DPAD_DOWN)
+			{
+				OptionSelected = 8;
+				keypush = true;
+			}
+			if ((pGamepad->wPressedButtons & XINPUT_GAMEPAD_DPAD_UP) && duplicates != 0)
+			{
+				SkipDuplicates = !SkipDuplicates;
+				console.Format("Duplicate copies will be %s\n", SkipDuplicates ? "skipped" : "included");
+			}
+			if ((pGamepad->wPressedButtons & XINPUT_GAMEPAD_DPAD_RIGHT) && duplicates != 0)
+				CycleKeepDevice();
 			if (pGamepad->wPressedButtons & XINPUT_GAMEPAD_B)
-				XLaunchNewImage(XLAUNCH_KEYWORD_DEFAULT_APP, 0);
+				ExitToDashboard();
 		}
+		// All three unlock options go through one executor run, every device at once
+		UnlockExecutor executor;
 		if (OptionSelected == 1)
 		{
 			console.Format("Unlocking all GOD titles, please wait...\n\n");
-			for (unsigned int i = 0; i < allGODRegular.size(); i++)
-				UnlockGOD(allGODRegular[i]);
-			for (unsigned int i = 0; i < allGODMSPSpoofed.size(); i++)
-				UnlockGOD(allGODMSPSpoofed[i]);
-			DoNotSetLicense = true;
-			for (unsigned int i = 0; i < allGODBundle.size(); i++)
-				UnlockGOD(allGODBundle[i]);
+			AddUnlockJobs(executor, GOD_TYPE_LIVE);
+			AddUnlockJobs(executor, GOD_TYPE_PIRS);
+			AddUnlockJobs(executor, GOD_TYPE_BUNDLE);
+			RunUnlocks(executor);
 		}
 		else if (OptionSelected == 2)
 		{
 			console.Format("Fixing & unlocking all MSP Spoofed GOD titles, please wait...\n\n");
-			for (unsigned int i = 0; i < allGODMSPSpoofed.size(); i++)
-				UnlockGOD(allGODMSPSpoofed[i]);
+			AddUnlockJobs(executor, GOD_TYPE_PIRS);
+			RunUnlocks(executor);
 		}
 		else if (OptionSelected == 3)
 		{
 			console.Format("Unlocking all Game Bundle Downloaders, please wait...\n\n");
-			DoNotSetLicense = true;
-			for (unsigned int i = 0; i < allGODBundle.size(); i++)
-				UnlockGOD(allGODBundle[i]);
+			AddUnlockJobs(executor, GOD_TYPE_BUNDLE);
+			RunUnlocks(executor);
+		}
+		else if (OptionSelected == 4)
+		{
+			console.Format("Restoring original headers, please wait...\n\n");
+			RestoreGODs(GOD_TYPE_UNLOCKED);
+		}
+		else if (OptionSelected == 5)
+		{
+			console.Format("Verifying GOD data parts, please wait...\n\n");
+			VerifyAllGODs();
+		}
+		else if (OptionSelected == 6)
+		{
+			console.Format("Converting disc images, please wait...\n\n");
+			ConvertISOs();
+		}
+		else if (OptionSelected == 7)
+		{
+			console.Format("Converting NXE installs, please wait...\n\n");
+			ConvertNXEInstalls();
+		}
+		else if (OptionSelected == 8)
+		{
+			console.Format("Extracting disc images, please wait...\n\n");
+			ExtractAllGODs();
+		}
+		for (unsigned int i = 0; i < backups.size(); i++)
+		{
+			delete backups[i];
+			backups[i] = NULL;
+		}
+		for (unsigned int i = 0; i < journals.size(); i++)
+		{
+			delete journals[i];
+			journals[i] = NULL;
 		}
-		console.Format("Processing complete!\nBackups of the original files can be found here: \\Content\\0000000000000000\\<TitleID>\\00007000\\BACKUP\nPush any key to exit");
+		console.Format("Processing complete!\nBackups of the original headers can be found here: <Device>\\%s\nPush any key to exit", BACKUP_ARCHIVE_NAME);
 	}
 
 	keypush = false;
 	while (!keypush)
 	{
-		ATG::GAMEPAD* pGamepad = ATG::Input::GetMergedInput();
+		ATG::GAMEPAD* pGamepad = ATG::Input::WaitForMergedInput(INFINITE);
 		if (pGamepad->wPressedButtons)
-			XLaunchNewImage(XLAUNCH_KEYWORD_DEFAULT_APP, 0);
+			ExitToDashboard();
 	}
 }
\ No newline at end of file
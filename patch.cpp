@@ -0,0 +1,151 @@
+#include <string.h>
+#include "patch.h"
+#include "vfs.h"
+
+unsigned char HeaderMain[] = {
+	0x4C, 0x49, 0x56, 0x45, 0x42, 0x79, 0x72, 0x6F, 0x6D, 0x57,
+	0x61, 0x73, 0x48, 0x65, 0x72, 0x65, 0x55, 0x6E, 0x6C, 0x6F,
+	0x63, 0x6B, 0x69, 0x6E, 0x67, 0x59, 0x6F, 0x75, 0x72, 0x47,
+	0x4F, 0x44, 0x47, 0x61, 0x6D, 0x65, 0x42, 0x79, 0x72, 0x6F,
+	0x6D, 0x57, 0x61, 0x73, 0x48, 0x65, 0x72, 0x65, 0x55, 0x6E,
+	0x6C, 0x6F, 0x63, 0x6B, 0x69, 0x6E, 0x67, 0x59, 0x6F, 0x75,
+	0x72, 0x47, 0x4F, 0x44, 0x47, 0x61, 0x6D, 0x65, 0x42, 0x79,
+	0x72, 0x6F, 0x6D, 0x57, 0x61, 0x73, 0x48, 0x65, 0x72, 0x65,
+	0x55, 0x6E, 0x6C, 0x6F, 0x63, 0x6B, 0x69, 0x6E, 0x67, 0x59,
+	0x6F, 0x75, 0x72, 0x47, 0x4F, 0x44, 0x47, 0x61, 0x6D, 0x65,
+	0x42, 0x79, 0x72, 0x6F, 0x6D, 0x57, 0x61, 0x73, 0x48, 0x65,
+	0x72, 0x65, 0x55, 0x6E, 0x6C, 0x6F, 0x63, 0x6B, 0x69, 0x6E,
+	0x67, 0x59, 0x6F, 0x75, 0x72, 0x47, 0x4F, 0x44, 0x47, 0x61,
+	0x6D, 0x65, 0x42, 0x79, 0x72, 0x6F, 0x6D, 0x57, 0x61, 0x73,
+	0x48, 0x65, 0x72, 0x65, 0x55, 0x6E, 0x6C, 0x6F, 0x63, 0x6B,
+	0x69, 0x6E, 0x67, 0x59, 0x6F, 0x75, 0x72, 0x47, 0x4F, 0x44,
+	0x47, 0x61, 0x6D, 0x65, 0x42, 0x79, 0x72, 0x6F, 0x6D, 0x57,
+	0x61, 0x73, 0x48, 0x65, 0x72, 0x65, 0x55, 0x6E, 0x6C, 0x6F,
+	0x63, 0x6B, 0x69, 0x6E, 0x67, 0x59, 0x6F, 0x75, 0x72, 0x47,
+	0x4F, 0x44, 0x47, 0x61, 0x6D, 0x65, 0x42, 0x79, 0x72, 0x6F,
+	0x6D, 0x57, 0x61, 0x73, 0x48, 0x65, 0x72, 0x65, 0x55, 0x6E,
+	0x6C, 0x6F, 0x63, 0x6B, 0x69, 0x6E, 0x67, 0x59, 0x6F, 0x75,
+	0x72, 0x47, 0x4F, 0x44, 0x47, 0x61, 0x6D, 0x65, 0x42, 0x79,
+	0x72, 0x6F, 0x6D, 0x57, 0x61, 0x73, 0x48, 0x65, 0x72, 0x65,
+	0x55, 0x6E, 0x6C, 0x6F, 0x63, 0x6B, 0x69, 0x6E, 0x67, 0x59,
+	0x6F, 0x75, 0x72, 0x47, 0x4F, 0x44, 0x47, 0x61, 0x6D, 0x65
+};
+
+unsigned char LicenseInfo[] = {
+0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00,
+0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0xFF, 0xFF, 0xFF, 0xFF,
+0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x01
+};
+
+void BuildLicenseBlock(unsigned char* block, bool setLicense)
+{
+	// Wipe the license section completely
+	memset(block, 0, PATCH_LICENSE_SIZE);
+	// Add our license info
+	if (setLicense)
+		memcpy(block, LicenseInfo, sizeof(LicenseInfo));
+}
+
+void BuildPatchRegions(PATCH_REGIONS* regions, bool setLicense)
+{
+	memcpy(regions->signature, HeaderMain, sizeof(regions->signature));
+	BuildLicenseBlock(regions->license, setLicense);
+}
+
+bool IsUnlockedRegions(const PATCH_REGIONS& regions)
+{
+	// The package signature follows the magic and starts with "Byro"
+	return memcmp(regions.signature + STFS_MAGIC::SIZE, HeaderMain + STFS_MAGIC::SIZE, 4) == 0;
+}
+
+PATCH_RESULT ReadHeaderRegions(const char* file, PATCH_REGIONS* regions)
+{
+	VfsFile* fd = VfsOpen(file, VFS_READ);
+	if (fd == NULL)
+		return PATCH_OPEN_FAILED;
+
+	if (fd->Size() < PATCH_MIN_FILE_SIZE)
+	{
+		delete fd;
+		return PATCH_TOO_SMALL;
+	}
+
+	bool ok = VfsReadExact(fd, PATCH_SIGNATURE_OFFSET, regions->signature, sizeof(regions->signature))
+		&& VfsReadExact(fd, PATCH_LICENSE_OFFSET, regions->license, sizeof(regions->license));
+	delete fd;
+	return ok ? PATCH_OK : PATCH_READ_FAILED;
+}
+
+PATCH_RESULT PatchHeader(const char* file, bool setLicense, PATCH_BACKUP_CALLBACK backup, void* context)
+{
+	VfsFile* fd = VfsOpen(file, VFS_READWRITE);
+	if (fd == NULL)
+		return PATCH_OPEN_FAILED;
+
+	if (fd->Size() < PATCH_MIN_FILE_SIZE)
+	{
+		delete fd;
+		return PATCH_TOO_SMALL;
+	}
+
+	if (backup)
+	{
+		PATCH_REGIONS original;
+		bool read = VfsReadExact(fd, PATCH_SIGNATURE_OFFSET, original.signature, sizeof(original.signature))
+			&& VfsReadExact(fd, PATCH_LICENSE_OFFSET, original.license, sizeof(original.license));
+		if (!read)
+		{
+			delete fd;
+			return PATCH_READ_FAILED;
+		}
+		if (IsUnlockedRegions(original))
+		{
+			delete fd;
+			return PATCH_ALREADY_UNLOCKED;
+		}
+		if (!backup(original, context))
+		{
+			delete fd;
+			return PATCH_BACKUP_FAILED;
+		}
+	}
+
+	PATCH_REGIONS patched;
+	BuildPatchRegions(&patched, setLicense);
+
+	// Add LIVE file header and custom package signature, then the license block.
+	// Both writes go through the same handle and are flushed once at the end.
+	bool ok = fd->Write(PATCH_SIGNATURE_OFFSET, patched.signature, sizeof(patched.signature))
+		&& fd->Write(PATCH_LICENSE_OFFSET, patched.license, sizeof(patched.license));
+	if (!fd->Flush())
+		ok = false;
+	delete fd;
+	return ok ? PATCH_OK : PATCH_WRITE_FAILED;
+}
+
+PATCH_RESULT WriteHeaderRegions(const char* file, const PATCH_REGIONS& regions, PATCH_REGIONS* verify)
+{
+	VfsFile* fd = VfsOpen(file, VFS_READWRITE);
+	if (fd == NULL)
+		return PATCH_OPEN_FAILED;
+
+	if (fd->Size() < PATCH_MIN_FILE_SIZE)
+	{
+		delete fd;
+		return PATCH_TOO_SMALL;
+	}
+
+	bool ok = fd->Write(PATCH_SIGNATURE_OFFSET, regions.signature, sizeof(regions.signature))
+		&& fd->Write(PATCH_LICENSE_OFFSET, regions.license, sizeof(regions.license))
+		&& fd->Flush();
+	if (!ok)
+	{
+		delete fd;
+		return PATCH_WRITE_FAILED;
+	}
+
+	ok = VfsReadExact(fd, PATCH_SIGNATURE_OFFSET, verify->signature, sizeof(verify->signature))
+		&& VfsReadExact(fd, PATCH_LICENSE_OFFSET, verify->license, sizeof(verify->license));
+	delete fd;
+	return ok ? PATCH_OK : PATCH_READ_FAILED;
+}
@@ -0,0 +1,62 @@
+#ifndef PATCH_H
+#define PATCH_H
+#include "platform.h"
+#include "stfs.h"
+
+// Regions of the package header rewritten when unlocking. Everything else in the
+// file (including the .data parts) is left untouched. The signature region is the
+// magic plus the first 0x100 bytes of the package signature.
+#define PATCH_SIGNATURE_OFFSET	STFS_MAGIC::OFFSET
+#define PATCH_SIGNATURE_SIZE	(STFS_MAGIC::SIZE + 0x100)
+#define PATCH_LICENSE_OFFSET	STFS_LICENSE_TABLE::OFFSET
+#define PATCH_LICENSE_SIZE		STFS_LICENSE_TABLE::SIZE
+#define PATCH_MIN_FILE_SIZE		(STFS_DISPLAY_NAME::OFFSET + 2)
+
+enum PATCH_RESULT
+{
+	PATCH_OK = 0,
+	PATCH_READ_FAILED,	// Couldn't determine the package size
+	PATCH_OPEN_FAILED,	// Couldn't open the package for read/write
+	PATCH_TOO_SMALL,	// Package is too small to hold a header
+	PATCH_WRITE_FAILED,	// One of the positioned writes or the flush failed
+	PATCH_BACKUP_FAILED,	// The backup callback refused, nothing was written
+	PATCH_ALREADY_UNLOCKED	// The header already carries the unlock signature, nothing was written
+};
+
+// Contents of the two patched regions
+struct PATCH_REGIONS
+{
+	unsigned char signature[PATCH_SIGNATURE_SIZE];
+	unsigned char license[PATCH_LICENSE_SIZE];
+};
+
+// Called with the original bytes after they are read and before anything is
+// written. Returning false leaves the package untouched.
+typedef bool (*PATCH_BACKUP_CALLBACK)(const PATCH_REGIONS& original, void* context);
+
+extern unsigned char HeaderMain[PATCH_SIGNATURE_SIZE];
+extern unsigned char LicenseInfo[0x1C];
+
+// Builds the 0x100 byte license block written at PATCH_LICENSE_OFFSET
+void BuildLicenseBlock(unsigned char* block, bool setLicense);
+
+// The regions as PatchHeader writes them
+void BuildPatchRegions(PATCH_REGIONS* regions, bool setLicense);
+
+// True if the signature region already holds the unlock signature. Those bytes
+// aren't an original header and must never be backed up as one.
+bool IsUnlockedRegions(const PATCH_REGIONS& regions);
+
+// Reads both regions of a package without changing anything
+PATCH_RESULT ReadHeaderRegions(const char* file, PATCH_REGIONS* regions);
+
+// Patches the header of a GOD package in place. Only the signature and license
+// regions are written, the rest of the file is never read or truncated. If backup
+// is given the original regions are read through the same handle and passed to it
+// before the patch is written; a header that is already unlocked is left alone.
+PATCH_RESULT PatchHeader(const char* file, bool setLicense, PATCH_BACKUP_CALLBACK backup = NULL, void* context = NULL);
+
+// Writes both regions back in place (used to restore a backup) and reads them back
+// through the same handle into verify so the caller can check what landed on disk.
+PATCH_RESULT WriteHeaderRegions(const char* file, const PATCH_REGIONS& regions, PATCH_REGIONS* verify);
+#endif
@@ -0,0 +1,37 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+#ifdef _XBOX
+#include <xtl.h>
+#else
+// Host builds (the command line tool) only need the few Win32 types and CRT
+// helpers the engine uses, mapped onto their POSIX equivalents.
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <wchar.h>
+
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned int DWORD;
+typedef wchar_t WCHAR;
+
+#ifndef MAX_PATH
+#define MAX_PATH 260
+#endif
+#ifndef _TRUNCATE
+#define _TRUNCATE ((size_t)-1)
+#endif
+
+inline int _stricmp(const char* a, const char* b) { return strcasecmp(a, b); }
+inline int _strnicmp(const char* a, const char* b, size_t count) { return strncasecmp(a, b, count); }
+inline char* strtok_s(char* text, const char* delimiters, char** context) { return strtok_r(text, delimiters, context); }
+
+// Only the _TRUNCATE form is used: returns -1 if the text didn't fit
+inline int vsnprintf_s(char* buffer, size_t size, size_t, const char* format, va_list args)
+{
+	int length = vsnprintf(buffer, size, format, args);
+	return length >= (int)size ? -1 : length;
+}
+#endif
+#endif
@@ -0,0 +1,81 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+#include <vector>
+#include "thread.h"
+
+// Fixed capacity FIFO between threads. Push blocks while the queue is full and
+// Pop while it's empty, which keeps a fast producer from running ahead of its
+// consumers by more than the capacity.
+template <typename T>
+class BoundedQueue
+{
+public:
+	BoundedQueue(unsigned int capacity)
+		: m_items(capacity), m_free(capacity, capacity), m_used(0, capacity), m_head(0), m_tail(0) {}
+
+	void Push(const T& item)
+	{
+		m_free.Wait();
+		{
+			ScopedLock lock(m_lock);
+			m_items[m_tail] = item;
+			m_tail = (m_tail + 1) % m_items.size();
+		}
+		m_used.Post();
+	}
+
+	// Pushes only if there is room right now, false if the queue is full
+	bool TryPush(const T& item)
+	{
+		if (!m_free.Wait(0))
+			return false;
+		{
+			ScopedLock lock(m_lock);
+			m_items[m_tail] = item;
+			m_tail = (m_tail + 1) % m_items.size();
+		}
+		m_used.Post();
+		return true;
+	}
+
+	T Pop()
+	{
+		m_used.Wait();
+		return Take();
+	}
+
+	// Waits at most ms milliseconds for an item, false if none arrived
+	bool Pop(T* item, unsigned long ms)
+	{
+		if (!m_used.Wait(ms))
+			return false;
+		*item = Take();
+		return true;
+	}
+
+	unsigned int Capacity() const { return m_items.size(); }
+
+private:
+	std::vector<T> m_items;
+	CriticalSection m_lock;
+	Semaphore m_free;
+	Semaphore m_used;
+	unsigned int m_head;
+	unsigned int m_tail;
+
+	T Take()
+	{
+		T item;
+		{
+			ScopedLock lock(m_lock);
+			item = m_items[m_head];
+			m_head = (m_head + 1) % m_items.size();
+		}
+		m_free.Post();
+		return item;
+	}
+
+	BoundedQueue(const BoundedQueue&);
+	BoundedQueue& operator=(const BoundedQueue&);
+};
+#endif
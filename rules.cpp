@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include "rules.h"
+#include "vfs.h"
+
+using std::vector;
+
+// Title id 0 never appears in a GOD header so it marks an empty slot
+#define EMPTY_TITLE_ID 0
+
+static const TITLE_RULE BuiltinRules[] = {
+	// Game bundle downloaders. These load but give an error about using the correct account when license info is set
+	{ 0x41560928, PATCH_POLICY_WIPE_LICENSE }, // Destiny - Collector's Edition
+	{ 0x41560929, PATCH_POLICY_WIPE_LICENSE }, // Black Ops III Bundle
+	{ 0x41560931, PATCH_POLICY_WIPE_LICENSE }, // COD: MW Bundle
+	{ 0x4156092D, PATCH_POLICY_WIPE_LICENSE }, // Prototype Bio Bundle
+	{ 0x4D530AA2, PATCH_POLICY_WIPE_LICENSE }, // Fable Trilogy
+};
+
+// A policy keyword must be a whole word, so "settle" isn't read as "set"
+static bool IsKeyword(const char* text, const char* keyword)
+{
+	size_t length = strlen(keyword);
+	if (_strnicmp(text, keyword, length) != 0)
+		return false;
+	char next = text[length];
+	return next == 0 || next == ' ' || next == '\t';
+}
+
+RuleTable::RuleTable() : m_bucketShift(31), m_slotShift(31)
+{
+	for (unsigned int i = 0; i < sizeof(BuiltinRules) / sizeof(BuiltinRules[0]); i++)
+		m_rules.push_back(BuiltinRules[i]);
+	Build();
+}
+
+void RuleTable::Add(DWORD titleId, PATCH_POLICY policy)
+{
+	if (titleId == EMPTY_TITLE_ID)
+		return;
+	for (unsigned int i = 0; i < m_rules.size(); i++)
+	{
+		if (m_rules[i].titleId == titleId)
+		{
+			m_rules[i].policy = policy;
+			Build();
+			return;
+		}
+	}
+	TITLE_RULE rule = { titleId, policy };
+	m_rules.push_back(rule);
+	Build();
+}
+
+int RuleTable::LoadFile(const char* file)
+{
+	vector<char> text;
+	if (!VfsReadFile(file, text))
+		return -1;
+	if (text.empty())
+		return 0;
+	text.push_back(0);
+
+	// Parse everything first and compile the table once at the end
+	std::map<DWORD, unsigned int> existing;
+	for (unsigned int i = 0; i < m_rules.size(); i++)
+		existing[m_rules[i].titleId] = i;
+	int count = 0;
+	char* context = NULL;
+	for (char* line = strtok_s(&text[0], "\r\n", &context); line; line = strtok_s(NULL, "\r\n", &context))
+	{
+		char* comment = strchr(line, '#');
+		if (comment)
+			*comment = 0;
+		char* end;
+		DWORD titleId = strtoul(line, &end, 16);
+		if (end == line || titleId == EMPTY_TITLE_ID)
+			continue;
+		while (*end == ' ' || *end == '\t')
+			end++;
+
+		PATCH_POLICY policy;
+		if (IsKeyword(end, "set"))
+			policy = PATCH_POLICY_SET_LICENSE;
+		else if (IsKeyword(end, "wipe"))
+			policy = PATCH_POLICY_WIPE_LICENSE;
+		else if (IsKeyword(end, "skip"))
+			policy = PATCH_POLICY_SKIP;
+		else
+			continue;
+
+		std::map<DWORD, unsigned int>::iterator it = existing.find(titleId);
+		if (it != existing.end())
+			m_rules[it->second].policy = policy;
+		else
+		{
+			TITLE_RULE rule = { titleId, policy };
+			existing[titleId] = m_rules.size();
+			m_rules.push_back(rule);
+		}
+		count++;
+	}
+	Build();
+	return count;
+}
+
+struct BucketOrder
+{
+	const vector< vector<unsigned int> >* buckets;
+	bool operator()(unsigned int a, unsigned int b) const
+	{
+		return (*buckets)[a].size() > (*buckets)[b].size();
+	}
+};
+
+// Groups the rules into buckets of about four, then places the largest buckets
+// first, searching for a seed that sends every id in the bucket to a free slot
+void RuleTable::Build()
+{
+	unsigned int slotBits = 1;
+	while ((1U << slotBits) < m_rules.size() * 2)
+		slotBits++;
+	unsigned int bucketBits = slotBits > 3 ? slotBits - 3 : 1;
+	m_slotShift = 32 - slotBits;
+	m_bucketShift = 32 - bucketBits;
+
+	vector< vector<unsigned int> > buckets(1U << bucketBits);
+	for (unsigned int i = 0; i < m_rules.size(); i++)
+		buckets[Bucket(m_rules[i].titleId)].push_back(i);
+	vector<unsigned int> order(buckets.size());
+	for (unsigned int i = 0; i < order.size(); i++)
+		order[i] = i;
+	BucketOrder largestFirst;
+	largestFirst.buckets = &buckets;
+	std::sort(order.begin(), order.end(), largestFirst);
+
+	TITLE_RULE empty = { EMPTY_TITLE_ID, PATCH_POLICY_DEFAULT };
+	m_table.assign(1U << slotBits, empty);
+	m_seeds.assign(buckets.size(), 0);
+	vector<unsigned int> slots;
+	for (unsigned int b = 0; b < order.size(); b++)
+	{
+		const vector<unsigned int>& bucket = buckets[order[b]];
+		if (bucket.empty())
+			break;
+		for (unsigned int seed = 0;; seed++)
+		{
+			slots.clear();
+			bool placed = true;
+			for (unsigned int i = 0; i < bucket.size() && placed; i++)
+			{
+				unsigned int slot = Slot(m_rules[bucket[i]].titleId, seed);
+				if (m_table[slot].titleId != EMPTY_TITLE_ID || std::find(slots.begin(), slots.end(), slot) != slots.end())
+					placed = false;
+				slots.push_back(slot);
+			}
+			if (placed)
+			{
+				for (unsigned int i = 0; i < bucket.size(); i++)
+					m_table[slots[i]] = m_rules[bucket[i]];
+				m_seeds[order[b]] = seed;
+				break;
+			}
+		}
+	}
+}
+
+PATCH_POLICY RuleTable::Lookup(DWORD titleId) const
+{
+	const TITLE_RULE& slot = m_table[Slot(titleId, m_seeds[Bucket(titleId)])];
+	return slot.titleId == titleId ? slot.policy : PATCH_POLICY_DEFAULT;
+}
+
+GOD_TYPE RuleTable::Classify(const GOD_HEADER_INFO& header) const
+{
+	// Already unlocked titles are left alone whatever the rules say
+	if (header.type != GOD_TYPE_LIVE && header.type != GOD_TYPE_PIRS)
+		return header.type;
+
+	switch (Lookup(header.titleId))
+	{
+	case PATCH_POLICY_WIPE_LICENSE:
+		return GOD_TYPE_BUNDLE;
+	case PATCH_POLICY_SKIP:
+		return GOD_TYPE_SKIPPED;
+	default:
+		return header.type;
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef RULES_H
+#define RULES_H
+#include <vector>
+#include "header.h"
+
+enum PATCH_POLICY
+{
+	PATCH_POLICY_DEFAULT = 0,	// No rule, unlock with license info set
+	PATCH_POLICY_SET_LICENSE,	// Unlock with license info set (overrides a built-in rule)
+	PATCH_POLICY_WIPE_LICENSE,	// Unlock with the license section wiped (bundle downloaders)
+	PATCH_POLICY_SKIP			// Never patch this title
+};
+
+struct TITLE_RULE
+{
+	DWORD titleId;
+	PATCH_POLICY policy;
+};
+
+// Title id -> patch policy. The rules are compiled into a collision free hash table
+// (hash and displace: each bucket of title ids gets a seed that sends its ids to
+// free slots) so a lookup is a single table probe no matter how many rules exist.
+class RuleTable
+{
+public:
+	// Starts out with the built-in rules
+	RuleTable();
+
+	// Adds rules from a text file, one "<TitleID> <set|wipe|skip>" per line with
+	// # comments. Later rules replace earlier ones for the same title id.
+	// Returns the number of rules read, or -1 if the file couldn't be opened.
+	int LoadFile(const char* file);
+
+	void Add(DWORD titleId, PATCH_POLICY policy);
+
+	PATCH_POLICY Lookup(DWORD titleId) const;
+
+	// Maps a header classification onto the catalog category its policy needs
+	GOD_TYPE Classify(const GOD_HEADER_INFO& header) const;
+
+	unsigned int Count() const { return m_rules.size(); }
+
+private:
+	void Build();
+	unsigned int Bucket(DWORD titleId) const
+	{
+		return ((unsigned int)titleId * 0x9E3779B1U) >> m_bucketShift;
+	}
+	unsigned int Slot(DWORD titleId, unsigned int seed) const
+	{
+		unsigned int h = (unsigned int)titleId ^ (seed * 0x85EBCA6BU);
+		h ^= h >> 16;
+		h *= 0x7FEB352DU;
+		h ^= h >> 15;
+		h *= 0x846CA68BU;
+		h ^= h >> 16;
+		return h >> m_slotShift;
+	}
+
+	std::vector<TITLE_RULE> m_rules;
+	std::vector<TITLE_RULE> m_table;
+	std::vector<unsigned int> m_seeds;
+	unsigned int m_bucketShift;
+	unsigned int m_slotShift;
+};
+#endif
@@ -0,0 +1,176 @@
+#include "scan.h"
+#include "vfs.h"
+
+using std::string;
+using std::vector;
+
+ScanScheduler::ScanScheduler(SCAN_FOUND_CALLBACK onFound, SCAN_DEVICE_CALLBACK onDevice, void* context)
+	: m_onFound(onFound), m_onDevice(onDevice), m_context(context), m_index(NULL)
+{
+}
+
+ScanScheduler::~ScanScheduler()
+{
+	Wait();
+	for (unsigned int i = 0; i < m_workers.size(); i++)
+		delete m_workers[i];
+}
+
+int ScanScheduler::AddDevice(const string& root)
+{
+	DEVICE_WORKER* worker = new DEVICE_WORKER;
+	worker->owner = this;
+	worker->device = m_workers.size();
+	worker->root = root;
+	worker->threaded = false;
+	worker->found = 0;
+	m_workers.push_back(worker);
+	return worker->device;
+}
+
+void ScanScheduler::Start()
+{
+	for (unsigned int i = 0; i < m_workers.size(); i++)
+	{
+		DEVICE_WORKER* worker = m_workers[i];
+		worker->threaded = StartThread(WorkerProc, worker, &worker->thread);
+		// Fall back to scanning inline if we couldn't get a thread
+		if (!worker->threaded)
+			ScanDevice(worker);
+	}
+}
+
+void ScanScheduler::Wait()
+{
+	for (unsigned int i = 0; i < m_workers.size(); i++)
+	{
+		if (m_workers[i]->threaded)
+		{
+			JoinThread(m_workers[i]->thread);
+			m_workers[i]->threaded = false;
+		}
+	}
+}
+
+void ScanScheduler::WorkerProc(void* param)
+{
+	DEVICE_WORKER* worker = (DEVICE_WORKER*)param;
+	worker->owner->ScanDevice(worker);
+}
+
+// Content is laid out as <Profile>\<TitleID>\<ContentType>\. The root is the profile
+// folder, so only one listing per title is needed to reach its 00007000 folder and
+// enumeration cost scales with the number of titles rather than the data parts.
+void ScanScheduler::ScanDevice(DEVICE_WORKER* worker)
+{
+	unsigned long start = TickCount();
+	vector<VFS_ENTRY> titles;
+	VfsList(worker->root.c_str(), titles);
+	for (unsigned int i = 0; i < titles.size(); i++)
+	{
+		if (!titles[i].directory || titles[i].name[0] == '.')
+			continue;
+		ScanGODFolder(worker, worker->root + "\\" + titles[i].name + "\\00007000\\");
+	}
+
+	if (m_onDevice)
+	{
+		ScopedLock lock(m_lock);
+		m_onDevice(worker->device, worker->root, worker->found, TickCount() - start, m_context);
+	}
+}
+
+// Lists the header packages in a single <TitleID>\00007000\ folder. Subdirectories
+// (the <name>.data parts and BACKUP) are skipped without being opened.
+void ScanScheduler::ScanGODFolder(DEVICE_WORKER* worker, const string& godPath)
+{
+	vector<VFS_ENTRY> files;
+	if (!VfsList(godPath.c_str(), files))
+		return;
+	for (unsigned int i = 0; i < files.size(); i++)
+	{
+		if (files[i].directory)
+			continue;
+
+		const string& fileName = files[i].name;
+		string filePath = godPath + fileName;
+		unsigned long long size = files[i].size;
+		unsigned long long lastWrite = files[i].lastWrite;
+
+		// The listing already gives us size and time, so an unchanged package costs nothing.
+		// Classification happens outside the lock so devices overlap their reads.
+		GOD_HEADER_INFO header;
+		if (m_index == NULL || !m_index->Lookup(filePath, size, lastWrite, &header))
+		{
+			ClassifyHeader(filePath.c_str(), &header);
+			if (m_index)
+				m_index->Update(filePath, size, lastWrite, header);
+		}
+		if (header.type == GOD_TYPE_NONE)
+			continue;
+
+		worker->found++;
+		if (m_onFound)
+		{
+			ScopedLock lock(m_lock);
+			m_onFound(worker->device, fileName, godPath, header, m_context);
+		}
+	}
+}
+
+ScanFeed::ScanFeed(unsigned int devices, SCAN_DEVICE_CALLBACK onDevice, void* context)
+	: m_ready(0, 0x7FFFFFFF), m_devices(devices), m_done(0), m_onDevice(onDevice), m_context(context)
+{
+}
+
+ScanFeed::~ScanFeed()
+{
+	for (unsigned int i = 0; i < m_pending.size(); i++)
+		delete m_pending[i];
+}
+
+void ScanFeed::OnFound(int device, const string& fileName, const string& path, const GOD_HEADER_INFO& header, void* context)
+{
+	ScanFeed* feed = (ScanFeed*)context;
+	SCAN_RESULT* result = new SCAN_RESULT;
+	result->device = device;
+	result->fileName = fileName;
+	result->path = path;
+	result->header = header;
+	{
+		ScopedLock lock(feed->m_lock);
+		feed->m_pending.push_back(result);
+	}
+	feed->m_ready.Post();
+}
+
+void ScanFeed::OnDevice(int device, const string& root, unsigned int found, unsigned long elapsedMs, void* context)
+{
+	ScanFeed* feed = (ScanFeed*)context;
+	if (feed->m_onDevice)
+		feed->m_onDevice(device, root, found, elapsedMs, feed->m_context);
+	// Everything this worker found was pushed before it gets here
+	ScopedLock lock(feed->m_lock);
+	feed->m_done++;
+}
+
+bool ScanFeed::Next(SCAN_RESULT* result, unsigned long ms)
+{
+	if (!m_ready.Wait(ms))
+		return false;
+	SCAN_RESULT* next;
+	{
+		ScopedLock lock(m_lock);
+		next = m_pending.front();
+		m_pending.pop_front();
+	}
+	*result = *next;
+	delete next;
+	return true;
+}
+
+unsigned int ScanFeed::DevicesDone()
+{
+	ScopedLock lock(m_lock);
+	return m_done;
+}
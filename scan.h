@@ -0,0 +1,111 @@
+#ifndef SCAN_H
+#define SCAN_H
+#include <string>
+#include <vector>
+#include "header.h"
+#include <deque>
+#include "index.h"
+#include "thread.h"
+
+// Called for every header package found. Calls from all workers are serialized by
+// the scheduler, so the receiver can append to its catalog without extra locking.
+typedef void (*SCAN_FOUND_CALLBACK)(int device, const std::string& fileName, const std::string& path, const GOD_HEADER_INFO& header, void* context);
+
+// Called once per device when its worker has finished walking it
+typedef void (*SCAN_DEVICE_CALLBACK)(int device, const std::string& root, unsigned int found, unsigned long elapsedMs, void* context);
+
+// Scans every device on its own worker thread. Devices sit on independent buses
+// (HDD, USB0-4, memory units) so the total scan time is that of the slowest one.
+class ScanScheduler
+{
+public:
+	ScanScheduler(SCAN_FOUND_CALLBACK onFound, SCAN_DEVICE_CALLBACK onDevice, void* context);
+	~ScanScheduler();
+
+	// root is the profile folder to walk, e.g. HDD:\Content\0000000000000000.
+	// Any directory can stand in for a device. Returns the device index.
+	int AddDevice(const std::string& root);
+
+	// Packages found unchanged in the index are not opened. Must be set before Start.
+	void SetIndex(ScanIndex* index) { m_index = index; }
+
+	// Starts one worker per device
+	void Start();
+
+	// Blocks until every worker has finished
+	void Wait();
+
+	unsigned int DeviceCount() const { return m_workers.size(); }
+
+private:
+	struct DEVICE_WORKER
+	{
+		ScanScheduler* owner;
+		int device;
+		std::string root;
+		THREAD_HANDLE thread;
+		bool threaded;
+		unsigned int found;
+	};
+
+	static void WorkerProc(void* param);
+	void ScanDevice(DEVICE_WORKER* worker);
+	void ScanGODFolder(DEVICE_WORKER* worker, const std::string& godPath);
+
+	SCAN_FOUND_CALLBACK m_onFound;
+	SCAN_DEVICE_CALLBACK m_onDevice;
+	void* m_context;
+	ScanIndex* m_index;
+	std::vector<DEVICE_WORKER*> m_workers;
+	CriticalSection m_lock;
+
+	ScanScheduler(const ScanScheduler&);
+	ScanScheduler& operator=(const ScanScheduler&);
+};
+
+// A header package found by a scan, as queued by ScanFeed
+struct SCAN_RESULT
+{
+	int device;
+	std::string fileName;
+	std::string path;
+	GOD_HEADER_INFO header;
+};
+
+// Hands scan results from the workers to a single consumer, normally the UI
+// thread, so titles can be shown and acted on while slower devices are still
+// being walked. The consumer is the only one touching its catalog, so it can
+// read it freely. Workers never wait on the consumer: the scheduler scans inline
+// when it can't get a thread, and the feed must not block it then.
+class ScanFeed
+{
+public:
+	// onDevice, if given, is still called on the worker as each device finishes
+	ScanFeed(unsigned int devices, SCAN_DEVICE_CALLBACK onDevice = NULL, void* context = NULL);
+	~ScanFeed();
+
+	// Pass these to the ScanScheduler, with the feed as its context
+	static void OnFound(int device, const std::string& fileName, const std::string& path, const GOD_HEADER_INFO& header, void* context);
+	static void OnDevice(int device, const std::string& root, unsigned int found, unsigned long elapsedMs, void* context);
+
+	// Takes the next result, waiting at most ms milliseconds. False if none arrived.
+	bool Next(SCAN_RESULT* result, unsigned long ms);
+
+	// Devices whose workers have finished. Once this reaches the device count,
+	// a Next that comes back empty means every result has been taken.
+	unsigned int DevicesDone();
+	unsigned int Devices() const { return m_devices; }
+
+private:
+	std::deque<SCAN_RESULT*> m_pending;
+	Semaphore m_ready;	// One count per pending result
+	unsigned int m_devices;
+	unsigned int m_done;
+	CriticalSection m_lock;
+	SCAN_DEVICE_CALLBACK m_onDevice;
+	void* m_context;
+
+	ScanFeed(const ScanFeed&);
+	ScanFeed& operator=(const ScanFeed&);
+};
+#endif
@@ -0,0 +1,118 @@
+#include "sha1.h"
+#ifdef _XBOX
+#include <xtl.h>
+
+extern "C" VOID XeCryptSha(LPVOID DataBuffer1, UINT DataSize1, LPVOID DataBuffer2, UINT DataSize2, LPVOID DataBuffer3, UINT DataSize3, LPVOID DigestBuffer, UINT DigestSize);
+
+void Sha1(const void* data1, unsigned int size1, const void* data2, unsigned int size2, unsigned char* digest)
+{
+	XeCryptSha((LPVOID)data1, size1, (LPVOID)data2, size2, NULL, 0, digest, SHA1_DIGEST_SIZE);
+}
+#else
+#include <string.h>
+
+// Portable implementation for host builds
+struct SHA1_STATE
+{
+	unsigned int h[5];
+	unsigned char block[64];
+	unsigned int used;
+	unsigned long long length;
+};
+
+static unsigned int Rol(unsigned int value, int bits)
+{
+	return (value << bits) | (value >> (32 - bits));
+}
+
+// The message schedule is kept in a 16 word ring and the rounds are unrolled five
+// at a time with the working variables rotated by name instead of copied.
+#define SHA1_W(i)	(w[(i) & 15] = Rol(w[((i) + 13) & 15] ^ w[((i) + 8) & 15] ^ w[((i) + 2) & 15] ^ w[(i) & 15], 1))
+#define SHA1_R0(v, x, y, z, u, i)	u += ((x & (y ^ z)) ^ z) + w[i] + 0x5A827999 + Rol(v, 5); x = Rol(x, 30);
+#define SHA1_R1(v, x, y, z, u, i)	u += ((x & (y ^ z)) ^ z) + SHA1_W(i) + 0x5A827999 + Rol(v, 5); x = Rol(x, 30);
+#define SHA1_R2(v, x, y, z, u, i)	u += (x ^ y ^ z) + SHA1_W(i) + 0x6ED9EBA1 + Rol(v, 5); x = Rol(x, 30);
+#define SHA1_R3(v, x, y, z, u, i)	u += (((x | y) & z) | (x & y)) + SHA1_W(i) + 0x8F1BBCDC + Rol(v, 5); x = Rol(x, 30);
+#define SHA1_R4(v, x, y, z, u, i)	u += (x ^ y ^ z) + SHA1_W(i) + 0xCA62C1D6 + Rol(v, 5); x = Rol(x, 30);
+#define SHA1_FIVE(R, i)	R(a, b, c, d, e, (i)) R(e, a, b, c, d, (i) + 1) R(d, e, a, b, c, (i) + 2) R(c, d, e, a, b, (i) + 3) R(b, c, d, e, a, (i) + 4)
+
+static void Sha1Block(SHA1_STATE* state, const unsigned char* block)
+{
+	unsigned int w[16];
+	for (int i = 0; i < 16; i++)
+		w[i] = ((unsigned int)block[i * 4] << 24) | ((unsigned int)block[i * 4 + 1] << 16) | ((unsigned int)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+
+	unsigned int a = state->h[0], b = state->h[1], c = state->h[2], d = state->h[3], e = state->h[4];
+	SHA1_FIVE(SHA1_R0, 0) SHA1_FIVE(SHA1_R0, 5) SHA1_FIVE(SHA1_R0, 10)
+	SHA1_R0(a, b, c, d, e, 15) SHA1_R1(e, a, b, c, d, 16) SHA1_R1(d, e, a, b, c, 17) SHA1_R1(c, d, e, a, b, 18) SHA1_R1(b, c, d, e, a, 19)
+	SHA1_FIVE(SHA1_R2, 20) SHA1_FIVE(SHA1_R2, 25) SHA1_FIVE(SHA1_R2, 30) SHA1_FIVE(SHA1_R2, 35)
+	SHA1_FIVE(SHA1_R3, 40) SHA1_FIVE(SHA1_R3, 45) SHA1_FIVE(SHA1_R3, 50) SHA1_FIVE(SHA1_R3, 55)
+	SHA1_FIVE(SHA1_R4, 60) SHA1_FIVE(SHA1_R4, 65) SHA1_FIVE(SHA1_R4, 70) SHA1_FIVE(SHA1_R4, 75)
+	state->h[0] += a;
+	state->h[1] += b;
+	state->h[2] += c;
+	state->h[3] += d;
+	state->h[4] += e;
+}
+
+static void Sha1Update(SHA1_STATE* state, const unsigned char* data, unsigned int size)
+{
+	state->length += size;
+	// Whole blocks are hashed straight from the caller's buffer
+	while (state->used == 0 && size >= 64)
+	{
+		Sha1Block(state, data);
+		data += 64;
+		size -= 64;
+	}
+	while (size)
+	{
+		unsigned int chunk = 64 - state->used;
+		if (chunk > size)
+			chunk = size;
+		memcpy(state->block + state->used, data, chunk);
+		state->used += chunk;
+		data += chunk;
+		size -= chunk;
+		if (state->used == 64)
+		{
+			Sha1Block(state, state->block);
+			state->used = 0;
+		}
+	}
+}
+
+void Sha1(const void* data1, unsigned int size1, const void* data2, unsigned int size2, unsigned char* digest)
+{
+	SHA1_STATE state;
+	state.h[0] = 0x67452301;
+	state.h[1] = 0xEFCDAB89;
+	state.h[2] = 0x98BADCFE;
+	state.h[3] = 0x10325476;
+	state.h[4] = 0xC3D2E1F0;
+	state.used = 0;
+	state.length = 0;
+	if (data1)
+		Sha1Update(&state, (const unsigned char*)data1, size1);
+	if (data2)
+		Sha1Update(&state, (const unsigned char*)data2, size2);
+
+	unsigned long long bits = state.length * 8;
+	unsigned char pad = 0x80;
+	Sha1Update(&state, &pad, 1);
+	pad = 0;
+	while (state.used != 56)
+		Sha1Update(&state, &pad, 1);
+	unsigned char length[8];
+	for (int i = 0; i < 8; i++)
+		length[i] = (unsigned char)(bits >> (56 - i * 8));
+	Sha1Update(&state, length, 8);
+
+	for (int i = 0; i < 5; i++)
+	{
+		digest[i * 4] = (unsigned char)(state.h[i] >> 24);
+		digest[i * 4 + 1] = (unsigned char)(state.h[i] >> 16);
+		digest[i * 4 + 2] = (unsigned char)(state.h[i] >> 8);
+		digest[i * 4 + 3] = (unsigned char)state.h[i];
+	}
+}
+#endif
@@ -0,0 +1,13 @@
+#ifndef SHA1_H
+#define SHA1_H
+
+#define SHA1_DIGEST_SIZE 20
+
+// One-shot SHA-1 over up to two buffers. Uses XeCryptSha on the console.
+void Sha1(const void* data1, unsigned int size1, const void* data2, unsigned int size2, unsigned char* digest);
+
+inline void Sha1(const void* data, unsigned int size, unsigned char* digest)
+{
+	Sha1(data, size, 0, 0, digest);
+}
+#endif
@@ -0,0 +1,214 @@
+#ifndef STFS_H
+#define STFS_H
+#include <string.h>
+#include "platform.h"
+
+// Layout of the LIVE/PIRS/CON package header. Each field is a type carrying its
+// offset and size as compile-time constants, with Get/Set that decode straight
+// from the header bytes: no seeks, no copies, nothing computed at run time.
+//
+//   DWORD titleId = view.Get<STFS_TITLE_ID>();
+//   view.Set<STFS_CONTENT_TYPE>(GOD_CONTENT_TYPE);
+
+// Unsigned integer stored big-endian (the native order of the console)
+template <unsigned int Offset, typename T, unsigned int Size = sizeof(T)>
+struct STFS_UINT_BE
+{
+	enum { OFFSET = Offset, SIZE = Size };
+	typedef T TYPE;
+	static T Get(const BYTE* header)
+	{
+		const BYTE* p = header + Offset;
+		T value = 0;
+		for (unsigned int i = 0; i < Size; i++)
+			value = (T)((value << 8) | p[i]);
+		return value;
+	}
+	static void Set(BYTE* header, T value)
+	{
+		BYTE* p = header + Offset;
+		for (unsigned int i = Size; i > 0; i--)
+		{
+			p[i - 1] = (BYTE)value;
+			value = (T)(value >> 8);
+		}
+	}
+};
+
+// Unsigned integer stored little-endian (the 24 bit block fields of the volume descriptor)
+template <unsigned int Offset, typename T, unsigned int Size = sizeof(T)>
+struct STFS_UINT_LE
+{
+	enum { OFFSET = Offset, SIZE = Size };
+	typedef T TYPE;
+	static T Get(const BYTE* header)
+	{
+		const BYTE* p = header + Offset;
+		T value = 0;
+		for (unsigned int i = Size; i > 0; i--)
+			value = (T)((value << 8) | p[i - 1]);
+		return value;
+	}
+	static void Set(BYTE* header, T value)
+	{
+		BYTE* p = header + Offset;
+		for (unsigned int i = 0; i < Size; i++)
+		{
+			p[i] = (BYTE)value;
+			value = (T)(value >> 8);
+		}
+	}
+};
+
+// Raw bytes. Get returns a pointer into the header itself.
+template <unsigned int Offset, unsigned int Size>
+struct STFS_BYTES
+{
+	enum { OFFSET = Offset, SIZE = Size };
+	typedef const BYTE* TYPE;
+	static const BYTE* Get(const BYTE* header) { return header + Offset; }
+	static void Set(BYTE* header, const void* value) { memcpy(header + Offset, value, Size); }
+};
+
+// Table of fixed size UTF-16BE strings, one per locale
+template <unsigned int Offset, unsigned int Count, unsigned int EntrySize>
+struct STFS_STRINGS
+{
+	enum { OFFSET = Offset, SIZE = Count * EntrySize, COUNT = Count, CHARS = EntrySize / 2 };
+	typedef const BYTE* TYPE;
+	static const BYTE* Get(const BYTE* header) { return header + Offset; }
+	static void Set(BYTE* header, const void* value) { memcpy(header + Offset, value, SIZE); }
+};
+
+#define STFS_LOCALE_COUNT			18
+#define STFS_LOCALE_STRING_SIZE		0x80
+#define STFS_LICENSE_ENTRIES		16
+#define STFS_THUMBNAIL_MAX			0x4000
+#define STFS_HEADER_SIZE			(0x571A + STFS_THUMBNAIL_MAX)	// Through the title thumbnail
+#define STFS_HEADER_HASHED_OFFSET	0x344	// The header hash covers from here to the end of the header
+
+enum STFS_DESCRIPTOR_TYPE
+{
+	STFS_DESCRIPTOR_STFS = 0,
+	STFS_DESCRIPTOR_SVOD = 1	// Games on Demand and other disc based content
+};
+
+typedef STFS_UINT_BE<0x000, DWORD>				STFS_MAGIC;				// LIVE, PIRS or CON
+typedef STFS_BYTES<0x004, 0x228>				STFS_SIGNATURE;
+typedef STFS_BYTES<0x22C, STFS_LICENSE_ENTRIES * 0x10>	STFS_LICENSE_TABLE;	// 16 x (licensee id, bits, flags)
+typedef STFS_BYTES<0x32C, 0x14>					STFS_HEADER_HASH;		// SHA-1 of the hashed part of the header
+typedef STFS_UINT_BE<0x340, DWORD>				STFS_HEADER_SIZE_FIELD;
+typedef STFS_UINT_BE<0x344, DWORD>				STFS_CONTENT_TYPE;
+typedef STFS_UINT_BE<0x348, DWORD>				STFS_METADATA_VERSION;
+typedef STFS_UINT_BE<0x34C, unsigned long long>	STFS_CONTENT_SIZE;
+typedef STFS_UINT_BE<0x354, DWORD>				STFS_MEDIA_ID;
+typedef STFS_UINT_BE<0x358, DWORD>				STFS_VERSION;
+typedef STFS_UINT_BE<0x35C, DWORD>				STFS_BASE_VERSION;
+typedef STFS_UINT_BE<0x360, DWORD>				STFS_TITLE_ID;
+typedef STFS_UINT_BE<0x364, BYTE>				STFS_PLATFORM;
+typedef STFS_UINT_BE<0x365, BYTE>				STFS_EXECUTABLE_TYPE;
+typedef STFS_UINT_BE<0x366, BYTE>				STFS_DISC_NUMBER;
+typedef STFS_UINT_BE<0x367, BYTE>				STFS_DISCS_IN_SET;
+typedef STFS_UINT_BE<0x368, DWORD>				STFS_SAVEGAME_ID;
+typedef STFS_BYTES<0x36C, 5>					STFS_CONSOLE_ID;
+typedef STFS_UINT_BE<0x371, unsigned long long>	STFS_PROFILE_ID;
+
+// Volume descriptor, laid out for SVOD (the only kind GOD packages use)
+typedef STFS_BYTES<0x379, 0x24>					STFS_VOLUME_DESCRIPTOR;
+typedef STFS_UINT_BE<0x379, BYTE>				STFS_SVOD_DESCRIPTOR_SIZE;
+typedef STFS_UINT_BE<0x37A, BYTE>				STFS_SVOD_BLOCK_CACHE_COUNT;
+typedef STFS_UINT_BE<0x37B, BYTE>				STFS_SVOD_WORKER_PROCESSOR;
+typedef STFS_UINT_BE<0x37C, BYTE>				STFS_SVOD_WORKER_PRIORITY;
+typedef STFS_BYTES<0x37D, 0x14>					STFS_SVOD_ROOT_HASH;	// SHA-1 of the master hash block of Data0000
+typedef STFS_UINT_BE<0x391, BYTE>				STFS_SVOD_FLAGS;
+typedef STFS_UINT_LE<0x392, DWORD, 3>			STFS_SVOD_DATA_BLOCK_COUNT;
+typedef STFS_UINT_LE<0x395, DWORD, 3>			STFS_SVOD_DATA_BLOCK_OFFSET;
+
+typedef STFS_UINT_BE<0x39D, DWORD>				STFS_DATA_FILE_COUNT;
+typedef STFS_UINT_BE<0x3A1, unsigned long long>	STFS_DATA_FILE_SIZE;	// Combined size of the data parts
+typedef STFS_UINT_BE<0x3A9, DWORD>				STFS_DESCRIPTOR_TYPE_FIELD;
+typedef STFS_BYTES<0x3FD, 0x14>					STFS_DEVICE_ID;
+typedef STFS_STRINGS<0x411, STFS_LOCALE_COUNT, STFS_LOCALE_STRING_SIZE>	STFS_DISPLAY_NAME;
+typedef STFS_STRINGS<0xD11, STFS_LOCALE_COUNT, STFS_LOCALE_STRING_SIZE>	STFS_DESCRIPTION;
+typedef STFS_STRINGS<0x1611, 1, STFS_LOCALE_STRING_SIZE>	STFS_PUBLISHER;
+typedef STFS_STRINGS<0x1691, 1, STFS_LOCALE_STRING_SIZE>	STFS_TITLE_NAME;
+typedef STFS_UINT_BE<0x1711, BYTE>				STFS_TRANSFER_FLAGS;
+typedef STFS_UINT_BE<0x1712, DWORD>				STFS_THUMBNAIL_SIZE;
+typedef STFS_UINT_BE<0x1716, DWORD>				STFS_TITLE_THUMBNAIL_SIZE;
+typedef STFS_BYTES<0x171A, STFS_THUMBNAIL_MAX>	STFS_THUMBNAIL;			// PNG, STFS_THUMBNAIL_SIZE bytes used
+typedef STFS_BYTES<0x571A, STFS_THUMBNAIL_MAX>	STFS_TITLE_THUMBNAIL;
+
+// A view over header bytes already in memory (a read page, a whole header or a
+// mapping). Fields past the end of the buffer read as zero, so a first-page view
+// can safely be asked for the thumbnails.
+class StfsHeaderView
+{
+public:
+	StfsHeaderView(const BYTE* header, DWORD size) : m_header(header), m_size(size) {}
+
+	template <typename F> bool Has() const { return F::OFFSET + F::SIZE <= m_size; }
+
+	template <typename F> typename F::TYPE Get() const
+	{
+		return Has<F>() ? F::Get(m_header) : (typename F::TYPE)0;
+	}
+
+	// Decodes locale's entry of a string table into out (NUL terminated, at most chars - 1 characters)
+	template <typename F> unsigned int GetString(unsigned int locale, WCHAR* out, unsigned int chars) const
+	{
+		unsigned int length = 0;
+		if (Has<F>() && locale < (unsigned int)F::COUNT && chars > 0)
+		{
+			const BYTE* p = F::Get(m_header) + locale * F::CHARS * 2;
+			for (; length < (unsigned int)F::CHARS && length + 1 < chars; length++)
+			{
+				WCHAR ch = (WCHAR)((p[length * 2] << 8) | p[length * 2 + 1]);
+				if (ch == 0)
+					break;
+				out[length] = ch;
+			}
+		}
+		if (chars > 0)
+			out[length] = 0;
+		return length;
+	}
+
+	const BYTE* Data() const { return m_header; }
+	DWORD Size() const { return m_size; }
+
+protected:
+	const BYTE* m_header;
+	DWORD m_size;
+};
+
+// The same view over a writable buffer, used to build or patch a header before
+// it's written out. Writes to fields past the end of the buffer are dropped.
+class StfsHeaderWriter : public StfsHeaderView
+{
+public:
+	StfsHeaderWriter(BYTE* header, DWORD size) : StfsHeaderView(header, size), m_writable(header) {}
+
+	template <typename F> void Set(typename F::TYPE value)
+	{
+		if (Has<F>())
+			F::Set(m_writable, value);
+	}
+
+	// Encodes text into locale's entry of a string table, zero padding the rest
+	template <typename F> void SetString(unsigned int locale, const WCHAR* text)
+	{
+		if (!Has<F>() || locale >= (unsigned int)F::COUNT)
+			return;
+		BYTE* p = m_writable + F::OFFSET + locale * F::CHARS * 2;
+		memset(p, 0, F::CHARS * 2);
+		for (unsigned int i = 0; i < (unsigned int)F::CHARS && text[i]; i++)
+		{
+			p[i * 2] = (BYTE)(text[i] >> 8);
+			p[i * 2 + 1] = (BYTE)text[i];
+		}
+	}
+
+private:
+	BYTE* m_writable;
+};
+#endif
@@ -0,0 +1,54 @@
+#include "svod.h"
+
+using std::string;
+
+SvodReader::SvodReader(const string& headerPath, unsigned int parts, unsigned long long size)
+	: m_headerPath(headerPath), m_files(parts, (VfsFile*)NULL), m_size(size)
+{
+}
+
+SvodReader::~SvodReader()
+{
+	for (unsigned int i = 0; i < m_files.size(); i++)
+		delete m_files[i];
+}
+
+bool SvodReader::Read(unsigned long long offset, void* buffer, DWORD size, DWORD* read)
+{
+	*read = 0;
+	if (offset > m_size)
+		return false;
+	if (size > m_size - offset)
+		size = (DWORD)(m_size - offset);
+	char* out = (char*)buffer;
+	while (size > 0)
+	{
+		unsigned long long block = offset / SVOD_BLOCK_SIZE;
+		unsigned int part = (unsigned int)(block / SVOD_BLOCKS_PER_PART);
+		unsigned int group = (unsigned int)(block % SVOD_BLOCKS_PER_PART) / SVOD_BLOCKS_PER_GROUP;
+		unsigned int index = (unsigned int)(block % SVOD_BLOCKS_PER_PART) % SVOD_BLOCKS_PER_GROUP;
+		unsigned int within = (unsigned int)(offset % SVOD_BLOCK_SIZE);
+		if (part >= m_files.size())
+			return false;
+		if (m_files[part] == NULL)
+		{
+			m_files[part] = VfsOpen(SvodPartPath(m_headerPath, part).c_str(), VFS_READ);
+			if (m_files[part] == NULL)
+				return false;
+		}
+
+		// Past the master block and the group's hash block
+		unsigned long long fileOffset = SVOD_BLOCK_SIZE + (unsigned long long)group * SVOD_GROUP_SIZE
+			+ (1 + index) * SVOD_BLOCK_SIZE + within;
+		unsigned int run = (SVOD_BLOCKS_PER_GROUP - index) * SVOD_BLOCK_SIZE - within;
+		if (run > size)
+			run = size;
+		if (!VfsReadExact(m_files[part], fileOffset, out, run))
+			return false;
+		out += run;
+		offset += run;
+		size -= run;
+		*read += run;
+	}
+	return true;
+}
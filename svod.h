@@ -0,0 +1,55 @@
+#ifndef SVOD_H
+#define SVOD_H
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "sha1.h"
+#include "vfs.h"
+
+// A GOD package keeps its disc image in <header>.data\Data0000, Data0001, ...
+// Each part is a master hash block followed by up to 0xCB groups, and each group
+// is a sub hash block followed by the up to 0xCC data blocks it hashes. The
+// master block lists the hashes of its sub hash blocks and, after them, the hash
+// of the next part's master block. The header's root hash covers Data0000's
+// master block, which chains everything together.
+#define SVOD_BLOCK_SIZE				0x1000
+#define SVOD_BLOCKS_PER_GROUP		0xCC
+#define SVOD_GROUPS_PER_PART		0xCB
+#define SVOD_GROUP_SIZE				((1 + SVOD_BLOCKS_PER_GROUP) * SVOD_BLOCK_SIZE)
+#define SVOD_PART_SIZE				(SVOD_BLOCK_SIZE + SVOD_GROUPS_PER_PART * SVOD_GROUP_SIZE)	// 0xA290000
+#define SVOD_BLOCKS_PER_PART		(SVOD_GROUPS_PER_PART * SVOD_BLOCKS_PER_GROUP)				// 0xA1C4
+#define SVOD_NEXT_PART_HASH_OFFSET	(SVOD_GROUPS_PER_PART * SHA1_DIGEST_SIZE)
+
+inline std::string SvodPartPath(const std::string& headerPath, unsigned int part)
+{
+	char name[16];
+	sprintf(name, "\\Data%04u", part);
+	return headerPath + ".data" + name;
+}
+
+// Reads the data blocks of an SVOD package as the one continuous disc image they
+// hold, skipping the hash blocks. It's a read-only VfsFile of size bytes, so the
+// image can be handed to anything that reads files. Each part is opened when a
+// read first reaches it and stays open until the reader is deleted. Nothing is
+// verified.
+class SvodReader : public VfsFile
+{
+public:
+	SvodReader(const std::string& headerPath, unsigned int parts, unsigned long long size);
+	~SvodReader();
+
+	// One request per run of data blocks within a group
+	bool Read(unsigned long long offset, void* buffer, DWORD size, DWORD* read);
+	bool Write(unsigned long long /*offset*/, const void* /*buffer*/, DWORD /*size*/) { return false; }
+	unsigned long long Size() { return m_size; }
+	bool Flush() { return true; }
+
+private:
+	std::string m_headerPath;
+	std::vector<VfsFile*> m_files;
+	unsigned long long m_size;
+
+	SvodReader(const SvodReader&);
+	SvodReader& operator=(const SvodReader&);
+};
+#endif
@@ -0,0 +1,155 @@
+#include "thread.h"
+#ifndef _XBOX
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+struct THREAD_START
+{
+	THREAD_PROC proc;
+	void* param;
+};
+
+#ifdef _XBOX
+static DWORD WINAPI ThreadTrampoline(LPVOID lpParam)
+{
+	THREAD_START start = *(THREAD_START*)lpParam;
+	delete (THREAD_START*)lpParam;
+	start.proc(start.param);
+	return 0;
+}
+
+bool StartThread(THREAD_PROC proc, void* param, THREAD_HANDLE* handle)
+{
+	THREAD_START* start = new THREAD_START;
+	start->proc = proc;
+	start->param = param;
+	*handle = CreateThread(NULL, 0, ThreadTrampoline, start, 0, NULL);
+	if (*handle == NULL)
+	{
+		delete start;
+		return false;
+	}
+	return true;
+}
+
+void JoinThread(THREAD_HANDLE handle)
+{
+	WaitForSingleObject(handle, INFINITE);
+	CloseHandle(handle);
+}
+
+unsigned long TickCount()
+{
+	return GetTickCount();
+}
+
+void SleepFor(unsigned long ms)
+{
+	Sleep(ms);
+}
+
+unsigned int CpuCount()
+{
+	// Three cores with two hardware threads each
+	return 6;
+}
+
+CriticalSection::CriticalSection() { InitializeCriticalSection(&m_cs); }
+CriticalSection::~CriticalSection() { DeleteCriticalSection(&m_cs); }
+void CriticalSection::Enter() { EnterCriticalSection(&m_cs); }
+void CriticalSection::Leave() { LeaveCriticalSection(&m_cs); }
+
+Semaphore::Semaphore(unsigned int initial, unsigned int maximum) { m_handle = CreateSemaphore(NULL, initial, maximum, NULL); }
+Semaphore::~Semaphore() { CloseHandle(m_handle); }
+void Semaphore::Wait() { WaitForSingleObject(m_handle, INFINITE); }
+bool Semaphore::Wait(unsigned long ms) { return WaitForSingleObject(m_handle, ms) == WAIT_OBJECT_0; }
+void Semaphore::Post() { ReleaseSemaphore(m_handle, 1, NULL); }
+#else
+static void* ThreadTrampoline(void* lpParam)
+{
+	THREAD_START start = *(THREAD_START*)lpParam;
+	delete (THREAD_START*)lpParam;
+	start.proc(start.param);
+	return NULL;
+}
+
+bool StartThread(THREAD_PROC proc, void* param, THREAD_HANDLE* handle)
+{
+	THREAD_START* start = new THREAD_START;
+	start->proc = proc;
+	start->param = param;
+	if (pthread_create(handle, NULL, ThreadTrampoline, start) != 0)
+	{
+		delete start;
+		return false;
+	}
+	return true;
+}
+
+void JoinThread(THREAD_HANDLE handle)
+{
+	pthread_join(handle, NULL);
+}
+
+unsigned long TickCount()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+void SleepFor(unsigned long ms)
+{
+	if (ms == 0)
+	{
+		sched_yield();
+		return;
+	}
+	struct timespec ts;
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000;
+	nanosleep(&ts, NULL);
+}
+
+unsigned int CpuCount()
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (unsigned int)count : 1;
+}
+
+CriticalSection::CriticalSection() { pthread_mutex_init(&m_cs, NULL); }
+CriticalSection::~CriticalSection() { pthread_mutex_destroy(&m_cs); }
+void CriticalSection::Enter() { pthread_mutex_lock(&m_cs); }
+void CriticalSection::Leave() { pthread_mutex_unlock(&m_cs); }
+
+Semaphore::Semaphore(unsigned int initial, unsigned int /*maximum*/) { sem_init(&m_sem, 0, initial); }
+Semaphore::~Semaphore() { sem_destroy(&m_sem); }
+
+void Semaphore::Wait()
+{
+	while (sem_wait(&m_sem) != 0 && errno == EINTR)
+		;
+}
+
+bool Semaphore::Wait(unsigned long ms)
+{
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += ms / 1000;
+	deadline.tv_nsec += (ms % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+	int result;
+	while ((result = sem_timedwait(&m_sem, &deadline)) != 0 && errno == EINTR)
+		;
+	return result == 0;
+}
+
+void Semaphore::Post() { sem_post(&m_sem); }
+#endif
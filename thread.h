@@ -0,0 +1,72 @@
+#ifndef THREAD_H
+#define THREAD_H
+#include "platform.h"
+#ifdef _XBOX
+typedef HANDLE THREAD_HANDLE;
+#else
+#include <pthread.h>
+#include <semaphore.h>
+typedef pthread_t THREAD_HANDLE;
+#endif
+
+typedef void (*THREAD_PROC)(void* param);
+
+// Starts proc(param) on a new thread. The handle must be passed to JoinThread.
+bool StartThread(THREAD_PROC proc, void* param, THREAD_HANDLE* handle);
+void JoinThread(THREAD_HANDLE handle);
+
+// Milliseconds since an arbitrary point, for timing scans and I/O
+unsigned long TickCount();
+
+// Gives up the CPU for at least ms milliseconds (0 just yields)
+void SleepFor(unsigned long ms);
+
+// Hardware threads available for worker pools
+unsigned int CpuCount();
+
+class CriticalSection
+{
+public:
+	CriticalSection();
+	~CriticalSection();
+	void Enter();
+	void Leave();
+private:
+#ifdef _XBOX
+	CRITICAL_SECTION m_cs;
+#else
+	pthread_mutex_t m_cs;
+#endif
+	CriticalSection(const CriticalSection&);
+	CriticalSection& operator=(const CriticalSection&);
+};
+
+class Semaphore
+{
+public:
+	Semaphore(unsigned int initial, unsigned int maximum);
+	~Semaphore();
+	void Wait();
+	// Waits at most ms milliseconds, false if it timed out
+	bool Wait(unsigned long ms);
+	void Post();
+private:
+#ifdef _XBOX
+	HANDLE m_handle;
+#else
+	sem_t m_sem;
+#endif
+	Semaphore(const Semaphore&);
+	Semaphore& operator=(const Semaphore&);
+};
+
+class ScopedLock
+{
+public:
+	ScopedLock(CriticalSection& cs) : m_cs(cs) { m_cs.Enter(); }
+	~ScopedLock() { m_cs.Leave(); }
+private:
+	CriticalSection& m_cs;
+	ScopedLock& operator=(const ScopedLock&);
+};
+#endif
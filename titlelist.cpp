@@ -0,0 +1,101 @@
+#include "titlelist.h"
+
+using std::wstring;
+
+static const WCHAR* TypeNames[GOD_TYPE_COUNT] = { L"", L"Regular", L"MSP Spoofed", L"Unlocked", L"Bundle", L"Skipped" };
+static const WCHAR* StatusNames[] = { L"", L" - unlocked now", L" - FAILED", L" - restored" };
+
+TitleList::TitleList(const Catalog& catalog) : m_catalog(catalog), m_cursor(0), m_top(0), m_pageSize(1), m_restore(false)
+{
+}
+
+void TitleList::SetPageSize(unsigned int lines)
+{
+	m_pageSize = lines ? lines : 1;
+	Move(0);
+}
+
+bool TitleList::Refresh()
+{
+	unsigned int count = m_checked.size();
+	if (m_catalog.Count() == count)
+		return false;
+	m_checked.resize(m_catalog.Count(), 0);
+	return true;
+}
+
+void TitleList::Move(int lines)
+{
+	if (m_checked.empty())
+		return;
+	int cursor = (int)m_cursor + lines;
+	if (cursor < 0)
+		cursor = 0;
+	if (cursor >= (int)m_checked.size())
+		cursor = m_checked.size() - 1;
+	m_cursor = cursor;
+	if (m_cursor < m_top)
+		m_top = m_cursor;
+	else if (m_cursor >= m_top + m_pageSize)
+		m_top = m_cursor - m_pageSize + 1;
+}
+
+void TitleList::SetRestoreMode(bool restore)
+{
+	m_restore = restore;
+	CheckAll(false);
+}
+
+bool TitleList::Selectable(unsigned int index) const
+{
+	const CATALOG_ENTRY& entry = m_catalog.Entry(index);
+	if (m_restore)
+		return (entry.type == GOD_TYPE_UNLOCKED || entry.status == CATALOG_STATUS_UNLOCKED)
+			&& entry.status != CATALOG_STATUS_RESTORED;
+	return (entry.type == GOD_TYPE_LIVE || entry.type == GOD_TYPE_PIRS || entry.type == GOD_TYPE_BUNDLE)
+		&& entry.status != CATALOG_STATUS_UNLOCKED;
+}
+
+void TitleList::Toggle()
+{
+	if (m_cursor < m_checked.size() && (m_checked[m_cursor] || Selectable(m_cursor)))
+		m_checked[m_cursor] = !m_checked[m_cursor];
+}
+
+void TitleList::CheckAll(bool checked)
+{
+	for (unsigned int i = 0; i < m_checked.size(); i++)
+		m_checked[i] = checked && Selectable(i);
+}
+
+unsigned int TitleList::CheckedCount() const
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < m_checked.size(); i++)
+		count += m_checked[i];
+	return count;
+}
+
+void TitleList::Checked(CatalogView& view) const
+{
+	view.clear();
+	for (unsigned int i = 0; i < m_checked.size(); i++)
+	{
+		if (m_checked[i])
+			view.push_back(i);
+	}
+}
+
+wstring TitleList::Line(unsigned int index) const
+{
+	const CATALOG_ENTRY& entry = m_catalog.Entry(index);
+	wstring line = m_checked[index] ? L"[x] " : Selectable(index) ? L"[ ] " : L"    ";
+	line += m_catalog.Title(index);
+	line += L" (";
+	line += TypeNames[entry.type];
+	if (m_catalog.IsDuplicate(index))
+		line += L", duplicate";
+	line += L")";
+	line += StatusNames[entry.status];
+	return line;
+}
@@ -0,0 +1,61 @@
+#ifndef TITLELIST_H
+#define TITLELIST_H
+#include <string>
+#include <vector>
+#include "catalog.h"
+
+// Selection state behind the title list on the console: which records are
+// checked, the cursor and the first line shown. Lines are catalog records in the
+// order the scan delivered them, so the list can grow while devices are still
+// being scanned without moving anything already on screen.
+class TitleList
+{
+public:
+	TitleList(const Catalog& catalog);
+
+	// Lines shown at once, for paging and keeping the cursor in view
+	void SetPageSize(unsigned int lines);
+	unsigned int PageSize() const { return m_pageSize; }
+
+	// Takes in the records added to the catalog since the last call. Returns
+	// true if there were any.
+	bool Refresh();
+
+	unsigned int Count() const { return m_checked.size(); }
+	unsigned int Cursor() const { return m_cursor; }
+	unsigned int Top() const { return m_top; }
+
+	// Moves the cursor by lines (negative is up), scrolling to keep it in view
+	void Move(int lines);
+
+	// In restore mode the unlocked titles are the ones that can be checked.
+	// Switching mode clears the checks.
+	void SetRestoreMode(bool restore);
+	bool RestoreMode() const { return m_restore; }
+
+	// Only titles that can still be unlocked can be checked, or in restore mode
+	// titles unlocked earlier or this session that haven't been restored since
+	bool Selectable(unsigned int index) const;
+	void Toggle();
+	void CheckAll(bool checked);
+	bool IsChecked(unsigned int index) const { return m_checked[index] != 0; }
+	void Uncheck(unsigned int index) { m_checked[index] = 0; }
+	unsigned int CheckedCount() const;
+
+	// Checked records, in list order
+	void Checked(CatalogView& view) const;
+
+	// One line of the list: check box, display name, category and status
+	std::wstring Line(unsigned int index) const;
+
+private:
+	const Catalog& m_catalog;
+	std::vector<BYTE> m_checked;
+	unsigned int m_cursor;
+	unsigned int m_top;
+	unsigned int m_pageSize;
+	bool m_restore;
+
+	TitleList& operator=(const TitleList&);
+};
+#endif
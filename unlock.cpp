@@ -0,0 +1,233 @@
+#include <string.h>
+#include "unlock.h"
+
+using std::vector;
+
+static bool BackupOriginal(const PATCH_REGIONS& original, void* context)
+{
+	const UNLOCK_JOB* job = (const UNLOCK_JOB*)context;
+	return job->archive->Append(job->titleId, job->path.c_str() + job->rootLength, original);
+}
+
+UnlockExecutor::UnlockExecutor() : m_total(0)
+{
+}
+
+UnlockExecutor::~UnlockExecutor()
+{
+	for (unsigned int i = 0; i < m_workers.size(); i++)
+		delete m_workers[i];
+}
+
+void UnlockExecutor::Add(const UNLOCK_JOB& job)
+{
+	if (m_workers.size() <= (unsigned int)job.device)
+		m_workers.resize(job.device + 1, NULL);
+	if (m_workers[job.device] == NULL)
+	{
+		m_workers[job.device] = new DEVICE_WORKER;
+		m_workers[job.device]->next = 0;
+		m_workers[job.device]->threaded = false;
+	}
+	m_workers[job.device]->jobs.push_back(job);
+	m_total++;
+}
+
+static UNLOCK_RESULT RunJob(const UNLOCK_JOB* job)
+{
+	UNLOCK_RESULT result;
+	result.index = job->index;
+	result.device = job->device;
+	unsigned long start = TickCount();
+	result.result = PatchHeader(job->path.c_str(), job->setLicense, job->archive ? BackupOriginal : NULL, (void*)job);
+	result.elapsedMs = TickCount() - start;
+	return result;
+}
+
+// Runs a group of jobs from one device into results, in order
+static void RunGroup(UNLOCK_JOB** jobs, unsigned int count, UNLOCK_RESULT* results)
+{
+	PatchJournal* journal = jobs[0]->journal;
+	if (journal == NULL)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			results[i] = RunJob(jobs[i]);
+		return;
+	}
+
+	unsigned long start = TickCount();
+	vector<JOURNAL_ENTRY> entries;
+	unsigned int journaled[UNLOCK_GROUP_SIZE];
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const UNLOCK_JOB* job = jobs[i];
+		results[i].index = job->index;
+		results[i].device = job->device;
+		JOURNAL_ENTRY entry;
+		results[i].result = ReadHeaderRegions(job->path.c_str(), &entry.original);
+		if (results[i].result == PATCH_OK && IsUnlockedRegions(entry.original))
+			results[i].result = PATCH_ALREADY_UNLOCKED;
+		if (results[i].result != PATCH_OK)
+			continue;
+		entry.titleId = job->titleId;
+		entry.path = job->path.c_str() + job->rootLength;
+		BuildPatchRegions(&entry.patched, job->setLicense);
+		journaled[entries.size()] = i;
+		entries.push_back(entry);
+	}
+
+	DWORD sequence;
+	if (!entries.empty() && !journal->Begin(entries, &sequence))
+	{
+		for (unsigned int j = 0; j < entries.size(); j++)
+			results[journaled[j]].result = PATCH_BACKUP_FAILED;
+		entries.clear();
+	}
+
+	// Backup records go out unflushed; the journal already holds the originals
+	BackupArchive* archive = jobs[0]->archive;
+	bool torn = false;	// A package may hold part of its patch
+	for (unsigned int j = 0; j < entries.size(); j++)
+	{
+		const JOURNAL_ENTRY& entry = entries[j];
+		UNLOCK_RESULT& result = results[journaled[j]];
+		if (archive && !archive->Append(entry.titleId, entry.path.c_str(), entry.original, false))
+		{
+			result.result = PATCH_BACKUP_FAILED;
+			continue;
+		}
+		PATCH_REGIONS verify;
+		result.result = WriteHeaderRegions(jobs[journaled[j]]->path.c_str(), entry.patched, &verify);
+		if (result.result == PATCH_OK && memcmp(&verify, &entry.patched, sizeof(verify)) != 0)
+			result.result = PATCH_WRITE_FAILED;
+
+		// A failed write may have landed in part, so the original goes straight back
+		if (result.result != PATCH_OK)
+		{
+			PATCH_REGIONS restored;
+			if (WriteHeaderRegions(jobs[journaled[j]]->path.c_str(), entry.original, &restored) != PATCH_OK
+				|| memcmp(&restored, &entry.original, sizeof(restored)) != 0)
+				torn = true;
+		}
+	}
+
+	// Left uncommitted if the records didn't make it, so the next start re-appends
+	// them, or if a package couldn't be put back, so the next start rolls it back
+	if (!entries.empty() && !torn && (archive == NULL || archive->Flush()))
+		journal->Commit(sequence);
+
+	unsigned long elapsed = (TickCount() - start) / count;
+	for (unsigned int i = 0; i < count; i++)
+		results[i].elapsedMs = elapsed;
+}
+
+void UnlockExecutor::WorkerProc(void* param)
+{
+	DEVICE_WORKER* worker = (DEVICE_WORKER*)param;
+	for (;;)
+	{
+		// A NULL job tells the worker its device is done
+		UNLOCK_JOB* group[UNLOCK_GROUP_SIZE];
+		group[0] = worker->queue->Pop();
+		if (group[0] == NULL)
+			return;
+
+		// Whatever else is already waiting joins the group, without waiting for more
+		unsigned int count = 1;
+		bool last = false;
+		while (count < UNLOCK_GROUP_SIZE && !last && worker->queue->Pop(&group[count], 0))
+		{
+			if (group[count] == NULL)
+				last = true;
+			else
+				count++;
+		}
+
+		UNLOCK_RESULT results[UNLOCK_GROUP_SIZE];
+		RunGroup(group, count, results);
+		for (unsigned int i = 0; i < count; i++)
+			worker->results->Push(results[i]);
+		if (last)
+			return;
+	}
+}
+
+unsigned int UnlockExecutor::Run(UNLOCK_RESULT_CALLBACK onResult, void* context)
+{
+	// Results aren't bounded by what is in flight: a worker frees a job slot as it
+	// starts a group, so it can keep finishing jobs while this thread is busy in
+	// onResult. When the queue fills the worker blocks in Push until this thread
+	// drains it. That can't deadlock because this thread only ever TryPushes jobs
+	// and waits on results with a timeout, so it always comes back to drain them.
+	unsigned int devices = 0;
+	for (unsigned int i = 0; i < m_workers.size(); i++)
+		devices += m_workers[i] != NULL;
+	BoundedQueue<UNLOCK_RESULT> results(devices * (UNLOCK_QUEUE_DEPTH + UNLOCK_GROUP_SIZE));
+
+	for (unsigned int i = 0; i < m_workers.size(); i++)
+	{
+		DEVICE_WORKER* worker = m_workers[i];
+		if (worker == NULL)
+			continue;
+		worker->queue = new BoundedQueue<UNLOCK_JOB*>(UNLOCK_QUEUE_DEPTH);
+		worker->results = &results;
+		worker->threaded = StartThread(WorkerProc, worker, &worker->thread);
+	}
+
+	unsigned int done = 0;
+	unsigned int failed = 0;
+	while (done < m_total)
+	{
+		UNLOCK_RESULT finished[UNLOCK_GROUP_SIZE];
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < m_workers.size() && count == 0; i++)
+		{
+			DEVICE_WORKER* worker = m_workers[i];
+			if (worker == NULL || worker->next == worker->jobs.size())
+				continue;
+			if (worker->threaded)
+			{
+				while (worker->next < worker->jobs.size() && worker->queue->TryPush(&worker->jobs[worker->next]))
+					worker->next++;
+			}
+			else
+			{
+				// A device that didn't get a thread is worked from this one, a group per pass
+				UNLOCK_JOB* group[UNLOCK_GROUP_SIZE];
+				while (count < UNLOCK_GROUP_SIZE && worker->next < worker->jobs.size())
+					group[count++] = &worker->jobs[worker->next++];
+				RunGroup(group, count, finished);
+			}
+		}
+
+		// A result frees a slot in its device's queue, so this is also the wait for room
+		if (count == 0 && results.Pop(&finished[0], 50))
+			count = 1;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			done++;
+			if (finished[i].result != PATCH_OK && finished[i].result != PATCH_ALREADY_UNLOCKED)
+				failed++;
+			if (onResult)
+				onResult(finished[i], done, m_total, context);
+		}
+	}
+
+	for (unsigned int i = 0; i < m_workers.size(); i++)
+	{
+		DEVICE_WORKER* worker = m_workers[i];
+		if (worker == NULL)
+			continue;
+		if (worker->threaded)
+		{
+			worker->queue->Push(NULL);
+			JoinThread(worker->thread);
+		}
+		delete worker->queue;
+		worker->queue = NULL;
+		worker->jobs.clear();
+		worker->next = 0;
+	}
+	m_total = 0;
+	return failed;
+}
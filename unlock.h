@@ -0,0 +1,83 @@
+#ifndef UNLOCK_H
+#define UNLOCK_H
+#include <string>
+#include <vector>
+#include "backup.h"
+#include "journal.h"
+#include "patch.h"
+#include "queue.h"
+
+#define UNLOCK_QUEUE_DEPTH	4	// Jobs handed to a device worker ahead of the one it's on
+#define UNLOCK_GROUP_SIZE	4	// Most jobs a worker journals and flushes together
+
+struct UNLOCK_JOB
+{
+	unsigned int index;		// Catalog record, passed back in the result
+	int device;
+	std::string path;		// Header package
+	unsigned int rootLength;	// Length of the device root at the start of path
+	DWORD titleId;
+	bool setLicense;
+	BackupArchive* archive;	// The device's archive, or NULL for no backup
+	PatchJournal* journal;	// The device's journal, or NULL to patch each package on its own
+};
+
+struct UNLOCK_RESULT
+{
+	unsigned int index;
+	int device;
+	PATCH_RESULT result;
+	unsigned long elapsedMs;
+};
+
+// Called on the thread running the executor as each job finishes, with the
+// number of jobs done so far
+typedef void (*UNLOCK_RESULT_CALLBACK)(const UNLOCK_RESULT& result, unsigned int done, unsigned int total, void* context);
+
+// Unlocks a batch of packages with one I/O worker per device. Devices sit on
+// separate buses, so a slow USB stick only holds up its own packages. Each
+// worker is fed through a small bounded queue, and the feeding thread never
+// waits on a full one: it tops up whichever queues have room and spends the
+// rest of its time passing results back. Each device's backup archive and
+// journal are only ever touched by that device's worker.
+//
+// With a journal, a worker takes whatever jobs are already queued (up to
+// UNLOCK_GROUP_SIZE) as a group: one journal append holds the whole group's
+// original and new bytes, the packages are patched, the group's backup records
+// are flushed together and a commit closes it, so crash safety costs two
+// sequential appends per group rather than a flush per package.
+class UnlockExecutor
+{
+public:
+	UnlockExecutor();
+	~UnlockExecutor();
+
+	// Queues a job for Run. Jobs on a device run in the order they were added.
+	void Add(const UNLOCK_JOB& job);
+	unsigned int Count() const { return m_total; }
+
+	// Runs every job added, calling onResult here on the calling thread for
+	// each one as it finishes. Returns how many failed; a package found to be
+	// already unlocked is reported but not counted as a failure.
+	unsigned int Run(UNLOCK_RESULT_CALLBACK onResult, void* context);
+
+private:
+	struct DEVICE_WORKER
+	{
+		std::vector<UNLOCK_JOB> jobs;
+		unsigned int next;	// First job not yet queued
+		BoundedQueue<UNLOCK_JOB*>* queue;
+		BoundedQueue<UNLOCK_RESULT>* results;
+		THREAD_HANDLE thread;
+		bool threaded;
+	};
+
+	static void WorkerProc(void* param);
+
+	std::vector<DEVICE_WORKER*> m_workers;	// By device, NULL if it has no jobs
+	unsigned int m_total;
+
+	UnlockExecutor(const UnlockExecutor&);
+	UnlockExecutor& operator=(const UnlockExecutor&);
+};
+#endif
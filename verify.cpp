@@ -0,0 +1,446 @@
+#include <string.h>
+#include <string>
+#include <vector>
+#include "queue.h"
+#include "stfs.h"
+#include "svod.h"
+#include "verify.h"
+
+using std::string;
+using std::vector;
+
+static void PutBE(vector<unsigned char>& out, unsigned long long value, int bytes)
+{
+	for (int i = bytes - 1; i >= 0; i--)
+		out.push_back((unsigned char)(value >> (i * 8)));
+}
+
+static bool GetBE(const unsigned char*& p, const unsigned char* end, int bytes, unsigned long long* value)
+{
+	if (end - p < bytes)
+		return false;
+	*value = 0;
+	for (int i = 0; i < bytes; i++)
+		*value = (*value << 8) | *p++;
+	return true;
+}
+
+static void PutCheckpoint(vector<unsigned char>& out, const string& part, const VERIFY_CHECKPOINT& checkpoint)
+{
+	PutBE(out, part.length(), 2);
+	out.insert(out.end(), part.begin(), part.end());
+	PutBE(out, checkpoint.size, 8);
+	PutBE(out, checkpoint.lastWrite, 8);
+	out.insert(out.end(), checkpoint.masterHash, checkpoint.masterHash + SHA1_DIGEST_SIZE);
+}
+
+VerifyCheckpoints::VerifyCheckpoints() : m_file(NULL), m_size(0)
+{
+}
+
+VerifyCheckpoints::~VerifyCheckpoints()
+{
+	Close();
+}
+
+bool VerifyCheckpoints::Open(const char* file)
+{
+	Close();
+	ScopedLock lock(m_lock);
+
+	// Later records for a part replace earlier ones, a torn last record is dropped
+	vector<char> buffer;
+	if (VfsReadFile(file, buffer) && !buffer.empty())
+	{
+		const unsigned char* p = (const unsigned char*)&buffer[0];
+		const unsigned char* end = p + buffer.size();
+		unsigned long long magic, version;
+		if (GetBE(p, end, 4, &magic) && GetBE(p, end, 4, &version)
+			&& magic == VERIFY_CHECKPOINT_MAGIC && version == VERIFY_CHECKPOINT_VERSION)
+		{
+			unsigned long long pathLen;
+			while (GetBE(p, end, 2, &pathLen) && end - p >= (long)pathLen)
+			{
+				string part((const char*)p, (size_t)pathLen);
+				p += pathLen;
+				VERIFY_CHECKPOINT checkpoint;
+				if (!GetBE(p, end, 8, &checkpoint.size) || !GetBE(p, end, 8, &checkpoint.lastWrite) || end - p < SHA1_DIGEST_SIZE)
+					break;
+				memcpy(checkpoint.masterHash, p, SHA1_DIGEST_SIZE);
+				p += SHA1_DIGEST_SIZE;
+				m_parts[part] = checkpoint;
+			}
+		}
+	}
+
+	vector<unsigned char> out;
+	PutBE(out, VERIFY_CHECKPOINT_MAGIC, 4);
+	PutBE(out, VERIFY_CHECKPOINT_VERSION, 4);
+	for (CheckpointMap::iterator it = m_parts.begin(); it != m_parts.end(); ++it)
+		PutCheckpoint(out, it->first, it->second);
+	m_file = VfsOpen(file, VFS_CREATE);
+	if (m_file == NULL || !m_file->Write(0, &out[0], out.size()) || !m_file->Flush())
+	{
+		delete m_file;
+		m_file = NULL;
+		return false;
+	}
+	m_size = out.size();
+	return true;
+}
+
+void VerifyCheckpoints::Close()
+{
+	ScopedLock lock(m_lock);
+	delete m_file;
+	m_file = NULL;
+	m_size = 0;
+	m_parts.clear();
+}
+
+bool VerifyCheckpoints::Lookup(const string& part, unsigned long long size, unsigned long long lastWrite, const unsigned char* masterHash)
+{
+	ScopedLock lock(m_lock);
+	CheckpointMap::const_iterator it = m_parts.find(part);
+	return it != m_parts.end() && it->second.size == size && it->second.lastWrite == lastWrite
+		&& memcmp(it->second.masterHash, masterHash, SHA1_DIGEST_SIZE) == 0;
+}
+
+bool VerifyCheckpoints::Record(const string& part, unsigned long long size, unsigned long long lastWrite, const unsigned char* masterHash)
+{
+	VERIFY_CHECKPOINT checkpoint;
+	checkpoint.size = size;
+	checkpoint.lastWrite = lastWrite;
+	memcpy(checkpoint.masterHash, masterHash, SHA1_DIGEST_SIZE);
+
+	ScopedLock lock(m_lock);
+	m_parts[part] = checkpoint;
+	if (m_file == NULL)
+		return false;
+	vector<unsigned char> out;
+	PutCheckpoint(out, part, checkpoint);
+	if (!m_file->Write(m_size, &out[0], out.size()) || !m_file->Flush())
+		return false;
+	m_size += out.size();
+	return true;
+}
+
+// One hash group on its way from the disk to a worker
+struct VERIFY_JOB
+{
+	BYTE* buffer;			// Sub hash block followed by its data blocks
+	DWORD blocks;			// Data blocks in this group
+	DWORD part;
+	DWORD group;
+	BYTE expected[SHA1_DIGEST_SIZE];	// Sub hash block's hash from the master block
+};
+
+// What a part needs to be checkpointed once all of its groups have been hashed
+struct VERIFY_PART
+{
+	string path;
+	unsigned long long size;
+	unsigned long long lastWrite;
+	BYTE masterHash[SHA1_DIGEST_SIZE];
+	DWORD outstanding;		// Groups queued but not yet hashed
+	bool queued;			// Every group of the part has been queued
+};
+
+struct VERIFY_STATE
+{
+	BoundedQueue<VERIFY_JOB*>* work;
+	BoundedQueue<VERIFY_JOB*>* idle;
+	CriticalSection lock;
+	VERIFY_REPORT* report;
+	volatile bool failed;
+	VerifyCheckpoints* checkpoints;
+	vector<VERIFY_PART> parts;
+	unsigned long long skipped;		// Bytes of the parts taken from checkpoints
+};
+
+// Caller holds the lock. Records the part once its last group is done, unless
+// a failure at or before it has been seen.
+static void CheckpointPart(VERIFY_STATE* state, DWORD part)
+{
+	VERIFY_PART& info = state->parts[part];
+	if (state->checkpoints == NULL || !info.queued || info.outstanding != 0)
+		return;
+	if (state->failed && state->report->part <= part)
+		return;
+	state->checkpoints->Record(info.path, info.size, info.lastWrite, info.masterHash);
+}
+
+// Keeps the earliest failure: workers finish groups out of order
+static void RecordFailure(VERIFY_STATE* state, VERIFY_RESULT result, DWORD part, unsigned long long offset, DWORD block)
+{
+	ScopedLock lock(state->lock);
+	VERIFY_REPORT* report = state->report;
+	if (state->failed && (report->part < part || (report->part == part && report->offset <= offset)))
+		return;
+	report->result = result;
+	report->part = part;
+	report->offset = offset;
+	report->block = block;
+	state->failed = true;
+}
+
+// True once a failure at or before this group has been recorded, so hashing it can't change the report
+static bool Superseded(VERIFY_STATE* state, VERIFY_JOB* job)
+{
+	if (!state->failed)
+		return false;
+	unsigned long long groupOffset = SVOD_BLOCK_SIZE + (unsigned long long)job->group * SVOD_GROUP_SIZE;
+	ScopedLock lock(state->lock);
+	return state->report->part < job->part || (state->report->part == job->part && state->report->offset < groupOffset);
+}
+
+static void VerifyGroup(VERIFY_STATE* state, VERIFY_JOB* job)
+{
+	unsigned long long groupOffset = SVOD_BLOCK_SIZE + (unsigned long long)job->group * SVOD_GROUP_SIZE;
+	BYTE digest[SHA1_DIGEST_SIZE];
+	Sha1(job->buffer, SVOD_BLOCK_SIZE, digest);
+	if (memcmp(digest, job->expected, sizeof(digest)) != 0)
+	{
+		RecordFailure(state, VERIFY_HASH_MISMATCH, job->part, groupOffset, VERIFY_HASH_BLOCK);
+		return;
+	}
+
+	const BYTE* hashes = job->buffer;
+	for (DWORD i = 0; i < job->blocks; i++)
+	{
+		const BYTE* block = job->buffer + (1 + i) * SVOD_BLOCK_SIZE;
+		Sha1(block, SVOD_BLOCK_SIZE, digest);
+		if (memcmp(digest, hashes + i * SHA1_DIGEST_SIZE, sizeof(digest)) != 0)
+		{
+			RecordFailure(state, VERIFY_HASH_MISMATCH, job->part, groupOffset + (1 + i) * SVOD_BLOCK_SIZE,
+				job->part * SVOD_BLOCKS_PER_PART + job->group * SVOD_BLOCKS_PER_GROUP + i);
+			return;
+		}
+	}
+}
+
+static void VerifyWorker(void* param)
+{
+	VERIFY_STATE* state = (VERIFY_STATE*)param;
+	for (;;)
+	{
+		// A NULL job tells the worker to finish
+		VERIFY_JOB* job = state->work->Pop();
+		if (job == NULL)
+			return;
+		if (!Superseded(state, job))
+			VerifyGroup(state, job);
+		{
+			ScopedLock lock(state->lock);
+			state->parts[job->part].outstanding--;
+			CheckpointPart(state, job->part);
+		}
+		state->idle->Push(job);
+	}
+}
+
+// Reads one part's master block, checks it against the hash its predecessor (or
+// the header) recorded, then queues its groups unless a checkpoint says the part
+// is unchanged since it last verified. expected is replaced with the next part's
+// master hash.
+static bool ReadPart(VERIFY_STATE* state, DWORD part, bool last, BYTE* expected,
+	unsigned long long* done, unsigned long long total, VERIFY_PROGRESS_CALLBACK progress, void* context)
+{
+	VERIFY_PART& info = state->parts[part];
+	VfsFile* file = VfsOpen(info.path.c_str(), VFS_READ);
+	if (file == NULL)
+	{
+		RecordFailure(state, VERIFY_MISSING_PART, part, 0, VERIFY_HASH_BLOCK);
+		return false;
+	}
+	// Every part but the last is full size, and all of them are whole blocks
+	unsigned long long size = file->Size();
+	if (size < SVOD_BLOCK_SIZE * 3 || size % SVOD_BLOCK_SIZE != 0 || size > SVOD_PART_SIZE || (!last && size != SVOD_PART_SIZE))
+	{
+		delete file;
+		RecordFailure(state, VERIFY_MISSING_PART, part, 0, VERIFY_HASH_BLOCK);
+		return false;
+	}
+
+	BYTE master[SVOD_BLOCK_SIZE];
+	BYTE digest[SHA1_DIGEST_SIZE];
+	if (!VfsReadExact(file, 0, master, sizeof(master)))
+	{
+		delete file;
+		RecordFailure(state, VERIFY_READ_FAILED, part, 0, VERIFY_HASH_BLOCK);
+		return false;
+	}
+	Sha1(master, sizeof(master), digest);
+	if (memcmp(digest, expected, sizeof(digest)) != 0)
+	{
+		delete file;
+		RecordFailure(state, VERIFY_HASH_MISMATCH, part, 0, VERIFY_HASH_BLOCK);
+		return false;
+	}
+	memcpy(expected, master + SVOD_NEXT_PART_HASH_OFFSET, SHA1_DIGEST_SIZE);
+	memcpy(info.masterHash, digest, sizeof(digest));
+	info.size = size;
+	*done += SVOD_BLOCK_SIZE;
+
+	if (state->checkpoints && state->checkpoints->Lookup(info.path, size, info.lastWrite, digest))
+	{
+		delete file;
+		state->report->partsSkipped++;
+		*done += size - SVOD_BLOCK_SIZE;
+		state->skipped += size - SVOD_BLOCK_SIZE;
+		if (progress)
+			progress(*done, total, context);
+		return true;
+	}
+
+	bool ok = true;
+	for (DWORD group = 0; ok && !state->failed; group++)
+	{
+		unsigned long long offset = SVOD_BLOCK_SIZE + (unsigned long long)group * SVOD_GROUP_SIZE;
+		if (offset + 2 * SVOD_BLOCK_SIZE > size)
+			break;
+		unsigned long long blocks = (size - offset) / SVOD_BLOCK_SIZE - 1;
+
+		VERIFY_JOB* job = state->idle->Pop();
+		{
+			ScopedLock lock(state->lock);
+			info.outstanding++;
+		}
+		job->part = part;
+		job->group = group;
+		job->blocks = blocks < SVOD_BLOCKS_PER_GROUP ? (DWORD)blocks : SVOD_BLOCKS_PER_GROUP;
+		memcpy(job->expected, master + group * SHA1_DIGEST_SIZE, SHA1_DIGEST_SIZE);
+		DWORD length = (1 + job->blocks) * SVOD_BLOCK_SIZE;
+		if (!VfsReadExact(file, offset, job->buffer, length))
+		{
+			{
+				ScopedLock lock(state->lock);
+				info.outstanding--;
+			}
+			state->idle->Push(job);
+			RecordFailure(state, VERIFY_READ_FAILED, part, offset, VERIFY_HASH_BLOCK);
+			ok = false;
+			break;
+		}
+		state->work->Push(job);
+		*done += length;
+		if (progress)
+			progress(*done, total, context);
+	}
+	delete file;
+	if (ok)
+	{
+		// The workers may already have finished every group
+		ScopedLock lock(state->lock);
+		info.queued = true;
+		CheckpointPart(state, part);
+	}
+	return ok && !state->failed;
+}
+
+VERIFY_RESULT VerifyGOD(const char* headerPath, unsigned int threads, VERIFY_REPORT* report,
+	VerifyCheckpoints* checkpoints, VERIFY_PROGRESS_CALLBACK progress, void* context)
+{
+	memset(report, 0, sizeof(VERIFY_REPORT));
+	unsigned long start = TickCount();
+
+	BYTE page[SVOD_BLOCK_SIZE];
+	DWORD read = 0;
+	VfsFile* headerFile = VfsOpen(headerPath, VFS_READ);
+	if (headerFile)
+	{
+		if (!headerFile->Read(0, page, sizeof(page), &read))
+			read = 0;
+		delete headerFile;
+	}
+	StfsHeaderView header(page, read);
+	DWORD parts = header.Get<STFS_DATA_FILE_COUNT>();
+	if (!header.Has<STFS_DESCRIPTOR_TYPE_FIELD>() || header.Get<STFS_DESCRIPTOR_TYPE_FIELD>() != STFS_DESCRIPTOR_SVOD || parts == 0)
+	{
+		report->result = VERIFY_BAD_HEADER;
+		return report->result;
+	}
+	// Groups are walked from the first block of Data0000, as every package this
+	// tool writes lays them out
+	if (header.Get<STFS_SVOD_DATA_BLOCK_OFFSET>() != 0)
+	{
+		report->result = VERIFY_UNSUPPORTED;
+		return report->result;
+	}
+	unsigned long long total = header.Get<STFS_DATA_FILE_SIZE>();
+
+	// Enough buffers for every worker to have one while the next is read
+	if (threads == 0)
+		threads = 1;
+	unsigned int buffers = threads + 2;
+	BoundedQueue<VERIFY_JOB*> work(buffers + threads);
+	BoundedQueue<VERIFY_JOB*> idle(buffers);
+	vector<VERIFY_JOB> jobs(buffers);
+	vector<BYTE> memory((size_t)buffers * SVOD_GROUP_SIZE);
+	for (unsigned int i = 0; i < buffers; i++)
+	{
+		jobs[i].buffer = &memory[(size_t)i * SVOD_GROUP_SIZE];
+		idle.Push(&jobs[i]);
+	}
+
+	VERIFY_STATE state;
+	state.work = &work;
+	state.idle = &idle;
+	state.report = report;
+	state.failed = false;
+	state.checkpoints = checkpoints;
+	state.skipped = 0;
+
+	// One listing of the .data folder gives every part's last write time
+	vector<VFS_ENTRY> listing;
+	VfsList((string(headerPath) + ".data").c_str(), listing);
+	state.parts.resize(parts);
+	for (DWORD part = 0; part < parts; part++)
+	{
+		VERIFY_PART& info = state.parts[part];
+		info.path = SvodPartPath(headerPath, part);
+		info.size = 0;
+		info.lastWrite = 0;
+		info.outstanding = 0;
+		info.queued = false;
+		string name = info.path.substr(info.path.rfind('\\') + 1);
+		for (unsigned int i = 0; i < listing.size(); i++)
+		{
+			if (_stricmp(listing[i].name.c_str(), name.c_str()) == 0)
+				info.lastWrite = listing[i].lastWrite;
+		}
+	}
+
+	vector<THREAD_HANDLE> handles;
+	for (unsigned int i = 0; i < threads; i++)
+	{
+		THREAD_HANDLE handle;
+		if (StartThread(VerifyWorker, &state, &handle))
+			handles.push_back(handle);
+	}
+	if (handles.empty())
+	{
+		report->result = VERIFY_READ_FAILED;
+		return report->result;
+	}
+
+	BYTE expected[SHA1_DIGEST_SIZE];
+	memcpy(expected, header.Get<STFS_SVOD_ROOT_HASH>(), sizeof(expected));
+	unsigned long long done = 0;
+	for (DWORD part = 0; part < parts; part++)
+	{
+		if (!ReadPart(&state, part, part + 1 == parts, expected, &done, total, progress, context))
+			break;
+	}
+
+	for (unsigned int i = 0; i < handles.size(); i++)
+		work.Push(NULL);
+	for (unsigned int i = 0; i < handles.size(); i++)
+		JoinThread(handles[i]);
+
+	report->bytes = done - state.skipped;
+	report->elapsedMs = TickCount() - start;
+	if (!state.failed)
+		report->result = VERIFY_OK;
+	return report->result;
+}
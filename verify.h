@@ -0,0 +1,84 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+#include <map>
+#include <string>
+#include "sha1.h"
+#include "thread.h"
+#include "vfs.h"
+
+#define VERIFY_HASH_BLOCK			0xFFFFFFFF	// VERIFY_REPORT::block when a hash block itself is bad
+#define VERIFY_CHECKPOINT_MAGIC		0x4756434B	// GVCK
+#define VERIFY_CHECKPOINT_VERSION	1
+
+enum VERIFY_RESULT
+{
+	VERIFY_OK = 0,
+	VERIFY_BAD_HEADER,		// Header unreadable or not an SVOD package
+	VERIFY_MISSING_PART,	// A data part named in the header is missing or the wrong size
+	VERIFY_READ_FAILED,		// A data part couldn't be read
+	VERIFY_HASH_MISMATCH,	// A block doesn't match its hash, see part/offset/block
+	VERIFY_UNSUPPORTED		// The data doesn't start at block 0, which the hash tree walk doesn't handle
+};
+
+struct VERIFY_REPORT
+{
+	VERIFY_RESULT result;
+	DWORD part;					// Part holding the first bad block (or the missing part)
+	unsigned long long offset;	// Where that block starts within the part
+	DWORD block;				// Data block number within the title, or VERIFY_HASH_BLOCK
+	unsigned long long bytes;	// Bytes read and hashed
+	unsigned long elapsedMs;
+	DWORD partsSkipped;			// Parts taken from checkpoints without hashing their data
+
+	DWORD MBps() const { return elapsedMs ? (DWORD)(bytes / 1000 / elapsedMs) : 0; }
+};
+
+struct VERIFY_CHECKPOINT
+{
+	unsigned long long size;
+	unsigned long long lastWrite;
+	unsigned char masterHash[SHA1_DIGEST_SIZE];	// Hash of the part's master block when it verified
+};
+
+// Parts that have already verified completely, keyed by path. A part is only
+// skipped while its size, last write time and master block are unchanged, and
+// its master block is still checked against the chain every run.
+//
+// The file is append-only while open: each part is written (and flushed) the
+// moment it verifies, so an interrupted run loses at most the part in flight.
+// Open compacts it to the latest record per part.
+class VerifyCheckpoints
+{
+public:
+	VerifyCheckpoints();
+	~VerifyCheckpoints();
+
+	bool Open(const char* file);
+	void Close();
+
+	bool Lookup(const std::string& part, unsigned long long size, unsigned long long lastWrite, const unsigned char* masterHash);
+	bool Record(const std::string& part, unsigned long long size, unsigned long long lastWrite, const unsigned char* masterHash);
+
+private:
+	typedef std::map<std::string, VERIFY_CHECKPOINT> CheckpointMap;
+	CheckpointMap m_parts;
+	CriticalSection m_lock;
+	VfsFile* m_file;
+	unsigned long long m_size;
+
+	VerifyCheckpoints(const VerifyCheckpoints&);
+	VerifyCheckpoints& operator=(const VerifyCheckpoints&);
+};
+
+// Called on the verifying thread after each group is queued
+typedef void (*VERIFY_PROGRESS_CALLBACK)(unsigned long long done, unsigned long long total, void* context);
+
+// Checks every data part of the GOD package at headerPath against the hash tree
+// rooted in its header. The calling thread streams whole hash groups off the disk
+// with one read each into a small pool of buffers, while threads workers hash
+// them, so reading and hashing overlap. Stops reading at the first bad block;
+// the report names the earliest one found. With checkpoints, unchanged parts
+// that verified before are skipped and newly verified parts are recorded.
+VERIFY_RESULT VerifyGOD(const char* headerPath, unsigned int threads, VERIFY_REPORT* report,
+	VerifyCheckpoints* checkpoints = NULL, VERIFY_PROGRESS_CALLBACK progress = NULL, void* context = NULL);
+#endif
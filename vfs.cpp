@@ -0,0 +1,302 @@
+#ifndef _XBOX
+#define _FILE_OFFSET_BITS 64
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "vfs.h"
+
+using std::string;
+using std::vector;
+
+#ifdef _XBOX
+class NativeFile : public VfsFile
+{
+public:
+	NativeFile(HANDLE handle) : m_handle(handle) {}
+	~NativeFile() { CloseHandle(m_handle); }
+
+	bool Read(unsigned long long offset, void* buffer, DWORD size, DWORD* read)
+	{
+		*read = 0;
+		return Seek(offset) && ReadFile(m_handle, buffer, size, read, NULL) != FALSE;
+	}
+
+	bool Write(unsigned long long offset, const void* buffer, DWORD size)
+	{
+		DWORD written;
+		return Seek(offset) && WriteFile(m_handle, buffer, size, &written, NULL) && written == size;
+	}
+
+	unsigned long long Size()
+	{
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_handle, &size))
+			return 0;
+		return size.QuadPart;
+	}
+
+	bool Flush()
+	{
+		return FlushFileBuffers(m_handle) != FALSE;
+	}
+
+private:
+	HANDLE m_handle;
+
+	bool Seek(unsigned long long offset)
+	{
+		LARGE_INTEGER position;
+		position.QuadPart = offset;
+		return SetFilePointerEx(m_handle, position, NULL, FILE_BEGIN) != FALSE;
+	}
+};
+
+class NativeFileSystem : public Vfs
+{
+public:
+	VfsFile* Open(const char* path, VFS_MODE mode)
+	{
+		static const DWORD Disposition[] = { OPEN_EXISTING, OPEN_EXISTING, CREATE_ALWAYS, OPEN_ALWAYS };
+		DWORD access = mode == VFS_READ ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE;
+		HANDLE handle = CreateFile(path, access, FILE_SHARE_READ, NULL, Disposition[mode], FILE_ATTRIBUTE_NORMAL, NULL);
+		if (handle == INVALID_HANDLE_VALUE)
+			return NULL;
+		return new NativeFile(handle);
+	}
+
+	bool List(const char* dir, vector<VFS_ENTRY>& entries)
+	{
+		string pattern = dir;
+		if (pattern.empty() || pattern[pattern.length() - 1] != '\\')
+			pattern += "\\";
+		pattern += "*";
+
+		WIN32_FIND_DATA wfd;
+		HANDLE hFind = FindFirstFile(pattern.c_str(), &wfd);
+		if (INVALID_HANDLE_VALUE == hFind)
+			return false;
+		do
+		{
+			if (strcmp(wfd.cFileName, ".") == 0 || strcmp(wfd.cFileName, "..") == 0)
+				continue;
+			VFS_ENTRY entry;
+			entry.name = wfd.cFileName;
+			entry.directory = (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+			entry.size = ((unsigned long long)wfd.nFileSizeHigh << 32) | wfd.nFileSizeLow;
+			entry.lastWrite = ((unsigned long long)wfd.ftLastWriteTime.dwHighDateTime << 32) | wfd.ftLastWriteTime.dwLowDateTime;
+			entries.push_back(entry);
+		}
+		while (FindNextFile(hFind, &wfd));
+		FindClose(hFind);
+		return true;
+	}
+
+	bool CreateDir(const char* path)
+	{
+		return CreateDirectory(path, NULL) != FALSE;
+	}
+
+	bool Remove(const char* path)
+	{
+		// Files may be marked read-only, which DeleteFile refuses
+		SetFileAttributes(path, FILE_ATTRIBUTE_NORMAL);
+		return DeleteFile(path) || RemoveDirectory(path);
+	}
+};
+#else
+// Turns the engine's '\' separators into '/'
+static string HostPath(const char* path)
+{
+	string host = path;
+	for (unsigned int i = 0; i < host.length(); i++)
+	{
+		if (host[i] == '\\')
+			host[i] = '/';
+	}
+	return host;
+}
+
+class NativeFile : public VfsFile
+{
+public:
+	NativeFile(int fd) : m_fd(fd) {}
+	~NativeFile() { close(m_fd); }
+
+	bool Read(unsigned long long offset, void* buffer, DWORD size, DWORD* read)
+	{
+		*read = 0;
+		while (*read < size)
+		{
+			ssize_t got = pread(m_fd, (char*)buffer + *read, size - *read, (off_t)(offset + *read));
+			if (got < 0 && errno == EINTR)
+				continue;
+			if (got < 0)
+				return false;
+			if (got == 0)
+				break;
+			*read += (DWORD)got;
+		}
+		return true;
+	}
+
+	bool Write(unsigned long long offset, const void* buffer, DWORD size)
+	{
+		DWORD written = 0;
+		while (written < size)
+		{
+			ssize_t put = pwrite(m_fd, (const char*)buffer + written, size - written, (off_t)(offset + written));
+			if (put < 0 && errno == EINTR)
+				continue;
+			if (put <= 0)
+				return false;
+			written += (DWORD)put;
+		}
+		return true;
+	}
+
+	unsigned long long Size()
+	{
+		struct stat st;
+		if (fstat(m_fd, &st) != 0)
+			return 0;
+		// Block devices (raw drives handed to the FATX reader) report no size
+		if (S_ISBLK(st.st_mode))
+		{
+			off_t end = lseek(m_fd, 0, SEEK_END);
+			return end < 0 ? 0 : end;
+		}
+		return st.st_size;
+	}
+
+	bool Flush()
+	{
+		return fsync(m_fd) == 0;
+	}
+
+private:
+	int m_fd;
+};
+
+class NativeFileSystem : public Vfs
+{
+public:
+	VfsFile* Open(const char* path, VFS_MODE mode)
+	{
+		static const int Flags[] = { O_RDONLY, O_RDWR, O_RDWR | O_CREAT | O_TRUNC, O_RDWR | O_CREAT };
+		int fd = open(HostPath(path).c_str(), Flags[mode], 0644);
+		if (fd < 0)
+			return NULL;
+		return new NativeFile(fd);
+	}
+
+	bool List(const char* dir, vector<VFS_ENTRY>& entries)
+	{
+		string hostDir = HostPath(dir);
+		DIR* handle = opendir(hostDir.c_str());
+		if (handle == NULL)
+			return false;
+		if (hostDir.empty() || hostDir[hostDir.length() - 1] != '/')
+			hostDir += "/";
+		while (struct dirent* found = readdir(handle))
+		{
+			if (strcmp(found->d_name, ".") == 0 || strcmp(found->d_name, "..") == 0)
+				continue;
+			struct stat st;
+			if (stat((hostDir + found->d_name).c_str(), &st) != 0)
+				continue;
+			VFS_ENTRY entry;
+			entry.name = found->d_name;
+			entry.directory = S_ISDIR(st.st_mode);
+			entry.size = st.st_size;
+			entry.lastWrite = (unsigned long long)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+			entries.push_back(entry);
+		}
+		closedir(handle);
+		return true;
+	}
+
+	bool CreateDir(const char* path)
+	{
+		return mkdir(HostPath(path).c_str(), 0755) == 0;
+	}
+
+	bool Remove(const char* path)
+	{
+		string hostPath = HostPath(path);
+		return unlink(hostPath.c_str()) == 0 || rmdir(hostPath.c_str()) == 0;
+	}
+};
+#endif
+
+struct VFS_MOUNT
+{
+	string prefix;
+	Vfs* fs;
+};
+static vector<VFS_MOUNT> Mounts;
+
+Vfs* NativeVfs()
+{
+	static NativeFileSystem native;
+	return &native;
+}
+
+void VfsMount(const char* prefix, Vfs* fs)
+{
+	VFS_MOUNT mount;
+	mount.prefix = prefix;
+	mount.fs = fs;
+	Mounts.push_back(mount);
+}
+
+Vfs* VfsFor(const char* path)
+{
+	// Device names are case-insensitive on the console, so mounts are too
+	for (unsigned int i = 0; i < Mounts.size(); i++)
+	{
+		if (_strnicmp(path, Mounts[i].prefix.c_str(), Mounts[i].prefix.length()) == 0)
+			return Mounts[i].fs;
+	}
+	return NativeVfs();
+}
+
+VfsFile* VfsOpen(const char* path, VFS_MODE mode)
+{
+	return VfsFor(path)->Open(path, mode);
+}
+
+bool VfsList(const char* dir, vector<VFS_ENTRY>& entries)
+{
+	return VfsFor(dir)->List(dir, entries);
+}
+
+bool VfsCreateDir(const char* path)
+{
+	return VfsFor(path)->CreateDir(path);
+}
+
+bool VfsRemove(const char* path)
+{
+	return VfsFor(path)->Remove(path);
+}
+
+bool VfsReadFile(const char* path, vector<char>& data)
+{
+	VfsFile* file = VfsOpen(path, VFS_READ);
+	if (file == NULL)
+		return false;
+	unsigned long long size = file->Size();
+	data.resize((size_t)size);
+	bool read = size == 0 || VfsReadExact(file, 0, &data[0], (DWORD)size);
+	delete file;
+	return read;
+}
+
+bool VfsReadExact(VfsFile* file, unsigned long long offset, void* buffer, DWORD size)
+{
+	DWORD read;
+	return file->Read(offset, buffer, size, &read) && read == size;
+}
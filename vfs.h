@@ -0,0 +1,69 @@
+#ifndef VFS_H
+#define VFS_H
+#include <string>
+#include <vector>
+#include "platform.h"
+
+// Paths use '\' separators throughout the engine, as they do on the console.
+// The POSIX backend translates them, so "/mnt/usb\Content\..." resolves normally.
+
+enum VFS_MODE
+{
+	VFS_READ = 0,		// Existing file, read only
+	VFS_READWRITE,		// Existing file, read and write
+	VFS_CREATE,			// Created or truncated, read and write
+	VFS_OPEN_ALWAYS		// Opened or created without truncating, read and write
+};
+
+struct VFS_ENTRY
+{
+	std::string name;
+	bool directory;
+	unsigned long long size;
+	unsigned long long lastWrite;	// Backend specific, only ever compared for equality
+};
+
+// An open file. There is no file pointer: every read and write names its offset.
+// A handle may be used by one thread at a time. Deleting it closes the file.
+class VfsFile
+{
+public:
+	virtual ~VfsFile() {}
+	// read receives the byte count, which is short only at the end of the file
+	virtual bool Read(unsigned long long offset, void* buffer, DWORD size, DWORD* read) = 0;
+	virtual bool Write(unsigned long long offset, const void* buffer, DWORD size) = 0;
+	virtual unsigned long long Size() = 0;
+	virtual bool Flush() = 0;
+};
+
+class Vfs
+{
+public:
+	virtual ~Vfs() {}
+	virtual VfsFile* Open(const char* path, VFS_MODE mode) = 0;
+	// Lists dir without the . and .. entries
+	virtual bool List(const char* dir, std::vector<VFS_ENTRY>& entries) = 0;
+	virtual bool CreateDir(const char* path) = 0;
+	virtual bool Remove(const char* path) = 0;
+};
+
+// The local filesystem: Win32 on the console, POSIX on the host
+Vfs* NativeVfs();
+
+// Routes every path starting with prefix to fs, e.g. a FATX image mounted as
+// "img0:". Anything unmatched goes to NativeVfs. Mount before scanning starts.
+void VfsMount(const char* prefix, Vfs* fs);
+Vfs* VfsFor(const char* path);
+
+// Shorthands that pick the backend from the path
+VfsFile* VfsOpen(const char* path, VFS_MODE mode);
+bool VfsList(const char* dir, std::vector<VFS_ENTRY>& entries);
+bool VfsCreateDir(const char* path);
+bool VfsRemove(const char* path);
+
+// Reads a whole file with one call. False if it's missing or unreadable.
+bool VfsReadFile(const char* path, std::vector<char>& data);
+
+// Reads exactly size bytes at offset, failing on a short read
+bool VfsReadExact(VfsFile* file, unsigned long long offset, void* buffer, DWORD size);
+#endif
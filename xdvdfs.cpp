@@ -0,0 +1,197 @@
+#include <string.h>
+#include <set>
+#include "xdvdfs.h"
+
+using std::string;
+using std::vector;
+
+// Where the game partition starts in each kind of image: an extracted partition,
+// then XGD2, XGD3 and original Xbox discs
+static const unsigned long long PartitionOffsets[] = { 0, 0xFD90000ULL, 0x2080000ULL, 0x18300000ULL };
+
+static DWORD GetLE16(const BYTE* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static DWORD GetLE32(const BYTE* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+XdvdfsImage::XdvdfsImage() : m_file(NULL), m_partition(0), m_size(0)
+{
+	m_root.sector = 0;
+	m_root.size = 0;
+	m_root.attributes = XDVDFS_ATTRIBUTE_DIRECTORY;
+}
+
+bool XdvdfsImage::Open(VfsFile* file)
+{
+	m_file = file;
+	unsigned long long fileSize = file->Size();
+	for (unsigned int i = 0; i < sizeof(PartitionOffsets) / sizeof(PartitionOffsets[0]); i++)
+	{
+		unsigned long long offset = PartitionOffsets[i];
+		BYTE volume[XDVDFS_SECTOR_SIZE];
+		if (offset + (XDVDFS_VOLUME_SECTOR + 1) * XDVDFS_SECTOR_SIZE > fileSize
+			|| !VfsReadExact(file, offset + XDVDFS_VOLUME_SECTOR * XDVDFS_SECTOR_SIZE, volume, sizeof(volume)))
+			continue;
+		// The magic appears at both ends of the descriptor
+		if (memcmp(volume, XDVDFS_MAGIC, XDVDFS_MAGIC_SIZE) != 0
+			|| memcmp(volume + XDVDFS_SECTOR_SIZE - XDVDFS_MAGIC_SIZE, XDVDFS_MAGIC, XDVDFS_MAGIC_SIZE) != 0)
+			continue;
+		m_partition = offset;
+		m_size = fileSize - offset;
+		m_root.sector = GetLE32(volume + 0x14);
+		m_root.size = GetLE32(volume + 0x18);
+		return true;
+	}
+	m_file = NULL;
+	return false;
+}
+
+bool XdvdfsImage::List(const XDVDFS_ENTRY& dir, vector<XDVDFS_ENTRY>& entries)
+{
+	entries.clear();
+	if (m_file == NULL || !dir.IsDirectory())
+		return false;
+	if (dir.size == 0)
+		return true;
+	if ((unsigned long long)dir.sector * XDVDFS_SECTOR_SIZE + dir.size > m_size)
+		return false;
+
+	vector<BYTE> table(dir.size);
+	if (!VfsReadExact(m_file, m_partition + (unsigned long long)dir.sector * XDVDFS_SECTOR_SIZE, &table[0], dir.size))
+		return false;
+
+	// Entries form a binary tree whose links count 4 byte units from the start of
+	// the table. An in-order walk gives them sorted. Sector padding reads as 0xFFFF.
+	if (GetLE16(&table[0]) == 0xFFFF)
+		return true;
+	vector<DWORD> pending;
+	DWORD next = 0;
+	bool descend = true;
+	unsigned int limit = dir.size / XDVDFS_DIRENT_MIN_SIZE + 1;
+	for (;;)
+	{
+		while (descend)
+		{
+			if (next + XDVDFS_DIRENT_MIN_SIZE > dir.size || pending.size() > limit)
+				return false;
+			pending.push_back(next);
+			DWORD left = GetLE16(&table[next]);
+			if (left == 0 || left == 0xFFFF)
+				break;
+			next = left * 4;
+		}
+		if (pending.empty())
+			return true;
+		DWORD offset = pending.back();
+		pending.pop_back();
+
+		const BYTE* p = &table[offset];
+		XDVDFS_ENTRY entry;
+		entry.sector = GetLE32(p + 4);
+		entry.size = GetLE32(p + 8);
+		entry.attributes = p[12];
+		DWORD nameLength = p[13];
+		if (offset + XDVDFS_DIRENT_MIN_SIZE + nameLength > dir.size || entries.size() > limit)
+			return false;
+		entry.name.assign((const char*)p + XDVDFS_DIRENT_MIN_SIZE, nameLength);
+		entries.push_back(entry);
+
+		DWORD right = GetLE16(p + 2);
+		descend = right != 0 && right != 0xFFFF;
+		if (descend)
+			next = right * 4;
+	}
+}
+
+bool XdvdfsImage::Find(const char* path, XDVDFS_ENTRY* entry)
+{
+	XDVDFS_ENTRY current = m_root;
+	string remaining = path;
+	while (!remaining.empty())
+	{
+		string::size_type slash = remaining.find('\\');
+		string name = remaining.substr(0, slash);
+		remaining = slash == string::npos ? "" : remaining.substr(slash + 1);
+		if (name.empty())
+			continue;
+
+		vector<XDVDFS_ENTRY> entries;
+		if (!List(current, entries))
+			return false;
+		bool found = false;
+		for (unsigned int i = 0; i < entries.size() && !found; i++)
+		{
+			if (_stricmp(entries[i].name.c_str(), name.c_str()) == 0)
+			{
+				current = entries[i];
+				found = true;
+			}
+		}
+		if (!found)
+			return false;
+	}
+	*entry = current;
+	return true;
+}
+
+// End of an entry's last sector, relative to the partition
+static unsigned long long EntryEnd(const XDVDFS_ENTRY& entry)
+{
+	unsigned long long sectors = ((unsigned long long)entry.size + XDVDFS_SECTOR_SIZE - 1) / XDVDFS_SECTOR_SIZE;
+	return ((unsigned long long)entry.sector + sectors) * XDVDFS_SECTOR_SIZE;
+}
+
+bool XdvdfsImage::UsedSize(unsigned long long* size)
+{
+	if (m_file == NULL)
+		return false;
+	unsigned long long used = (XDVDFS_VOLUME_SECTOR + 1) * XDVDFS_SECTOR_SIZE;
+
+	// Directories are visited once each, however the tables link to them
+	std::set<DWORD> visited;
+	vector<XDVDFS_ENTRY> pending(1, m_root);
+	while (!pending.empty())
+	{
+		XDVDFS_ENTRY dir = pending.back();
+		pending.pop_back();
+		if (!visited.insert(dir.sector).second)
+			continue;
+		if (EntryEnd(dir) > used)
+			used = EntryEnd(dir);
+
+		vector<XDVDFS_ENTRY> entries;
+		if (!List(dir, entries))
+			return false;
+		for (unsigned int i = 0; i < entries.size(); i++)
+		{
+			if (entries[i].IsDirectory())
+				pending.push_back(entries[i]);
+			else if (entries[i].size > 0 && EntryEnd(entries[i]) > used)
+				used = EntryEnd(entries[i]);
+		}
+	}
+	if (used > m_size)
+		return false;
+	*size = used;
+	return true;
+}
+
+bool XdvdfsImage::Read(const XDVDFS_ENTRY& entry, DWORD offset, void* buffer, DWORD size, DWORD* read)
+{
+	*read = 0;
+	if (m_file == NULL || offset > entry.size)
+		return false;
+	if (size > entry.size - offset)
+		size = entry.size - offset;
+	if (size == 0)
+		return true;
+	if (!VfsReadExact(m_file, m_partition + (unsigned long long)entry.sector * XDVDFS_SECTOR_SIZE + offset, buffer, size))
+		return false;
+	*read = size;
+	return true;
+}
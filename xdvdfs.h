@@ -0,0 +1,59 @@
+#ifndef XDVDFS_H
+#define XDVDFS_H
+#include <string>
+#include <vector>
+#include "vfs.h"
+
+#define XDVDFS_SECTOR_SIZE			0x800
+#define XDVDFS_VOLUME_SECTOR		32			// Volume descriptor, from the start of the game partition
+#define XDVDFS_MAGIC				"MICROSOFT*XBOX*MEDIA"
+#define XDVDFS_MAGIC_SIZE			20
+#define XDVDFS_ATTRIBUTE_DIRECTORY	0x10
+#define XDVDFS_DIRENT_MIN_SIZE		14			// Fixed part of a directory entry, before the name
+
+struct XDVDFS_ENTRY
+{
+	std::string name;
+	DWORD sector;		// From the start of the game partition
+	DWORD size;
+	BYTE attributes;
+
+	bool IsDirectory() const { return (attributes & XDVDFS_ATTRIBUTE_DIRECTORY) != 0; }
+};
+
+// Reads the game partition of an Xbox 360 disc image. Full dumps carry a video
+// partition in front of it, so the partition is found by looking for the volume
+// descriptor at each offset the disc formats use. All fields are little-endian.
+class XdvdfsImage
+{
+public:
+	XdvdfsImage();
+
+	// file stays owned by the caller and must outlive the image
+	bool Open(VfsFile* file);
+
+	unsigned long long PartitionOffset() const { return m_partition; }
+	unsigned long long PartitionSize() const { return m_size; }
+	const XDVDFS_ENTRY& Root() const { return m_root; }
+
+	// Walks a directory's entry tree into entries, in name order
+	bool List(const XDVDFS_ENTRY& dir, std::vector<XDVDFS_ENTRY>& entries);
+
+	// Looks up a '\' separated path from the root, ignoring case
+	bool Find(const char* path, XDVDFS_ENTRY* entry);
+
+	// Walks the whole tree for the end of the last sector anything uses: the
+	// volume descriptor, every directory table and every file. Everything after
+	// it is padding, so a copy of the partition can stop there.
+	bool UsedSize(unsigned long long* size);
+
+	// Reads from a file, clamped to its size; read receives the byte count
+	bool Read(const XDVDFS_ENTRY& entry, DWORD offset, void* buffer, DWORD size, DWORD* read);
+
+private:
+	VfsFile* m_file;
+	unsigned long long m_partition;
+	unsigned long long m_size;
+	XDVDFS_ENTRY m_root;
+};
+#endif